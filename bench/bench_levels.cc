@@ -0,0 +1,180 @@
+// Level-storage backend and book memory comparison across book shapes.
+// Build with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+#include "ob/consolidated.hpp"
+#include "ob/features.hpp"
+#include "ob/order_book.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace {
+
+using BookEvent = std::variant<ob::AddEvent, ob::CancelEvent, ob::DeleteEvent, ob::ExecuteEvent>;
+
+struct Shape {
+  const char* name;
+  int half_width;     // price offsets drawn from [-half_width, half_width] ticks around mid
+  double inside_bias; // probability of drawing from the first few ticks instead
+  std::size_t resting; // target live orders
+};
+
+// Add/cancel/execute/delete flow around a fixed mid; the live set stays near shape.resting.
+std::vector<BookEvent> make_flow(const Shape& shape, std::size_t n, std::uint32_t seed) {
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> u01(0.0, 1.0);
+  std::uniform_int_distribution<int> wide(1, shape.half_width);
+  std::uniform_int_distribution<int> near(1, 3);
+  const ob::Price mid = 1000000;
+  const ob::Price tick = 100;
+
+  struct Live { ob::OrderId id; ob::Qty qty; };
+  std::vector<Live> live;
+  std::vector<BookEvent> out;
+  out.reserve(n);
+  ob::OrderId next_id = 1;
+
+  while (out.size() < n) {
+    const bool add = live.size() < shape.resting / 2 ||
+                     (live.size() < shape.resting * 2 && u01(rng) < 0.5);
+    if (add) {
+      const bool buy = u01(rng) < 0.5;
+      const int off = (u01(rng) < shape.inside_bias) ? near(rng) : wide(rng);
+      const ob::Price px = buy ? mid - off * tick : mid + off * tick;
+      const ob::Qty qty = 100 * (1 + static_cast<ob::Qty>(rng() % 5));
+      out.push_back(ob::AddEvent{.locate=1, .order_id=next_id, .side=buy ? ob::Side::Buy : ob::Side::Sell,
+                                 .qty=qty, .price=px});
+      live.push_back(Live{next_id++, qty});
+      continue;
+    }
+    std::size_t i = static_cast<std::size_t>(rng() % live.size());
+    Live& o = live[i];
+    double r = u01(rng);
+    if (r < 0.2 && o.qty > 100) {
+      out.push_back(ob::CancelEvent{.locate=1, .order_id=o.id, .cancel_qty=100});
+      o.qty -= 100;
+      continue;
+    }
+    if (r < 0.35) {
+      out.push_back(ob::ExecuteEvent{.locate=1, .order_id=o.id, .exec_qty=o.qty});
+    } else {
+      out.push_back(ob::DeleteEvent{.locate=1, .order_id=o.id});
+    }
+    live[i] = live.back();
+    live.pop_back();
+  }
+  return out;
+}
+
+struct Result {
+  double ns_per_event{};
+  double allocs_per_kevent{}; // calls reaching the system allocator
+  std::size_t peak_levels{};
+};
+
+Result run(const std::vector<BookEvent>& flow, ob::LevelBackend backend, ob::BookMemory memory) {
+  ob::CountingResource counter;
+  ob::OrderBook book;
+  book.set_memory(memory, &counter);
+  book.add_symbol(1, "BENCH", backend);
+  auto t0 = std::chrono::steady_clock::now();
+  for (const auto& ev : flow) {
+    std::visit([&](const auto& e) { book.apply(e); }, ev);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  const ob::SymbolBook* sb = book.find(1);
+  if (!sb->validate()) std::cerr << "validate failed for " << ob::to_string(backend) << "\n";
+  const double n = static_cast<double>(flow.size());
+  Result r;
+  r.ns_per_event = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+  r.allocs_per_kevent = static_cast<double>(counter.allocations()) * 1000.0 / n;
+  r.peak_levels = sb->peak_levels();
+  return r;
+}
+
+// Same flow on each of `venues` books; returns added ns per venue level change for the
+// consolidated layer (with listeners minus without).
+double run_consolidated(const std::vector<BookEvent>& flow, std::size_t venues) {
+  auto replay = [&](ob::ConsolidatedBook* cons) {
+    std::vector<ob::OrderBook> books(venues);
+    for (std::size_t v = 0; v < venues; ++v) {
+      if (cons) books[v].set_listener(cons->venue_listener(v));
+      books[v].add_symbol(1, "BENCH");
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    for (const auto& ev : flow) {
+      for (auto& b : books) std::visit([&](const auto& e) { b.apply(e); }, ev);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  };
+  const double base = replay(nullptr);
+  ob::ConsolidatedBook cons(venues);
+  const double with = replay(&cons);
+  return (with - base) / static_cast<double>(std::max<std::uint64_t>(cons.stats().updates, 1));
+}
+
+// Added ns per event for a FeatureEngine of the given depth on one book (best of 3).
+double run_features(const std::vector<BookEvent>& flow, std::uint32_t depth) {
+  auto replay = [&](ob::BookListener* l) {
+    double best = 1e300;
+    for (int rep = 0; rep < 3; ++rep) {
+      ob::OrderBook book;
+      book.set_listener(l);
+      book.add_symbol(1, "BENCH", ob::LevelBackend::Flat);
+      auto t0 = std::chrono::steady_clock::now();
+      for (const auto& ev : flow) std::visit([&](const auto& e) { book.apply(e); }, ev);
+      best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+  };
+  const double base = replay(nullptr);
+  ob::FeatureEngine engine(ob::FeatureConfig{.depth=depth});
+  const double with = replay(&engine);
+  return (with - base) / static_cast<double>(flow.size());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::size_t events = 2'000'000;
+  if (argc > 1) events = static_cast<std::size_t>(std::stoull(argv[1]));
+
+  const Shape shapes[] = {
+    {"thin-wide", 2000, 0.05, 2000},  // few orders per level, thousands of levels
+    {"deep-inside", 20, 0.60, 20000}, // many orders stacked on a handful of levels
+    {"mid", 200, 0.30, 5000},
+  };
+
+  std::cout << std::left << std::setw(14) << "shape" << std::setw(8) << "backend" << std::setw(12) << "memory"
+            << std::right << std::setw(12) << "ns/event" << std::setw(14) << "allocs/kev"
+            << std::setw(14) << "peak levels" << "\n";
+  for (const Shape& shape : shapes) {
+    auto flow = make_flow(shape, events, 42);
+    for (ob::LevelBackend backend : {ob::LevelBackend::Map, ob::LevelBackend::Flat}) {
+      for (ob::BookMemory memory : {ob::BookMemory::Global, ob::BookMemory::PerSymbol, ob::BookMemory::Shared}) {
+        Result r = run(flow, backend, memory);
+        std::cout << std::left << std::setw(14) << shape.name << std::setw(8) << ob::to_string(backend)
+                  << std::setw(12) << ob::to_string(memory)
+                  << std::right << std::setw(12) << std::fixed << std::setprecision(1) << r.ns_per_event
+                  << std::setw(14) << std::setprecision(3) << r.allocs_per_kevent
+                  << std::setw(14) << r.peak_levels << "\n";
+      }
+    }
+  }
+
+  auto flow = make_flow(shapes[2], events / 4, 7);
+  for (std::size_t venues : {2, 4, 8}) {
+    std::cout << "consolidated " << venues << " venues: " << std::setprecision(1)
+              << run_consolidated(flow, venues) << " ns per venue level change\n";
+  }
+  for (std::uint32_t depth : {1, 5, 8}) {
+    std::cout << "features depth " << depth << ": " << std::setprecision(1) << run_features(flow, depth)
+              << " ns per event\n";
+  }
+  return 0;
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include "listener.hpp"
+#include "order_book.hpp"
+#include "symbol_book.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace ob {
+
+struct BacktestConfig {
+  std::uint64_t latency_ns{0}; // feed time from submit() or cancel() until it reaches the book
+};
+
+using ShadowId = std::uint64_t; // 1, 2, ... in submit order
+
+// A strategy's simulated order. Never enters the replayed book: it holds a queue position
+// beside a real level instead.
+struct ShadowOrder {
+  ShadowId id{};
+  StockLocate locate{};
+  Side side{Side::Buy};
+  Price price{};
+  Qty qty{};
+  Qty filled{};
+  std::uint64_t submit_ns{};
+  std::uint64_t ahead{};   // displayed shares in front of it at its level
+  OrderId anchor{};        // real orders with ids up to this were queued before it
+  bool working{false};     // active at the book, not yet filled or cancelled
+  bool done{false};        // filled or cancelled
+
+  Qty leaves() const { return qty - filled; }
+};
+
+struct ShadowFill {
+  ShadowId id{};
+  StockLocate locate{};
+  Side side{Side::Buy};
+  Price price{};
+  Qty qty{};
+  Qty leaves{};
+  std::uint64_t ts{};
+};
+
+struct BacktestStats {
+  std::uint64_t submitted{};
+  std::uint64_t activated{};  // reached the book after the latency
+  std::uint64_t cancelled{};
+  std::uint64_t fills{};
+  std::uint64_t filled_qty{};
+};
+
+class Backtester;
+
+// Callbacks of a backtested strategy. Book and trade callbacks fire only for subscribed
+// symbols, after the event has been applied and the chained listeners have seen it.
+// A fill is reported just before the real event that caused it is applied (or when a
+// marketable order arrives). submit() and cancel() may be called from any callback.
+class Strategy {
+public:
+  virtual ~Strategy() = default;
+  virtual void on_book(Backtester&, const SymbolBook&, const LevelUpdate&) {}
+  virtual void on_trade(Backtester&, const SymbolBook&, const TradeUpdate&) {}
+  virtual void on_fill(Backtester&, const ShadowFill&) {}
+  virtual void on_cancelled(Backtester&, const ShadowOrder&) {}
+};
+
+// Event-driven strategy harness over a replayed OrderBook.
+//
+// Feed the replay through advance() and apply() instead of OrderBook::apply(). Shadow
+// orders reach the book latency_ns of feed time after submit(). A resting one joins
+// the back of its level: the level's displayed size is queued ahead of it, and every
+// real order already in the book is marked as ahead by id (ITCH order reference
+// numbers increase through the day, and a replace gets a new one at the back).
+// Executions and cancels of orders ahead shrink the queue in front of it. Executions
+// behind it, or at a worse price on its side, fill it instead, since that flow would
+// have reached it first. An order marketable on arrival fills against the displayed
+// opposite levels. Fills are simulated only; the replayed book never changes.
+//
+// Events for symbols with no working shadow order cost one vector lookup on top of the
+// book. Single-threaded, like the book.
+//
+// Install with OrderBook::set_listener(); set_next() chains the listener it displaces.
+class Backtester final : public BookListener {
+public:
+  Backtester(OrderBook& book, Strategy& strategy, const BacktestConfig& cfg = {});
+
+  void set_next(BookListener* next) { next_ = next; }
+  void subscribe(StockLocate locate);
+  void subscribe_all() { all_ = true; }
+  bool subscribed(StockLocate locate) const { return all_ || subscribed_[locate]; }
+
+  // Sets the clock; call with each message timestamp before its event is applied.
+  // Submits and cancels whose latency has elapsed reach the book here.
+  void advance(std::uint64_t ts);
+
+  Status apply(const StockDirectoryEvent& e) { return book_.apply(e); }
+  Status apply(const AddEvent& e);
+  Status apply(const CancelEvent& e);
+  Status apply(const DeleteEvent& e);
+  Status apply(const ExecuteEvent& e);
+  Status apply(const ReplaceEvent& e);
+  Status apply(const TradeEvent& e) { return book_.apply(e); }
+
+  // Returns 0 for a zero quantity or an unregistered symbol.
+  ShadowId submit(StockLocate locate, Side side, Price price, Qty qty);
+  // False if the order is unknown or already done; a cancel can still lose the race
+  // to fills during its latency.
+  bool cancel(ShadowId id);
+
+  const ShadowOrder* find(ShadowId id) const;
+  std::uint64_t now() const { return now_; }
+  const BacktestConfig& config() const { return cfg_; }
+  const BacktestStats& stats() const { return stats_; }
+
+  void on_level(const SymbolBook& book, const LevelUpdate& u) override;
+  void on_reset(const SymbolBook& book) override;
+  void on_trade(const SymbolBook& book, const TradeUpdate& t) override;
+
+private:
+  struct Pending {
+    std::uint64_t due{};
+    ShadowId id{};
+    bool cancel{false};
+  };
+
+  void activate(ShadowOrder& o);
+  void fill(ShadowOrder& o, Price price, Qty qty);
+  // Real order o loses removed shares: the queue ahead of shadow orders shrinks.
+  void on_removed(StockLocate locate, const Order& o, Qty removed);
+  void drop_done(StockLocate locate);
+
+  OrderBook& book_;
+  Strategy& strategy_;
+  BacktestConfig cfg_;
+  BookListener* next_{nullptr};
+  bool all_{false};
+  std::vector<bool> subscribed_;                // by locate
+  std::vector<std::vector<ShadowId>> working_;  // by locate
+  std::deque<ShadowOrder> orders_;              // by id - 1; stable across submits from callbacks
+  std::deque<Pending> pending_;                 // due in order: the latency is fixed
+  OrderId last_order_id_{0};
+  std::uint64_t now_{0};
+  BacktestStats stats_;
+};
+
+} // namespace ob
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace ob {
+
+// Peak sizes seen for one symbol, used to presize its book before trading starts.
+struct SymbolCapacity {
+  std::uint32_t orders{};
+  std::uint32_t levels{};
+};
+
+// Per-symbol capacity hints keyed by symbol (locates are reassigned every day).
+// Text format, one symbol per line: "SYMBOL orders levels"; '#' starts a comment.
+class CapacityProfile {
+public:
+  bool load(const std::string& path);
+  bool save(const std::string& path) const;
+
+  void set(std::string_view symbol, SymbolCapacity c) { by_symbol_[std::string(symbol)] = c; }
+  const SymbolCapacity* find(std::string_view symbol) const;
+  std::size_t size() const { return by_symbol_.size(); }
+  bool empty() const { return by_symbol_.empty(); }
+
+private:
+  std::unordered_map<std::string, SymbolCapacity> by_symbol_;
+};
+
+} // namespace ob
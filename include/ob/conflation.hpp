@@ -0,0 +1,70 @@
+#pragma once
+#include "listener.hpp"
+#include "symbol_book.hpp"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace ob {
+
+// Latest BBO of one symbol plus how many BBO changes were merged into it.
+struct ConflatedUpdate {
+  StockLocate locate{};
+  TopOfBook top{};
+  std::uint32_t merged{}; // BBO changes since this consumer's previous delivery
+};
+
+struct ConsumerStats {
+  std::uint64_t changes{};   // BBO changes observed for this consumer
+  std::uint64_t delivered{}; // updates handed to the sink
+  std::uint64_t flushes{};   // sink invocations
+  std::uint64_t max_batch{}; // largest batch delivered
+  // changes - delivered is what conflation saved; 0 means the consumer kept up.
+};
+
+// Per-consumer conflation of BBO changes. Install with OrderBook::set_listener().
+//
+// A consumer keeps one queued flag and one merge counter per locate plus a queue of
+// dirty locates, so memory is O(symbols) no matter how many events arrive between
+// flushes. Each book change costs one flag test per consumer; a flush walks only
+// that consumer's own dirty queue, so a slow consumer never adds work to a fast one.
+class ConflatingPublisher final : public BookListener {
+public:
+  using Sink = std::function<void(std::span<const ConflatedUpdate>)>;
+
+  // min_interval_ns bounds how often the sink runs; 0 means every poll().
+  std::size_t add_consumer(std::uint64_t min_interval_ns, Sink sink);
+
+  void on_level(const SymbolBook& book, const LevelUpdate& u) override;
+  void on_reset(const SymbolBook& book) override;
+
+  // Delivers pending symbols to every consumer whose interval has elapsed at now_ns.
+  void poll(std::uint64_t now_ns);
+  // Delivers pending symbols to one consumer regardless of its interval.
+  void flush(std::size_t consumer, std::uint64_t now_ns);
+
+  const ConsumerStats& stats(std::size_t consumer) const { return consumers_[consumer].stats; }
+  std::size_t pending(std::size_t consumer) const { return consumers_[consumer].dirty.size(); }
+
+private:
+  static constexpr std::size_t kLocates = std::size_t{1} << 16;
+
+  struct Consumer {
+    std::uint64_t interval_ns{};
+    std::uint64_t last_flush_ns{};
+    Sink sink;
+    std::vector<std::uint32_t> merged;  // per locate; > 0 means queued
+    std::vector<StockLocate> dirty;     // locates with merged > 0, in first-change order
+    std::vector<ConflatedUpdate> batch; // reused delivery buffer
+    ConsumerStats stats;
+  };
+
+  static bool same_top(const TopOfBook& a, const TopOfBook& b);
+  void observe(StockLocate locate, const TopOfBook& top);
+
+  std::vector<Consumer> consumers_;
+  std::vector<TopOfBook> last_top_ = std::vector<TopOfBook>(kLocates);
+};
+
+} // namespace ob
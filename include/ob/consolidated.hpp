@@ -0,0 +1,142 @@
+#pragma once
+#include "listener.hpp"
+#include "symbol_book.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ob {
+
+// Consolidated identifier of a symbol across venues (venues number locates
+// independently, so symbols are matched by name).
+using ConsolidatedId = std::uint32_t;
+
+// National best bid and offer: best price per side across venues, the size summed
+// over every venue quoting that price, and which venues those are (bit v = venue v).
+struct Nbbo {
+  bool has_bid{false};
+  bool has_ask{false};
+  Price bid{};
+  Price ask{};
+  std::uint64_t bid_qty{};
+  std::uint64_t ask_qty{};
+  std::uint32_t bid_venues{};
+  std::uint32_t ask_venues{};
+
+  bool operator==(const Nbbo&) const = default;
+};
+
+struct ConsolidatedLevel {
+  Price price{};
+  std::uint64_t qty{};
+  std::uint32_t count{};
+  std::uint32_t venues{}; // bit v set while venue v has size at this price
+};
+
+struct ConsolidatedStats {
+  std::uint64_t updates{};      // venue level changes applied
+  std::uint64_t nbbo_changes{};
+  std::uint64_t unmapped{};     // changes from books with no symbol yet (no directory)
+};
+
+// Per-symbol NBBO and aggregated depth over up to kMaxVenues venue OrderBooks.
+//
+// Install venue_listener(v) on venue v's OrderBook. Each venue level change adjusts
+// one consolidated level by the venue's delta (the level keeps every venue's last
+// size), then re-reads the best level of that side, so an update costs one map
+// lookup and never rescans venues or depth. A venue book reset removes that venue's
+// contribution from its symbol only.
+class ConsolidatedBook {
+public:
+  static constexpr std::size_t kMaxVenues = 16;
+  using NbboCallback = std::function<void(ConsolidatedId id, const Nbbo& nbbo)>;
+
+  // venues is clamped to [1, kMaxVenues].
+  explicit ConsolidatedBook(std::size_t venues);
+  ConsolidatedBook(const ConsolidatedBook&) = delete;
+  ConsolidatedBook& operator=(const ConsolidatedBook&) = delete;
+
+  std::size_t venues() const { return venues_.size(); }
+  // Listener to install with OrderBook::set_listener() on venue v's book; set_next()
+  // chains the listener it displaces, which then sees that venue's callbacks.
+  BookListener* venue_listener(std::size_t venue) { return &venues_[venue].listener; }
+  void set_next(std::size_t venue, BookListener* next) { venues_[venue].listener.next = next; }
+  // Called synchronously whenever a symbol's NBBO changes.
+  void set_nbbo_callback(NbboCallback cb) { on_nbbo_ = std::move(cb); }
+
+  std::size_t size() const { return symbols_.size(); }
+  // False if no venue has reported the symbol yet.
+  bool find(std::string_view symbol, ConsolidatedId* id) const;
+  std::string_view symbol(ConsolidatedId id) const { return symbols_[id].name; }
+  const Nbbo& nbbo(ConsolidatedId id) const { return symbols_[id].nbbo; }
+  // Up to n aggregated levels from the best; returns how many were written.
+  std::size_t depth(ConsolidatedId id, Side s, ConsolidatedLevel* out, std::size_t n) const;
+  std::size_t level_count(ConsolidatedId id, Side s) const;
+
+  const ConsolidatedStats& stats() const { return stats_; }
+
+private:
+  struct Level {
+    std::uint64_t qty{};
+    std::uint32_t count{};
+    std::uint32_t venues{};
+    std::array<std::uint64_t, kMaxVenues> venue_qty{};
+    std::array<std::uint32_t, kMaxVenues> venue_count{};
+  };
+  using Bids = std::map<Price, Level, std::greater<Price>>;
+  using Asks = std::map<Price, Level, std::less<Price>>;
+
+  struct Symbol {
+    std::string name;
+    Bids bids;
+    Asks asks;
+    Nbbo nbbo;
+  };
+
+  struct VenueListener final : BookListener {
+    ConsolidatedBook* owner{};
+    std::uint32_t venue{};
+    BookListener* next{nullptr};
+    void on_level(const SymbolBook& book, const LevelUpdate& u) override {
+      owner->on_level(venue, book, u);
+      if (next) next->on_level(book, u);
+    }
+    void on_reset(const SymbolBook& book) override {
+      owner->on_reset(venue, book);
+      if (next) next->on_reset(book);
+    }
+    void on_trade(const SymbolBook& book, const TradeUpdate& t) override {
+      if (next) next->on_trade(book, t);
+    }
+  };
+
+  struct Venue {
+    VenueListener listener;
+    std::vector<ConsolidatedId> by_locate; // kUnmapped until the symbol is seen
+  };
+
+  static constexpr ConsolidatedId kUnmapped = ~ConsolidatedId{0};
+
+  bool resolve(std::uint32_t venue, const SymbolBook& book, ConsolidatedId* id);
+  void on_level(std::uint32_t venue, const SymbolBook& book, const LevelUpdate& u);
+  void on_reset(std::uint32_t venue, const SymbolBook& book);
+  template <typename Map>
+  static void set_venue_level(Map& side, Price price, std::uint32_t venue, std::uint64_t qty, std::uint32_t count);
+  template <typename Map>
+  static void drop_venue(Map& side, std::uint32_t venue);
+  void refresh_nbbo(ConsolidatedId id);
+
+  std::vector<Venue> venues_;
+  std::vector<Symbol> symbols_;
+  std::unordered_map<std::string, ConsolidatedId> by_name_;
+  NbboCallback on_nbbo_;
+  ConsolidatedStats stats_;
+};
+
+} // namespace ob
@@ -2,6 +2,7 @@
 #include "types.hpp"
 #include <optional>
 #include <cstdint>
+#include <string_view>
 
 namespace ob {
 
@@ -32,6 +33,21 @@ struct ExecuteEvent {
   StockLocate locate{};
   OrderId order_id{};
   Qty exec_qty{};
+  // ITCH 'C' only: the execution price, which may differ from the resting order's.
+  Price price{};
+  bool has_price{};
+  // 'C' printable flag: false for executions that must not count toward volume.
+  bool printable{true};
+};
+
+// Execution against a non-displayed order (ITCH Trade 'P'). The book is unchanged;
+// listeners get the print.
+struct TradeEvent {
+  StockLocate locate{};
+  OrderId order_id{};
+  Side side{};
+  Qty qty{};
+  Price price{};
 };
 
 struct ReplaceEvent {
@@ -42,5 +58,11 @@ struct ReplaceEvent {
   Price new_price{};
 };
 
+// Symbol registration (ITCH Stock Directory 'R').
+struct StockDirectoryEvent {
+  StockLocate locate{};
+  std::string_view symbol{}; // only needs to outlive the apply() call
+};
+
 // Later: you can add TradingAction/SystemEvent, etc., without touching core structures.
 } // namespace ob
\ No newline at end of file
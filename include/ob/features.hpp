@@ -0,0 +1,114 @@
+#pragma once
+#include "listener.hpp"
+#include "symbol_book.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ob {
+
+struct FeatureConfig {
+  std::uint32_t depth{5}; // levels per side tracked for imbalance and per-level flow; 1..kMaxDepth
+};
+
+// One symbol's features at export time. Per-level arrays are indexed [side][rank]:
+// side 0 bids, 1 asks; rank 0 the best level, as the level stood when the event hit it.
+struct FeatureRow {
+  static constexpr std::size_t kMaxDepth = 8;
+
+  StockLocate locate{};
+  std::uint32_t depth{};         // ranks filled in the per-level arrays
+  bool has_bid{false};
+  bool has_ask{false};
+  Price bid{};
+  Price ask{};
+  std::uint64_t bid_qty{};
+  std::uint64_t ask_qty{};
+  std::uint64_t bid_depth_qty{}; // summed over the top `depth` levels
+  std::uint64_t ask_depth_qty{};
+
+  double microprice{};           // (bid * ask_qty + ask * bid_qty) / (bid_qty + ask_qty); one side: its price
+  double queue_imbalance{};      // (bid_qty - ask_qty) / (bid_qty + ask_qty), in [-1, 1]
+  double depth_imbalance{};      // the same over the top `depth` levels
+  std::int64_t ofi{};            // cumulative order-flow imbalance at the best levels, shares
+
+  // Cumulative events per level; a rate is the difference of two exports over their time gap.
+  std::array<std::array<std::uint64_t, kMaxDepth>, 2> adds{};       // level size grew
+  std::array<std::array<std::uint64_t, kMaxDepth>, 2> cancels{};    // shrank, not by an execution
+  std::array<std::array<std::uint64_t, kMaxDepth>, 2> executions{}; // shrank by an execution
+};
+
+// Streaming order-flow features per symbol, updated from the book's level and trade
+// notifications instead of depth() scans after each event.
+//
+// Each symbol keeps its top `depth` levels per side in fixed arrays (one line-aligned
+// 256-byte block of hot state) and its flow counters in a separate array. A level
+// change scans at most `depth` prices: a size change at a tracked level updates it in
+// place, a new level inside the window shifts the array, and only the removal of a
+// tracked level from a full window re-reads the side with SymbolBook::depth().
+// Changes beyond the window cost the scan and nothing else. Order-flow imbalance
+// (Cont, Kukanov and Stoikov) accumulates on every change of a best level.
+//
+// export_rows() copies every symbol's current values in one pass; with a single
+// writer thread the export is exact as of the last applied event.
+//
+// Install with OrderBook::set_listener(); set_next() chains the listener it displaces.
+class FeatureEngine final : public BookListener {
+public:
+  static constexpr std::size_t kMaxDepth = FeatureRow::kMaxDepth;
+
+  explicit FeatureEngine(const FeatureConfig& cfg = {});
+
+  void set_next(BookListener* next) { next_ = next; }
+  std::uint32_t depth() const { return depth_; }
+  std::size_t size() const { return tops_.size(); } // symbols seen
+
+  // One row per symbol seen, in first-seen order; reuses out's storage.
+  void export_rows(std::vector<FeatureRow>* out) const;
+  // False if the symbol has had no level change yet.
+  bool row(StockLocate locate, FeatureRow* out) const;
+
+  void on_level(const SymbolBook& book, const LevelUpdate& u) override;
+  void on_reset(const SymbolBook& book) override;
+  void on_trade(const SymbolBook& book, const TradeUpdate& t) override;
+
+private:
+  static constexpr std::uint32_t kNoSlot = ~std::uint32_t{0};
+
+  // Levels best first. Prices are stored as rank keys (bids bit-inverted) so that a
+  // smaller key is a better level on either side.
+  struct SideTop {
+    std::uint32_t n{};
+    std::uint32_t reserved{};
+    std::uint64_t sum{};                 // qty over the n levels
+    std::array<Price, kMaxDepth> key{};
+    std::array<std::uint64_t, kMaxDepth> qty{};
+  };
+  struct alignas(64) Top {
+    std::array<SideTop, 2> side;
+    // Size decrease made by the symbol's latest level change, if inside the window; an
+    // execution's trade follows its level change directly and reclassifies it.
+    std::int8_t last_cut_side{-1};
+    std::uint8_t last_cut_rank{};
+  };
+  struct Flow {
+    StockLocate locate{};
+    std::int64_t ofi{};
+    std::array<std::array<std::uint64_t, kMaxDepth>, 2> adds{};
+    std::array<std::array<std::uint64_t, kMaxDepth>, 2> cancels{};
+    std::array<std::array<std::uint64_t, kMaxDepth>, 2> executions{};
+  };
+
+  std::uint32_t slot(StockLocate locate);
+  void refill(const SymbolBook& book, Side s, SideTop& t) const;
+  void fill_row(std::uint32_t slot, FeatureRow* out) const;
+
+  std::uint32_t depth_;
+  BookListener* next_{nullptr};
+  std::vector<std::uint32_t> slots_; // by locate
+  std::vector<Top> tops_;            // by slot
+  std::vector<Flow> flows_;          // by slot
+};
+
+} // namespace ob
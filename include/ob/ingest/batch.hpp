@@ -0,0 +1,69 @@
+#pragma once
+#include "ob/ingest/framing.hpp"
+#include "ob/ingest/itch.hpp"
+#include "ob/memory.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ob::ingest {
+
+// Replays many ITCH files, one OrderBook per file, on a work-stealing thread pool.
+//
+// Every file is admitted against a global memory budget before it is read. It is
+// charged its file buffer plus an estimate of its book (file bytes * book ratio). The
+// ratio starts at BatchConfig::book_ratio and rises to the largest ratio any finished
+// file actually needed, so later admissions use measured sizes. A file larger than the
+// whole budget still runs, but alone.
+
+struct BatchConfig {
+  unsigned threads{0};            // 0: hardware concurrency
+  std::uint64_t memory_budget{0}; // bytes; 0: unlimited
+  double book_ratio{1.0};         // initial book-bytes per file-byte estimate
+  BookMemory memory{BookMemory::PerSymbol};
+  ItchFilter filter;
+  ItchFraming framing{ItchFraming::Auto}; // per file when Auto
+};
+
+struct FileResult {
+  std::string path;
+  bool ok{false};
+  std::string error;
+  unsigned worker{};
+  std::uint64_t bytes{};
+  std::uint64_t messages{};    // decoded (passed the filter)
+  std::uint64_t skipped{};     // dropped by the filter
+  std::uint64_t events{};      // book events applied
+  std::uint64_t symbols{};
+  std::uint64_t book_bytes{};  // peak bytes held by the books
+  double seconds{};            // read + replay
+  double queued_seconds{};     // waiting for the memory budget
+
+  double messages_per_second() const { return seconds > 0 ? static_cast<double>(messages) / seconds : 0; }
+  double megabytes_per_second() const { return seconds > 0 ? static_cast<double>(bytes) / seconds / 1e6 : 0; }
+};
+
+struct BatchSummary {
+  std::size_t files{};
+  std::size_t failed{};
+  std::uint64_t bytes{};
+  std::uint64_t messages{};
+  std::uint64_t peak_budget_bytes{}; // most bytes charged to the budget at once
+  unsigned threads{};
+  double seconds{};                  // wall clock for the whole batch
+
+  double messages_per_second() const { return seconds > 0 ? static_cast<double>(messages) / seconds : 0; }
+  double megabytes_per_second() const { return seconds > 0 ? static_cast<double>(bytes) / seconds / 1e6 : 0; }
+};
+
+// Calls on_result once per file, in completion order, never concurrently.
+BatchSummary replay_files(const std::vector<std::string>& files, const BatchConfig& cfg,
+                          const std::function<void(const FileResult&)>& on_result);
+
+// Expands shell globs and "@list" files (one path or glob per line, '#' comments).
+// Sorted and de-duplicated; arguments that match nothing are kept as-is so they fail
+// visibly.
+std::vector<std::string> expand_file_args(const std::vector<std::string>& args);
+
+} // namespace ob::ingest
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace ob::ingest {
+
+// How ITCH messages are laid out in a file or buffer.
+enum class ItchFraming : std::uint8_t {
+  Auto,           // detect_itch_framing() decides
+  Raw,            // messages back to back; each size follows from its type byte
+  LengthPrefixed, // NASDAQ BinaryFILE: a 2-byte big-endian length before each message
+  SoupBin         // SoupBinTCP packets: 2-byte length, packet type; 'S' packets carry a message
+};
+
+const char* to_string(ItchFraming f);
+// "auto", "raw", "length" or "soupbin".
+bool parse_itch_framing(std::string_view name, ItchFraming* out);
+
+// Checks the first few message boundaries of buffer under each framing, length-prefixed
+// and SoupBin first, and returns the first that is consistent throughout. Raw if none is.
+ItchFraming detect_itch_framing(const std::uint8_t* buffer, std::size_t size);
+
+// Start offset (the type byte) of every message of a known type, from one pass over
+// the framing alone: no field is decoded. With a length prefix, messages of unknown
+// types or with a length their type disagrees with are stepped over and counted; raw
+// framing has no lengths and stops at the first unknown type.
+struct ItchIndex {
+  ItchFraming framing{ItchFraming::Raw};
+  std::vector<std::uint64_t> offsets;
+  std::uint64_t unknown{};    // messages skipped: unknown type or mismatched length
+  std::uint64_t other{};      // SoupBin packets that carry no message (heartbeats, ...)
+  std::size_t end{};          // bytes covered; less than the size if indexing stopped early
+
+  std::size_t size() const { return offsets.size(); }
+};
+
+// Builds the index of buffer (framing Auto detects it first). Returns false if the
+// framing could not be followed to the end of the buffer; out covers what it could.
+bool index_itch(const std::uint8_t* buffer, std::size_t size, ItchFraming framing, ItchIndex* out);
+
+// Message boundaries that split index into `parts` runs of about equal bytes:
+// parts + 1 positions into index.offsets, first 0, last index.size().
+std::vector<std::size_t> split_itch_index(const ItchIndex& index, std::size_t parts);
+
+// Indexes data and, unless it is raw, rewrites it in place as raw back-to-back messages
+// (the form decode_next_itch() and decode_itch_run() read), dropping framing bytes,
+// skipped messages and anything past index->end. index->offsets then point into the
+// rewritten data; index->end still counts input bytes. Returns index_itch()'s result.
+bool unframe_itch(std::vector<std::uint8_t>* data, ItchFraming framing, ItchIndex* index);
+
+} // namespace ob::ingest
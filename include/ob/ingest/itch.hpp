@@ -1,6 +1,12 @@
 #pragma once
+#include "ob/events.hpp"
+#include "ob/types.hpp"
+#include <bitset>
 #include <cstddef>
 #include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace ob::ingest {
 
@@ -10,8 +16,187 @@ struct ItchMessageView {
   std::size_t body_size{0};
 };
 
+// Fields shared by every ITCH 5.0 message, right after the type byte.
+struct ItchHeader {
+  StockLocate locate{};
+  std::uint16_t tracking{};
+  std::uint64_t timestamp{}; // nanoseconds since midnight
+};
+
+// Size of an ITCH 5.0 message including its type byte; 0 for an unknown type.
 std::size_t itch_message_size(char type);
 bool decode_next_itch(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset,
                       ItchMessageView* out);
 
+// Field decoders. Each returns false if the message has the wrong type or size.
+bool decode_itch_header(const ItchMessageView& msg, ItchHeader* out);
+// symbol points into msg (trailing spaces trimmed).
+bool decode_itch_stock_directory(const ItchMessageView& msg, StockDirectoryEvent* out); // 'R'
+bool decode_itch_add(const ItchMessageView& msg, AddEvent* out);                       // 'A', 'F'
+bool decode_itch_cancel(const ItchMessageView& msg, CancelEvent* out);                 // 'X'
+bool decode_itch_delete(const ItchMessageView& msg, DeleteEvent* out);                 // 'D'
+bool decode_itch_execute(const ItchMessageView& msg, ExecuteEvent* out);               // 'E', 'C'
+bool decode_itch_replace(const ItchMessageView& msg, ReplaceEvent* out);               // 'U'
+bool decode_itch_trade(const ItchMessageView& msg, TradeEvent* out);                   // 'P'
+
+// Back-to-back messages of one type, decoded field by field into columns.
+struct ItchRun {
+  static constexpr std::size_t kMax = 32;
+  char type{};         // 'A', 'D', 'X' or 'E'
+  std::size_t count{};
+  std::uint64_t timestamp[kMax];
+  StockLocate locate[kMax];
+  OrderId order_id[kMax];
+  Qty qty[kMax];       // 'A' shares, 'X' cancelled, 'E' executed; unset for 'D'
+  Price price[kMax];   // 'A' only
+  Side side[kMax];     // 'A' only
+};
+
+// Fast path for replay: if the message at *offset is 'A', 'D', 'X' or 'E', decodes it
+// and up to ItchRun::kMax - 1 directly following messages of the same type, advances
+// *offset past them and returns the count. Returns 0 (offset untouched) for any other
+// type or a truncated message; fall back to decode_next_itch() then.
+//
+// Built with SSSE3 (-DOB_NATIVE=ON or -mssse3) each message's header and order fields
+// are byte-swapped with one shuffle per 16-byte load; otherwise this is
+// decode_itch_run_scalar().
+std::size_t decode_itch_run(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset, ItchRun* out);
+std::size_t decode_itch_run_scalar(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset,
+                                   ItchRun* out);
+
+// fn(timestamp, const XxxEvent&) for each message of the run, in order.
+template <typename Fn>
+void visit_itch_run(const ItchRun& run, Fn&& fn) {
+  for (std::size_t i = 0; i < run.count; ++i) {
+    switch (run.type) {
+      case 'A':
+        fn(run.timestamp[i], AddEvent{.locate=run.locate[i], .order_id=run.order_id[i], .side=run.side[i],
+                                      .qty=run.qty[i], .price=run.price[i]});
+        break;
+      case 'D':
+        fn(run.timestamp[i], DeleteEvent{.locate=run.locate[i], .order_id=run.order_id[i]});
+        break;
+      case 'X':
+        fn(run.timestamp[i], CancelEvent{.locate=run.locate[i], .order_id=run.order_id[i], .cancel_qty=run.qty[i]});
+        break;
+      case 'E':
+        fn(run.timestamp[i], ExecuteEvent{.locate=run.locate[i], .order_id=run.order_id[i], .exec_qty=run.qty[i]});
+        break;
+      default:
+        return;
+    }
+  }
+}
+
+// Subscription: which messages a decoder hands on. Every set that was never narrowed
+// admits everything; allow_*() narrows it to what was allowed.
+class ItchFilter {
+public:
+  void allow_type(char type);
+  void allow_locate(StockLocate locate);
+  // The locate is learned from the symbol's Stock Directory message ('R' messages are
+  // always inspected for this, even when 'R' itself is filtered out by type).
+  void allow_symbol(std::string_view symbol);
+
+  bool filters_types() const { return !all_types_; }
+  bool filters_locates() const { return !all_locates_; }
+  bool active() const { return !all_types_ || !all_locates_; }
+  bool wants_type(char type) const { return all_types_ || types_.test(static_cast<unsigned char>(type)); }
+  bool wants_locate(StockLocate locate) const { return all_locates_ || locates_.test(locate); }
+  bool wants_symbol(std::string_view padded) const; // 8-byte, space-padded ITCH symbol
+  bool has_symbols() const { return !symbols_.empty(); }
+
+private:
+  bool all_types_{true};
+  bool all_locates_{true};
+  std::bitset<256> types_;
+  std::bitset<std::size_t{1} << 16> locates_;
+  std::vector<std::string> symbols_; // space-padded to 8
+};
+
+struct ItchFilterStats {
+  std::uint64_t passed{};         // messages handed on
+  std::uint64_t skipped_type{};   // dropped on the type byte alone
+  std::uint64_t skipped_locate{}; // dropped on the locate
+  std::uint64_t skipped_bytes{};
+  std::uint64_t learned_locates{}; // allow_symbol() matches seen in directory messages
+};
+
+// Stateful decoder over a fixed filter. Unwanted messages are stepped over after
+// reading only their type byte and locate: no field decoding, no OrderBook dispatch.
+// Use next_run() first and next() when it returns 0, as with decode_itch_run().
+class ItchDecoder {
+public:
+  ItchDecoder() = default;
+  explicit ItchDecoder(const ItchFilter& filter) : filter_(filter) {}
+
+  bool next(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset, ItchMessageView* out);
+  std::size_t next_run(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset, ItchRun* out);
+
+  const ItchFilter& filter() const { return filter_; }
+  const ItchFilterStats& stats() const { return stats_; }
+
+private:
+  // Advances *offset past unwanted whole messages; stops at a wanted, unknown or
+  // truncated one.
+  void skip(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset);
+
+  ItchFilter filter_;
+  ItchFilterStats stats_;
+};
+
+// Decodes a book-affecting message or hidden trade print and hands the event to
+// fn(const XxxEvent&). Returns false for other message types or a failed decode.
+template <typename Fn>
+bool visit_itch_book_event(const ItchMessageView& msg, Fn&& fn) {
+  switch (msg.type) {
+    case 'R': {
+      StockDirectoryEvent e;
+      if (!decode_itch_stock_directory(msg, &e)) return false;
+      fn(e);
+      return true;
+    }
+    case 'A':
+    case 'F': {
+      AddEvent e;
+      if (!decode_itch_add(msg, &e)) return false;
+      fn(e);
+      return true;
+    }
+    case 'X': {
+      CancelEvent e;
+      if (!decode_itch_cancel(msg, &e)) return false;
+      fn(e);
+      return true;
+    }
+    case 'D': {
+      DeleteEvent e;
+      if (!decode_itch_delete(msg, &e)) return false;
+      fn(e);
+      return true;
+    }
+    case 'E':
+    case 'C': {
+      ExecuteEvent e;
+      if (!decode_itch_execute(msg, &e)) return false;
+      fn(e);
+      return true;
+    }
+    case 'U': {
+      ReplaceEvent e;
+      if (!decode_itch_replace(msg, &e)) return false;
+      fn(e);
+      return true;
+    }
+    case 'P': {
+      TradeEvent e;
+      if (!decode_itch_trade(msg, &e)) return false;
+      fn(e);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
 } // namespace ob::ingest
@@ -0,0 +1,146 @@
+#pragma once
+#include "ob/events.hpp"
+#include "ob/ingest/itch.hpp"
+#include "ob/spsc_ring.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace ob::ingest {
+
+// Stock Directory with an owned symbol: the frame it was decoded from is gone by the
+// time the book stage sees it.
+struct DirectoryRecord {
+  StockLocate locate{};
+  std::uint8_t len{};
+  char symbol[8]{};
+};
+
+using DecodedEvent = std::variant<DirectoryRecord, AddEvent, CancelEvent, DeleteEvent, ExecuteEvent, ReplaceEvent,
+                                  TradeEvent>;
+
+struct TimedEvent {
+  std::uint64_t timestamp{};
+  DecodedEvent event;
+};
+
+struct PipelineConfig {
+  std::size_t frame_ring{4096};    // receive -> decode, in frames
+  std::size_t event_ring{1 << 16}; // decode -> book, in events
+  int recv_cpu{-1};                // -1: not pinned
+  int decode_cpu{-1};
+  int book_cpu{-1};
+  ItchFilter filter; // applied by the decode stage
+};
+
+struct RingStats {
+  std::size_t capacity{};
+  std::size_t occupancy{};
+  std::size_t high_water{};
+  std::uint64_t pushed{};
+  std::uint64_t full_stalls{}; // producer waited for room: the downstream stage is the bottleneck
+  std::uint64_t empty_polls{}; // consumer found nothing: the upstream stage is the bottleneck
+};
+
+struct PipelineStats {
+  RingStats frames;
+  RingStats events;
+  std::uint64_t messages{};       // decoded and handed on
+  std::uint64_t skipped{};        // dropped by PipelineConfig::filter
+  std::uint64_t events_applied{};
+  std::uint64_t stopped_frames{}; // frames whose decoding stopped at an unknown or incomplete message
+  std::uint64_t leftover_bytes{}; // bytes of those frames left undecoded
+  std::uint64_t last_stop_frame{}; // 0-based index of the latest such frame, and where in it
+  std::uint64_t last_stop_offset{};
+};
+
+// Pins the calling thread to cpu; -1 is a no-op. False if the kernel refused.
+bool pin_current_thread(int cpu);
+
+// Three stages, each on its own thread and optionally pinned:
+//   receive: source() yields raw ITCH payloads (a SoupBin sequenced frame, a file)
+//   decode:  frames -> TimedEvents for book-affecting messages; each decoded frame's
+//            buffer goes back to the receive stage through a second ring for reuse
+//   book:    drain() on the caller's thread hands each event to the book
+class IngestPipeline {
+public:
+  // Fills *payload with the next block of back-to-back ITCH messages; false at end.
+  // *payload arrives empty, usually holding a buffer the decode stage has finished
+  // with: fill it in place (assign, resize, swap) so its capacity is reused.
+  using Source = std::function<bool(std::vector<std::uint8_t>* payload)>;
+
+  explicit IngestPipeline(const PipelineConfig& cfg);
+  ~IngestPipeline();
+  IngestPipeline(const IngestPipeline&) = delete;
+  IngestPipeline& operator=(const IngestPipeline&) = delete;
+
+  // Starts the receive and decode threads.
+  void start(Source source);
+
+  // Book stage: fn(timestamp, event) for every decoded event until the source ends and
+  // both rings are empty, then joins the other stages. Directory events arrive as
+  // StockDirectoryEvent.
+  template <typename Fn>
+  void drain(Fn&& fn) {
+    pin_current_thread(cfg_.book_cpu);
+    TimedEvent ev;
+    for (;;) {
+      if (!events_.try_pop(&ev)) {
+        if (!decode_done_.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+          continue;
+        }
+        if (!events_.try_pop(&ev)) break;
+      }
+      std::visit([&](const auto& e) { deliver(ev.timestamp, e, fn); }, ev.event);
+      applied_.store(applied_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    join();
+  }
+
+  // Safe to call from any thread while running.
+  PipelineStats stats() const;
+  // Messages decoded per ITCH type and the filter's counts; valid after drain() returns.
+  const std::array<std::uint64_t, 256>& type_counts() const { return type_counts_; }
+  const ItchFilterStats& filter_stats() const { return filter_stats_; }
+
+private:
+  template <typename Fn>
+  static void deliver(std::uint64_t ts, const DirectoryRecord& d, Fn& fn) {
+    fn(ts, StockDirectoryEvent{.locate=d.locate, .symbol=std::string_view(d.symbol, d.len)});
+  }
+  template <typename E, typename Fn>
+  static void deliver(std::uint64_t ts, const E& e, Fn& fn) {
+    fn(ts, e);
+  }
+
+  void recv_loop(Source source);
+  void decode_loop();
+  void join();
+
+  PipelineConfig cfg_;
+  SpscRing<std::vector<std::uint8_t>> frames_;
+  SpscRing<std::vector<std::uint8_t>> spare_frames_; // decode -> receive: emptied buffers
+  SpscRing<TimedEvent> events_;
+  std::atomic<bool> recv_done_{false};
+  std::atomic<bool> decode_done_{false};
+  std::atomic<std::uint64_t> messages_{0};
+  std::atomic<std::uint64_t> skipped_{0};
+  std::atomic<std::uint64_t> applied_{0};
+  std::atomic<std::uint64_t> stopped_frames_{0};
+  std::atomic<std::uint64_t> leftover_bytes_{0};
+  std::atomic<std::uint64_t> last_stop_frame_{0};
+  std::atomic<std::uint64_t> last_stop_offset_{0};
+  std::array<std::uint64_t, 256> type_counts_{};
+  ItchFilterStats filter_stats_;
+  std::thread recv_;
+  std::thread decode_;
+};
+
+} // namespace ob::ingest
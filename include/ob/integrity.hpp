@@ -0,0 +1,88 @@
+#pragma once
+#include "listener.hpp"
+#include "symbol_book.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ob {
+
+struct IntegrityConfig {
+  std::uint32_t sample_every{64}; // level changes between slice checks; 0: O(1) checks only
+  std::uint32_t slice_levels{4};  // levels walked order by order per slice
+  std::uint32_t slice_buckets{8}; // order-index buckets checked per slice
+  double max_overhead{0.01};      // slice time / wall time since the first change
+};
+
+struct IntegrityStats {
+  std::uint64_t updates{};         // level changes seen
+  std::uint64_t slices{};          // slice checks run
+  std::uint64_t throttled{};       // slice checks skipped to stay under max_overhead
+  std::uint64_t levels_checked{};  // levels walked by slices
+  std::uint64_t orders_checked{};  // orders walked by slices (level FIFOs + order index)
+  std::uint64_t check_ns{};        // time spent in slices
+
+  // Violations.
+  std::uint64_t crossed{};         // best bid >= best ask after a change
+  std::uint64_t level_mismatch{};  // touched level disagrees with its update, or a walked
+                                   // level's FIFO disagrees with its totals or ordering
+  std::uint64_t order_mismatch{};  // order index entry disagrees with its level
+  StockLocate last_violation{};    // locate of the most recent violation
+
+  std::uint64_t violations() const { return crossed + level_mismatch + order_mismatch; }
+};
+
+// Continuous, budgeted replacement for SymbolBook::validate() in production.
+//
+// On every level change, in O(1): the book is not crossed, and the touched level
+// matches the update (qty and count agree, an empty update means the level is gone).
+// Every sample_every changes, a slice of the changed book: the next slice_levels
+// levels of a rotating cursor are walked order by order, resuming past the last price
+// walked with one search (SymbolBook::for_each_level_after()), so a slice costs the
+// same at any depth; and the next slice_buckets
+// buckets of the order index are checked against their levels. Slices are timed and
+// skipped while their share of wall time exceeds max_overhead.
+//
+// Install with OrderBook::set_listener(); set_next() chains the listener it displaces.
+class IntegrityChecker final : public BookListener {
+public:
+  explicit IntegrityChecker(const IntegrityConfig& cfg = {}) : cfg_(cfg) {}
+
+  void set_next(BookListener* next) { next_ = next; }
+  const IntegrityConfig& config() const { return cfg_; }
+  const IntegrityStats& stats() const { return stats_; }
+
+  void on_level(const SymbolBook& book, const LevelUpdate& u) override;
+  void on_reset(const SymbolBook& book) override;
+  void on_trade(const SymbolBook& book, const TradeUpdate& t) override {
+    if (next_) next_->on_trade(book, t);
+  }
+
+  // Runs one slice on book now, regardless of sampling and overhead.
+  void check_slice(const SymbolBook& book);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Cursor {
+    Price after{};          // last price walked on `side`, if resume
+    bool resume{false};     // false: start `side` at its best level
+    Side side{Side::Buy};
+    std::size_t bucket{};   // next order-index bucket
+  };
+
+  void violation(std::uint64_t* counter, StockLocate locate);
+  bool check_level(const Level& l, Side s, const Level* better) const;
+  Cursor& cursor(StockLocate locate);
+
+  IntegrityConfig cfg_;
+  IntegrityStats stats_;
+  BookListener* next_{nullptr};
+  std::vector<Cursor> cursors_; // by locate, grown on demand
+  std::uint32_t until_slice_{0};
+  bool started_{false};
+  Clock::time_point start_;
+};
+
+} // namespace ob
@@ -0,0 +1,143 @@
+#pragma once
+#include "ob/spsc_ring.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ob::io {
+
+// Raw receive capture: every frame exactly as received, in receive order.
+//
+// File layout (little-endian):
+//   CaptureFileHeader
+//   { CaptureRecordHeader, payload[length], zero pad to 8 bytes }*
+//
+// Rolling: the first file is `path`, then `path.1`, `path.2`, ... Each file starts
+// with its own header, and a record never spans two files.
+
+inline constexpr char kCaptureMagic[8] = {'O', 'B', 'C', 'A', 'P', 'T', 'U', 'R'};
+inline constexpr std::uint32_t kCaptureVersion = 1;
+
+struct CaptureFileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t file_index; // 0 for `path`, n for `path.n`
+};
+
+struct CaptureRecordHeader {
+  std::uint64_t recv_ns; // CLOCK_REALTIME at receipt
+  std::uint32_t length;  // payload bytes
+  char type;             // SoupBin packet type
+  std::uint8_t reserved[3];
+};
+static_assert(sizeof(CaptureRecordHeader) == 16);
+
+struct CaptureConfig {
+  std::uint64_t roll_bytes{std::uint64_t{1} << 30}; // start a new file past this size; 0 never
+  std::size_t chunk_bytes{std::size_t{4} << 20};     // unit of handoff and of each write
+  std::size_t ring_chunks{64};                       // chunks in flight to the writer
+  bool direct{false};                                // O_DIRECT writes (chunk_bytes must be 4 KiB aligned)
+};
+
+struct CaptureStats {
+  std::uint64_t records{};
+  std::uint64_t bytes{};
+  std::uint64_t files{};
+  std::uint64_t chunks_allocated{}; // beyond the initial set: the writer fell behind
+  std::uint64_t stalls{};           // record() waited because ring_chunks chunks were queued
+};
+
+// Hot path: record() copies into the current chunk with no locks and no syscalls.
+// Full chunks go to the writer thread through an SPSC ring and come back through a
+// second one for reuse; if none is free a new chunk is allocated rather than waiting.
+class CaptureWriter {
+public:
+  CaptureWriter() = default;
+  ~CaptureWriter();
+  CaptureWriter(const CaptureWriter&) = delete;
+  CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+  // False if the file cannot be created or the chunks cannot be allocated.
+  bool open(const std::string& path, const CaptureConfig& cfg = {});
+  bool close(); // flushes, joins the writer; false on any write error
+
+  void record(char type, const std::uint8_t* data, std::size_t len, std::uint64_t recv_ns);
+  bool is_open() const { return writer_.joinable(); }
+  // From the recording thread, or after close().
+  CaptureStats stats() const;
+
+  static std::uint64_t now_ns();
+
+private:
+  struct Chunk {
+    std::unique_ptr<std::uint8_t, void (*)(void*)> data{nullptr, nullptr};
+    std::size_t used{0};
+    bool roll_after{false}; // writer starts the next file after writing this chunk
+  };
+
+  // Allocates a chunk owned by chunks_; nullptr if memory runs out.
+  Chunk* make_chunk();
+  void put(const void* p, std::size_t n);
+  void hand_off(bool roll_after);
+  void writer_loop();
+  bool open_file(std::uint32_t index);
+  bool write_chunk(Chunk& c);
+  bool close_file();
+
+  CaptureConfig cfg_{};
+  std::string path_;
+  // Owns every chunk; the rings and current_ hold borrowed pointers. Only the
+  // recording thread adds to it.
+  std::vector<std::unique_ptr<Chunk>> chunks_;
+  std::unique_ptr<SpscRing<Chunk*>> full_;
+  std::unique_ptr<SpscRing<Chunk*>> free_;
+  Chunk* current_{nullptr};
+  std::uint64_t file_bytes_{0}; // recording thread's count for the current file
+  std::uint32_t file_index_{0};
+  bool roll_pending_{false};    // next record() starts a new file
+  std::uint64_t records_{0};
+  std::uint64_t bytes_{0};
+  std::uint64_t chunks_allocated_{0};
+  std::uint64_t stalls_{0}; // kept across close()
+
+  // Writer thread state.
+  int fd_{-1};
+  bool direct_{false};
+  std::uint64_t fd_bytes_{0};
+  std::atomic<std::uint64_t> files_{0};
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> failed_{false};
+  std::thread writer_;
+};
+
+// Walks the records of one capture file held in memory. fn(const CaptureRecordHeader&,
+// std::span<const std::uint8_t> payload). Returns false on a malformed or foreign buffer.
+template <typename Fn>
+bool for_each_capture_record(const std::uint8_t* data, std::size_t size, Fn&& fn) {
+  CaptureFileHeader fh;
+  if (size < sizeof(fh)) return false;
+  std::memcpy(&fh, data, sizeof(fh));
+  if (std::memcmp(fh.magic, kCaptureMagic, sizeof(fh.magic)) != 0 || fh.version != kCaptureVersion) return false;
+  std::size_t off = sizeof(fh);
+  while (off + sizeof(CaptureRecordHeader) <= size) {
+    CaptureRecordHeader h;
+    std::memcpy(&h, data + off, sizeof(h));
+    off += sizeof(h);
+    if (h.length > size - off) return false;
+    fn(h, std::span<const std::uint8_t>(data + off, h.length));
+    off += (h.length + 7) & ~std::size_t{7};
+  }
+  return off >= size;
+}
+
+inline bool is_capture_file(const std::uint8_t* data, std::size_t size) {
+  return size >= sizeof(kCaptureMagic) && std::memcmp(data, kCaptureMagic, sizeof(kCaptureMagic)) == 0;
+}
+
+} // namespace ob::io
@@ -0,0 +1,102 @@
+#pragma once
+#include "ob/io/journal.hpp"
+#include "ob/order_book.hpp"
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace ob::io {
+
+// Periodic per-symbol L3 checkpoints of a journal, for as-of book queries.
+//
+// File layout:
+//   CheckpointFileHeader
+//   { CheckpointHeader, CheckpointOrder[orders] }*    one per (symbol, grid point)
+//   CheckpointRef[checkpoints]                        sorted by (locate, timestamp)
+//
+// A checkpoint stamped g holds every resting order of one symbol after all journal
+// records with timestamp <= g, bids then asks, each level best to worst and each
+// level's orders in time priority. next_record is the first journal record it does not
+// include. A symbol is checkpointed at g only if it changed since its previous one.
+
+inline constexpr char kCheckpointMagic[8] = {'O', 'B', 'C', 'K', 'P', 'T', 'L', '3'};
+inline constexpr std::uint32_t kCheckpointVersion = 1;
+
+struct CheckpointFileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t reserved;
+  std::uint64_t interval_ns;
+  std::uint64_t journal_records; // journal this index was built from
+  std::uint64_t checkpoints;
+  std::uint64_t refs_offset;
+};
+
+struct CheckpointHeader {
+  std::uint64_t timestamp;
+  std::uint64_t next_record;
+  StockLocate locate;
+  std::uint16_t reserved;
+  std::uint32_t orders;
+  char symbol[8]; // space padded
+};
+
+struct CheckpointOrder {
+  OrderId order_id;
+  Price price;
+  Qty qty;
+  std::uint32_t mpid;
+  Side side;
+  std::uint8_t has_mpid;
+  std::uint16_t reserved;
+};
+static_assert(sizeof(CheckpointOrder) == 24);
+
+struct CheckpointRef {
+  std::uint64_t timestamp;
+  std::uint64_t offset; // of the CheckpointHeader
+  StockLocate locate;
+  std::uint16_t reserved[3];
+};
+
+// Replays the whole journal once and writes checkpoints every interval_ns of ITCH time.
+bool build_checkpoints(const JournalReader& journal, const std::string& path, std::uint64_t interval_ns);
+
+struct AsOfStats {
+  std::uint64_t checkpoint_ts{}; // 0 when no checkpoint applied (replayed from the start)
+  std::uint64_t restored_orders{};
+  std::uint64_t replayed_records{};
+};
+
+// Memory-mapped checkpoint index plus the journal it was built from.
+class CheckpointReader {
+public:
+  CheckpointReader() = default;
+  ~CheckpointReader();
+  CheckpointReader(const CheckpointReader&) = delete;
+  CheckpointReader& operator=(const CheckpointReader&) = delete;
+
+  // journal must stay open while this reader is used; fails if it is not the journal
+  // the checkpoints were built from.
+  bool open(const std::string& path, const JournalReader& journal);
+  void close();
+
+  std::uint64_t interval_ns() const { return interval_ns_; }
+  std::size_t checkpoint_count() const { return refs_.size(); }
+
+  // Rebuilds locate's L3 book as of ts (every record with timestamp <= ts) in book,
+  // resetting it first if already registered. False if the symbol is unknown by then,
+  // even if book still registers it from an earlier, later-dated query.
+  bool book_at(StockLocate locate, std::uint64_t ts, OrderBook& book, AsOfStats* stats = nullptr) const;
+
+private:
+  const CheckpointRef* find(StockLocate locate, std::uint64_t ts) const;
+
+  const std::uint8_t* data_{nullptr};
+  std::size_t size_{0};
+  std::uint64_t interval_ns_{0};
+  std::span<const CheckpointRef> refs_;
+  const JournalReader* journal_{nullptr};
+};
+
+} // namespace ob::io
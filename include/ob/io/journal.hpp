@@ -0,0 +1,208 @@
+#pragma once
+#include "ob/events.hpp"
+#include "ob/order_book.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ob::io {
+
+// Pre-decoded event journal: one fixed-width little-endian record per book event, so a
+// day decoded once from ITCH can be replayed many times without framing or field parsing.
+//
+// File layout:
+//   JournalFileHeader
+//   JournalRecord[records]                        grouped into blocks of block_records
+//   index: JournalIndexEntry[index_locates], then u32 block ids (ascending per locate)
+//
+// The index lists, for every locate, the blocks holding at least one of its records,
+// so one symbol replays by touching only those blocks.
+
+static_assert(std::endian::native == std::endian::little, "journal records are little-endian");
+
+inline constexpr char kJournalMagic[8] = {'O', 'B', 'J', 'R', 'N', 'L', 'E', 'V'};
+inline constexpr std::uint32_t kJournalVersion = 2; // 2: Trade records, Execute prices
+
+enum class JournalKind : std::uint8_t { Directory = 1, Add, Cancel, Delete, Execute, Replace, Trade };
+
+inline constexpr std::uint8_t kJournalSell = 0x01;
+inline constexpr std::uint8_t kJournalHasMpid = 0x02;
+inline constexpr std::uint8_t kJournalHasPrice = 0x04;    // Execute from ITCH 'C'
+inline constexpr std::uint8_t kJournalNonPrintable = 0x08; // Execute
+
+struct JournalRecord {
+  std::uint64_t timestamp; // nanoseconds since midnight
+  std::uint64_t order_id;  // Replace: old order id
+  std::uint64_t aux;       // Replace: new order id; Add: mpid; Directory: symbol, space padded
+  Price price;             // Add, Replace, Trade; Execute with kJournalHasPrice
+  Qty qty;                 // Add, Replace: new qty; Cancel, Execute: delta; Trade
+  StockLocate locate;
+  JournalKind kind;
+  std::uint8_t flags;      // kJournal* bits
+  std::uint32_t reserved;
+};
+static_assert(sizeof(JournalRecord) == 40);
+
+struct JournalFileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t block_records;
+  std::uint64_t records;
+  std::uint64_t index_offset;  // 0 until the writer closes cleanly
+  std::uint32_t index_locates;
+  std::uint32_t reserved;
+};
+
+struct JournalIndexEntry {
+  StockLocate locate;
+  std::uint16_t reserved;
+  std::uint32_t first; // into the block id array
+  std::uint32_t count;
+};
+
+struct JournalConfig {
+  std::uint32_t block_records{4096};
+};
+
+class JournalWriter {
+public:
+  JournalWriter() = default;
+  ~JournalWriter();
+  JournalWriter(const JournalWriter&) = delete;
+  JournalWriter& operator=(const JournalWriter&) = delete;
+
+  bool open(const std::string& path, const JournalConfig& cfg = {});
+  bool close(); // writes the index and patches the header; false on any write error
+
+  void append(std::uint64_t ts, const StockDirectoryEvent& e);
+  void append(std::uint64_t ts, const AddEvent& e);
+  void append(std::uint64_t ts, const CancelEvent& e);
+  void append(std::uint64_t ts, const DeleteEvent& e);
+  void append(std::uint64_t ts, const ExecuteEvent& e);
+  void append(std::uint64_t ts, const ReplaceEvent& e);
+  void append(std::uint64_t ts, const TradeEvent& e);
+
+  std::uint64_t records() const { return records_; }
+
+private:
+  void push(const JournalRecord& r);
+  bool flush_block();
+
+  JournalConfig cfg_{};
+  std::FILE* file_{nullptr};
+  std::uint64_t records_{0};
+  std::uint32_t block_{0}; // id of the block being filled
+  bool write_failed_{false};
+  std::vector<JournalRecord> buf_;
+  std::vector<std::vector<std::uint32_t>> blocks_by_locate_;
+};
+
+// Converts a record back to the event it was written from and hands it to
+// fn(const XxxEvent&). Directory symbols point into the record.
+template <typename Fn>
+bool visit_journal_event(const JournalRecord& r, Fn&& fn) {
+  switch (r.kind) {
+    case JournalKind::Directory: {
+      const char* s = reinterpret_cast<const char*>(&r.aux);
+      std::size_t len = sizeof(r.aux);
+      while (len > 0 && s[len - 1] == ' ') --len;
+      fn(StockDirectoryEvent{.locate=r.locate, .symbol=std::string_view(s, len)});
+      return true;
+    }
+    case JournalKind::Add:
+      fn(AddEvent{.locate=r.locate, .order_id=r.order_id,
+                  .side=(r.flags & kJournalSell) ? Side::Sell : Side::Buy, .qty=r.qty, .price=r.price,
+                  .mpid=static_cast<std::uint32_t>(r.aux), .has_mpid=(r.flags & kJournalHasMpid) != 0});
+      return true;
+    case JournalKind::Cancel:
+      fn(CancelEvent{.locate=r.locate, .order_id=r.order_id, .cancel_qty=r.qty});
+      return true;
+    case JournalKind::Delete:
+      fn(DeleteEvent{.locate=r.locate, .order_id=r.order_id});
+      return true;
+    case JournalKind::Execute:
+      fn(ExecuteEvent{.locate=r.locate, .order_id=r.order_id, .exec_qty=r.qty, .price=r.price,
+                      .has_price=(r.flags & kJournalHasPrice) != 0,
+                      .printable=(r.flags & kJournalNonPrintable) == 0});
+      return true;
+    case JournalKind::Replace:
+      fn(ReplaceEvent{.locate=r.locate, .old_order_id=r.order_id, .new_order_id=r.aux,
+                      .new_qty=r.qty, .new_price=r.price});
+      return true;
+    case JournalKind::Trade:
+      fn(TradeEvent{.locate=r.locate, .order_id=r.order_id,
+                    .side=(r.flags & kJournalSell) ? Side::Sell : Side::Buy, .qty=r.qty, .price=r.price});
+      return true;
+  }
+  return false;
+}
+
+// Memory-mapped reader for files written by JournalWriter.
+class JournalReader {
+public:
+  JournalReader() = default;
+  ~JournalReader();
+  JournalReader(const JournalReader&) = delete;
+  JournalReader& operator=(const JournalReader&) = delete;
+
+  // Fails on a journal whose writer did not close (no index).
+  bool open(const std::string& path);
+  void close();
+
+  std::span<const JournalRecord> records() const { return records_; }
+  std::uint32_t block_records() const { return block_records_; }
+  std::size_t block_count() const {
+    return (records_.size() + block_records_ - 1) / block_records_;
+  }
+  std::span<const JournalRecord> block(std::uint32_t id) const;
+  // Blocks holding records for locate, ascending; empty if none.
+  std::span<const std::uint32_t> blocks_for(StockLocate locate) const;
+
+  // fn(const JournalRecord&) over every record, or over one locate's records, in order.
+  template <typename Fn>
+  void for_each(Fn&& fn) const {
+    for (const JournalRecord& r : records_) fn(r);
+  }
+  template <typename Fn>
+  void for_each(StockLocate locate, Fn&& fn) const {
+    for (std::uint32_t id : blocks_for(locate)) {
+      for (const JournalRecord& r : block(id)) {
+        if (r.locate == locate) fn(r);
+      }
+    }
+  }
+
+  // fn(index, record) over locate's records from journal position `from` on, until fn
+  // returns false.
+  template <typename Fn>
+  void scan(StockLocate locate, std::uint64_t from, Fn&& fn) const {
+    auto ids = blocks_for(locate);
+    auto it = std::lower_bound(ids.begin(), ids.end(), from / block_records_);
+    for (; it != ids.end(); ++it) {
+      const std::uint64_t base = std::uint64_t{*it} * block_records_;
+      auto b = block(*it);
+      for (std::size_t i = (base < from) ? from - base : 0; i < b.size(); ++i) {
+        if (b[i].locate == locate && !fn(base + i, b[i])) return;
+      }
+    }
+  }
+
+  // Applies the whole day, or one symbol, to book. Returns records applied.
+  std::uint64_t replay(OrderBook& book) const;
+  std::uint64_t replay(OrderBook& book, StockLocate locate) const;
+
+private:
+  const std::uint8_t* data_{nullptr};
+  std::size_t size_{0};
+  std::uint32_t block_records_{1};
+  std::span<const JournalRecord> records_;
+  std::span<const JournalIndexEntry> index_;
+  std::span<const std::uint32_t> block_ids_;
+};
+
+} // namespace ob::io
@@ -0,0 +1,169 @@
+#pragma once
+#include "ob/listener.hpp"
+#include "ob/types.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ob::io {
+
+// Single-writer, multi-reader market data broadcast over POSIX shared memory.
+//
+// Segment layout: ShmFeedHeader | ShmSlot ring[ring_capacity] | ShmSymbolState table[max_locates]
+//
+// The writer never waits for readers. Each ring slot and each state entry is guarded
+// by its own sequence word, so readers detect torn or lapped data and retry/resync
+// without locks or syscalls.
+//
+// A restarted publisher never reuses a live segment: it unlinks the name, creates a
+// fresh segment with the next epoch, then stores that epoch into the old one. Readers
+// still mapped to the old segment see the epoch change as an overrun, and resync()
+// reattaches them to the new one.
+
+inline constexpr std::uint64_t kShmFeedMagic = 0x4F42'53484D'4656ULL; // "OBSHMFV"
+inline constexpr std::uint32_t kShmFeedVersion = 2;
+inline constexpr std::size_t kShmDepth = 10; // levels per side kept in the state table
+
+enum class ShmRecordKind : std::uint8_t { Level = 1, Bbo = 2 };
+
+// Decoded ring record as seen by a reader. For Level records the bid_* fields carry
+// the level (side says which book side). For Bbo records bid_* and ask_* are the top.
+struct ShmUpdate {
+  std::uint64_t seq{};
+  ShmRecordKind kind{};
+  Side side{};
+  StockLocate locate{};
+  Price bid_price{};
+  std::uint32_t bid_count{};
+  std::uint64_t bid_qty{};
+  Price ask_price{};
+  std::uint32_t ask_count{};
+  std::uint64_t ask_qty{};
+};
+
+struct ShmLevel {
+  Price price{};
+  std::uint32_t count{};
+  std::uint64_t qty{};
+};
+
+// Latest state of one symbol, as copied out of the table by a reader.
+struct ShmSymbolSnapshot {
+  std::uint64_t last_seq{}; // ring seq of the newest record folded into this state
+  std::uint32_t bid_levels{};
+  std::uint32_t ask_levels{};
+  ShmLevel bids[kShmDepth]{};
+  ShmLevel asks[kShmDepth]{};
+};
+
+struct alignas(64) ShmFeedHeader {
+  std::uint64_t magic;
+  std::uint32_t version;
+  std::uint32_t max_locates;
+  std::uint64_t ring_capacity; // power of two
+  std::atomic<std::uint64_t> epoch; // this segment's generation; raised once it is replaced
+  alignas(64) std::atomic<std::uint64_t> write_seq; // records published so far
+};
+
+struct alignas(64) ShmSlot {
+  std::atomic<std::uint64_t> seq; // seq of the record in the slot, kShmBusy while writing
+  ShmUpdate rec;
+};
+
+struct alignas(64) ShmSymbolState {
+  std::atomic<std::uint64_t> version; // odd while the writer is updating
+  ShmSymbolSnapshot snap;
+};
+
+struct ShmFeedConfig {
+  std::uint64_t ring_capacity{1 << 20}; // rounded up to a power of two
+  std::uint32_t max_locates{16384};
+};
+
+// Publishes level and BBO updates. Install on an OrderBook with set_listener().
+class ShmPublisher final : public BookListener {
+public:
+  ShmPublisher() = default;
+  ~ShmPublisher() override;
+  ShmPublisher(const ShmPublisher&) = delete;
+  ShmPublisher& operator=(const ShmPublisher&) = delete;
+
+  // Creates a new segment under name, e.g. "/ob_feed", replacing any existing one
+  // (see the epoch above).
+  bool create(const std::string& name, const ShmFeedConfig& cfg);
+  // Unmaps; unlink also removes the name so new readers cannot attach.
+  void close(bool unlink = true);
+
+  void on_level(const SymbolBook& book, const LevelUpdate& u) override;
+  // Empties the symbol's state and publishes an empty Bbo record.
+  void on_reset(const SymbolBook& book) override;
+
+  std::uint64_t published() const { return next_seq_ - 1; }
+
+private:
+  std::uint64_t publish(const ShmUpdate& rec);
+  void refresh_side(ShmSymbolSnapshot& snap, const SymbolBook& book, Side s);
+
+  std::string name_;
+  void* base_{nullptr};
+  std::size_t size_{0};
+  ShmFeedHeader* hdr_{nullptr};
+  ShmSlot* ring_{nullptr};
+  ShmSymbolState* table_{nullptr};
+  std::uint64_t mask_{0};
+  std::uint64_t next_seq_{1};
+};
+
+// Read-only view of a segment. Each process (or thread) owns its own cursor.
+class ShmSubscriber {
+public:
+  enum class Poll : std::uint8_t { Empty, Update, Overrun };
+
+  ShmSubscriber() = default;
+  ~ShmSubscriber();
+  ShmSubscriber(const ShmSubscriber&) = delete;
+  ShmSubscriber& operator=(const ShmSubscriber&) = delete;
+
+  // Attaches and starts at the live edge (only records published from now on).
+  bool attach(const std::string& name);
+  void detach();
+
+  // Returns Update and fills out, Empty if caught up, or Overrun if the writer lapped
+  // this reader or the publisher restarted. After Overrun call resync() and rebuild
+  // from read_state().
+  Poll poll(ShmUpdate* out);
+
+  // Jumps to the live edge, first reattaching to the segment now under the name if
+  // the publisher restarted (it stays on the old one, and poll() keeps reporting
+  // Overrun, until the new segment is ready). Records with seq <= a state's last_seq
+  // are already folded into that state and can be skipped.
+  void resync();
+
+  // Consistent copy of one symbol's state. False if locate is out of range, if the
+  // publisher restarted (resync() first), or if the entry stays mid-update because
+  // the writer died during it.
+  bool read_state(StockLocate locate, ShmSymbolSnapshot* out) const;
+
+  std::uint64_t overruns() const { return overruns_; }
+  std::uint64_t cursor() const { return cursor_; }
+
+private:
+  static constexpr int kStateReadTries = 1 << 16;
+
+  // Maps and checks the segment under name; replaces the current mapping only on success.
+  bool map_segment(const std::string& name);
+
+  std::string name_;
+  std::uint64_t epoch_{0};
+  const void* base_{nullptr};
+  std::size_t size_{0};
+  const ShmFeedHeader* hdr_{nullptr};
+  const ShmSlot* ring_{nullptr};
+  const ShmSymbolState* table_{nullptr};
+  std::uint64_t mask_{0};
+  std::uint64_t cursor_{0}; // seq of the last record consumed
+  std::uint64_t overruns_{0};
+};
+
+} // namespace ob::io
@@ -0,0 +1,164 @@
+#pragma once
+#include "ob/order_book.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ob::io {
+
+// Time-sampled top-N L2 snapshots in a columnar, little-endian binary file.
+//
+// File layout:
+//   SnapshotFileHeader
+//   chunk*  where chunk = SnapshotChunkHeader + payload (payload padded to 8 bytes)
+//
+// Data chunk ('D') payload, one column after another, each column group 8-byte aligned:
+//   timestamp[rows] u64, locate[rows] u16,
+//   bid_price[depth][rows] i32, bid_qty[depth][rows] u64, bid_count[depth][rows] u32,
+//   ask_price[depth][rows] i32, ask_qty[depth][rows] u64, ask_count[depth][rows] u32
+// Missing levels are written as price 0, qty 0, count 0.
+//
+// Symbol chunk ('S') payload: rows entries of { u16 locate, char symbol[8] } (space padded).
+
+inline constexpr char kSnapshotMagic[8] = {'O', 'B', 'L', '2', 'S', 'N', 'A', 'P'};
+inline constexpr std::uint32_t kSnapshotVersion = 1;
+inline constexpr std::uint32_t kSnapshotDataChunk = 'D';
+inline constexpr std::uint32_t kSnapshotSymbolChunk = 'S';
+
+struct SnapshotFileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t depth;
+  std::uint64_t interval_ns;
+  std::uint64_t reserved;
+};
+
+struct SnapshotChunkHeader {
+  std::uint32_t tag;
+  std::uint32_t rows;
+  std::uint64_t payload_bytes;
+};
+
+struct SnapshotConfig {
+  std::uint32_t depth{5};
+  std::uint64_t interval_ns{100'000'000}; // 100ms
+  std::uint32_t block_rows{8192};         // rows per data chunk
+};
+
+// Records one row per registered symbol at every grid point. Rows are built on the
+// replay thread into a block; full blocks are handed to a writer thread and replaced
+// by a spare, so the replay thread never waits on disk.
+class SnapshotWriter {
+public:
+  SnapshotWriter() = default;
+  ~SnapshotWriter();
+  SnapshotWriter(const SnapshotWriter&) = delete;
+  SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+  bool open(const std::string& path, const SnapshotConfig& cfg);
+  bool close(); // flushes the partial block, joins the writer; false on any write error
+
+  // Call with each message timestamp before the message is applied. Emits every grid
+  // point strictly before ts, so a row at time g reflects all messages with timestamp <= g.
+  void advance(std::uint64_t ts, const OrderBook& book) {
+    if (next_sample_ == 0) next_sample_ = (ts / cfg_.interval_ns + 1) * cfg_.interval_ns;
+    while (next_sample_ < ts) {
+      sample(next_sample_, book);
+      next_sample_ += cfg_.interval_ns;
+    }
+  }
+
+  // Records rows for every symbol in the book at timestamp ts, regardless of the grid.
+  void sample(std::uint64_t ts, const OrderBook& book);
+
+  std::uint64_t rows() const { return rows_; }
+  std::uint64_t samples() const { return samples_; }
+  std::uint64_t spare_blocks_allocated() const { return spare_allocs_; }
+
+private:
+  struct Block {
+    std::uint32_t rows{0};
+    std::vector<std::uint64_t> timestamp;
+    std::vector<StockLocate> locate;
+    std::vector<Price> bid_price, ask_price;        // [level * block_rows + row]
+    std::vector<std::uint64_t> bid_qty, ask_qty;
+    std::vector<std::uint32_t> bid_count, ask_count;
+  };
+
+  std::unique_ptr<Block> make_block() const;
+  void hand_off();
+  void writer_loop();
+  bool write_block(const Block& b);
+  bool write_symbols();
+
+  SnapshotConfig cfg_{};
+  std::FILE* file_{nullptr};
+  std::uint64_t next_sample_{0};
+  std::uint64_t rows_{0};
+  std::uint64_t samples_{0};
+  std::uint64_t spare_allocs_{0};
+  std::vector<LevelView> scratch_;
+  std::vector<bool> seen_locate_;
+  std::vector<std::pair<StockLocate, std::string>> symbols_;
+
+  std::unique_ptr<Block> current_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::unique_ptr<Block>> pending_;
+  std::vector<std::unique_ptr<Block>> spare_;
+  bool stop_{false};
+  bool write_failed_{false};
+  std::thread writer_;
+};
+
+// Columns of one data chunk, pointing into the mapped file.
+// Level `lvl` of a per-level column starts at column + lvl * rows.
+struct SnapshotBlock {
+  std::uint32_t rows{0};
+  const std::uint64_t* timestamp{nullptr};
+  const StockLocate* locate{nullptr};
+  const Price* bid_price{nullptr};
+  const std::uint64_t* bid_qty{nullptr};
+  const std::uint32_t* bid_count{nullptr};
+  const Price* ask_price{nullptr};
+  const std::uint64_t* ask_qty{nullptr};
+  const std::uint32_t* ask_count{nullptr};
+};
+
+// Memory-mapped, zero-copy reader for files written by SnapshotWriter.
+class SnapshotReader {
+public:
+  SnapshotReader() = default;
+  ~SnapshotReader();
+  SnapshotReader(const SnapshotReader&) = delete;
+  SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+  bool open(const std::string& path);
+  void close();
+
+  std::uint32_t depth() const { return depth_; }
+  std::uint64_t interval_ns() const { return interval_ns_; }
+  std::size_t block_count() const { return blocks_.size(); }
+  const SnapshotBlock& block(std::size_t i) const { return blocks_[i]; }
+  std::uint64_t rows() const { return rows_; }
+
+  // Symbol recorded for locate, empty if the file has none.
+  std::string_view symbol(StockLocate locate) const;
+
+private:
+  const std::uint8_t* data_{nullptr};
+  std::size_t size_{0};
+  std::uint32_t depth_{0};
+  std::uint64_t interval_ns_{0};
+  std::uint64_t rows_{0};
+  std::vector<SnapshotBlock> blocks_;
+  std::vector<std::pair<StockLocate, std::string_view>> symbols_;
+};
+
+} // namespace ob::io
@@ -0,0 +1,292 @@
+#pragma once
+#include "level.hpp"
+#include "types.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace ob {
+
+// Ordering of one book side: Better(a, b) is true when price a ranks ahead of b.
+struct DescBid {
+  bool operator()(Price a, Price b) const { return a > b; }
+};
+struct AscAsk {
+  bool operator()(Price a, Price b) const { return a < b; }
+};
+
+// Level-storage backends for one side of a SymbolBook. Every backend provides:
+//   Level* find(Price) (and const)           nullptr if absent
+//   Level& get_or_create(Price, bool* created)  *created also when an empty level revives
+//   void   erase(Level&)                     level must be empty; may keep it parked
+//   const Level* best() const                nullptr if the side is empty
+//   void   for_each(F) const                 best to worst; stop when F returns false
+//   void   for_each_after(Price, F) const    the same over the levels worse than the price
+//   size(), empty(), reserve(levels), clear()
+//   memory_bytes()                           storage held, estimated from sizes and capacities
+// Level addresses must stay stable while the level exists (orders point at them).
+// Backends take the book's memory resource at construction.
+//
+// Lazy reclamation: erase() leaves the emptied level in place and parks its price, so a
+// level that refills soon after (churn at the inside) costs a lookup instead of an
+// allocator and tree or array operation. At most ParkedPrices::kMax levels per side
+// stay parked; parking one more reclaims the oldest. Parked levels are invisible to
+// find(), best(), the for_each walks and size().
+
+// Prices of the parked empty levels of one side, oldest first.
+class ParkedPrices {
+public:
+  static constexpr std::size_t kMax = 4;
+
+  // Parks p. Returns true with the oldest price in *evicted when that made room.
+  bool push(Price p, Price* evicted) {
+    const bool full = n_ == kMax;
+    if (full) {
+      *evicted = prices_[0];
+      std::copy(prices_.begin() + 1, prices_.end(), prices_.begin());
+      --n_;
+    }
+    prices_[n_++] = p;
+    return full;
+  }
+  // Unparks p if parked.
+  void remove(Price p) {
+    std::size_t i = 0;
+    while (i < n_ && prices_[i] != p) ++i;
+    if (i == n_) return;
+    std::copy(prices_.begin() + static_cast<std::ptrdiff_t>(i) + 1,
+              prices_.begin() + static_cast<std::ptrdiff_t>(n_), prices_.begin() + static_cast<std::ptrdiff_t>(i));
+    --n_;
+  }
+  std::size_t size() const { return n_; }
+  void clear() { n_ = 0; }
+
+private:
+  std::array<Price, kMax> prices_{};
+  std::size_t n_{0};
+};
+
+// Red-black tree keyed by price. Predictable for wide, sparse books.
+template <typename Better>
+class MapLevels {
+public:
+  // One tree node: colour and three links ahead of the value.
+  static constexpr std::size_t kNodeBytes = 4 * sizeof(void*) + sizeof(std::pair<const Price, Level>);
+
+  explicit MapLevels(std::pmr::memory_resource* mr) : map_(mr) {}
+
+  Level* find(Price p) {
+    auto it = map_.find(p);
+    return (it == map_.end() || it->second.empty()) ? nullptr : &it->second;
+  }
+  const Level* find(Price p) const {
+    auto it = map_.find(p);
+    return (it == map_.end() || it->second.empty()) ? nullptr : &it->second;
+  }
+
+  Level& get_or_create(Price p, bool* created) {
+    auto [it, inserted] = map_.try_emplace(p);
+    if (inserted) {
+      it->second.price = p;
+    } else if (it->second.empty()) {
+      parked_.remove(p);
+      inserted = true;
+    }
+    *created = inserted;
+    return it->second;
+  }
+
+  void erase(Level& l) {
+    Price evicted;
+    if (parked_.push(l.price, &evicted)) map_.erase(evicted);
+  }
+
+  const Level* best() const {
+    for (const auto& [price, level] : map_) {
+      if (!level.empty()) return &level;
+    }
+    return nullptr;
+  }
+
+  template <typename F>
+  void for_each(F&& f) const {
+    for (const auto& [price, level] : map_) {
+      if (!level.empty() && !f(level)) return;
+    }
+  }
+
+  template <typename F>
+  void for_each_after(Price p, F&& f) const {
+    for (auto it = map_.upper_bound(p); it != map_.end(); ++it) {
+      if (!it->second.empty() && !f(it->second)) return;
+    }
+  }
+
+  std::size_t size() const { return map_.size() - parked_.size(); }
+  bool empty() const { return size() == 0; }
+  void clear() {
+    map_.clear();
+    parked_.clear();
+  }
+  std::size_t memory_bytes() const { return map_.size() * kNodeBytes; }
+  // Tree nodes cannot be reserved directly; on an empty side, cycle n nodes through
+  // the resource so a pooled resource already holds them when trading starts.
+  void reserve(std::size_t levels) {
+    if (!map_.empty()) return;
+    for (std::size_t i = 0; i < levels; ++i) map_.try_emplace(static_cast<Price>(i));
+    map_.clear();
+  }
+
+private:
+  std::pmr::map<Price, Level, Better> map_;
+  ParkedPrices parked_;
+};
+
+// Sorted flat arrays with the inside at the back. Lookups walk from the inside out
+// for a few steps before falling back to binary search, so activity near the touch
+// costs a short linear scan and an insert shifts only the few better-priced entries.
+// Level objects live in a recycled pool so their addresses stay stable.
+template <typename Better>
+class FlatLevels {
+public:
+  static constexpr std::size_t kLinearProbe = 8;
+
+  explicit FlatLevels(std::pmr::memory_resource* mr)
+    : prices_(mr), levels_(mr), store_(mr), free_(mr) {}
+
+  Level* find(Price p) {
+    std::size_t i = lower_bound(p);
+    return (i < prices_.size() && prices_[i] == p && !levels_[i]->empty()) ? levels_[i] : nullptr;
+  }
+  const Level* find(Price p) const {
+    std::size_t i = lower_bound(p);
+    return (i < prices_.size() && prices_[i] == p && !levels_[i]->empty()) ? levels_[i] : nullptr;
+  }
+
+  Level& get_or_create(Price p, bool* created) {
+    std::size_t i = lower_bound(p);
+    if (i < prices_.size() && prices_[i] == p) {
+      Level* l = levels_[i];
+      *created = l->empty();
+      if (*created) parked_.remove(p);
+      return *l;
+    }
+    Level* l = acquire();
+    l->price = p;
+    prices_.insert(prices_.begin() + static_cast<std::ptrdiff_t>(i), p);
+    levels_.insert(levels_.begin() + static_cast<std::ptrdiff_t>(i), l);
+    *created = true;
+    return *l;
+  }
+
+  void erase(Level& l) {
+    Price evicted;
+    if (parked_.push(l.price, &evicted)) reclaim(evicted);
+  }
+
+  const Level* best() const {
+    for (std::size_t i = levels_.size(); i > 0; --i) {
+      if (!levels_[i - 1]->empty()) return levels_[i - 1];
+    }
+    return nullptr;
+  }
+
+  template <typename F>
+  void for_each(F&& f) const {
+    for (std::size_t i = levels_.size(); i > 0; --i) {
+      if (!levels_[i - 1]->empty() && !f(*levels_[i - 1])) return;
+    }
+  }
+
+  template <typename F>
+  void for_each_after(Price p, F&& f) const {
+    for (std::size_t i = lower_bound(p); i > 0; --i) {
+      if (!levels_[i - 1]->empty() && !f(*levels_[i - 1])) return;
+    }
+  }
+
+  std::size_t size() const { return prices_.size() - parked_.size(); }
+  bool empty() const { return size() == 0; }
+  std::size_t memory_bytes() const {
+    return prices_.capacity() * sizeof(Price) + (levels_.capacity() + free_.capacity()) * sizeof(Level*) +
+           store_.size() * sizeof(Level);
+  }
+
+  void clear() {
+    prices_.clear();
+    levels_.clear();
+    free_.clear();
+    parked_.clear();
+    next_ = 0;
+  }
+
+  void reserve(std::size_t levels) {
+    prices_.reserve(levels);
+    levels_.reserve(levels);
+    free_.reserve(levels);
+    if (store_.size() < levels) store_.resize(levels);
+  }
+
+private:
+  // First index whose price is not worse than p (entries before it are all worse).
+  std::size_t lower_bound(Price p) const {
+    std::size_t i = prices_.size();
+    const std::size_t stop = (i > kLinearProbe) ? i - kLinearProbe : 0;
+    while (i > stop && !better_(p, prices_[i - 1])) --i;
+    if (i > stop || i == 0) return i; // boundary found inside the probe window
+    auto it = std::partition_point(prices_.begin(), prices_.begin() + static_cast<std::ptrdiff_t>(i),
+                                   [&](Price x) { return better_(p, x); });
+    return static_cast<std::size_t>(it - prices_.begin());
+  }
+
+  // Drops the parked level at p from the arrays and recycles it.
+  void reclaim(Price p) {
+    std::size_t i = lower_bound(p);
+    Level* l = levels_[i];
+    prices_.erase(prices_.begin() + static_cast<std::ptrdiff_t>(i));
+    levels_.erase(levels_.begin() + static_cast<std::ptrdiff_t>(i));
+    *l = Level{};
+    free_.push_back(l);
+  }
+
+  Level* acquire() {
+    if (!free_.empty()) {
+      Level* l = free_.back();
+      free_.pop_back();
+      return l;
+    }
+    if (next_ < store_.size()) {
+      Level* l = &store_[next_++];
+      *l = Level{}; // may hold a pre-clear level
+      return l;
+    }
+    store_.emplace_back();
+    ++next_;
+    return &store_.back();
+  }
+
+  Better better_{};
+  std::pmr::vector<Price> prices_;  // worst .. best
+  std::pmr::vector<Level*> levels_; // parallel to prices_
+  std::pmr::deque<Level> store_;
+  std::pmr::vector<Level*> free_;
+  ParkedPrices parked_;
+  std::size_t next_{0}; // store_[next_..] unused since the last clear()
+};
+
+struct MapLevelPolicy {
+  template <typename Better>
+  using side_type = MapLevels<Better>;
+};
+
+struct FlatLevelPolicy {
+  template <typename Better>
+  using side_type = FlatLevels<Better>;
+};
+
+} // namespace ob
@@ -0,0 +1,44 @@
+#pragma once
+#include "types.hpp"
+#include <cstdint>
+
+namespace ob {
+
+class SymbolBook;
+
+// New aggregate state of one price level after a book mutation. qty == 0 and
+// count == 0 mean the level was removed.
+struct LevelUpdate {
+  StockLocate locate{};
+  Side side{};
+  Price price{};
+  std::uint64_t qty{};
+  std::uint32_t count{};
+};
+
+// One execution print. For order executions the price and side are the resting
+// order's (or the 'C' execution price); hidden prints come from TradeEvent.
+struct TradeUpdate {
+  StockLocate locate{};
+  OrderId order_id{};
+  Side side{};      // side of the resting order
+  Price price{};
+  Qty qty{};
+  bool printable{true};
+  bool hidden{false};
+};
+
+// Observer for L2 changes. Called synchronously from the mutating event, after the
+// book's level maps already reflect the change, so book.top()/depth() are current.
+class BookListener {
+public:
+  virtual ~BookListener() = default;
+  virtual void on_level(const SymbolBook& book, const LevelUpdate& u) = 0;
+  // The book was emptied in bulk by SymbolBook::reset(); no on_level() calls are made
+  // for the levels it dropped.
+  virtual void on_reset(const SymbolBook&) {}
+  // An execution or hidden trade, after its on_level() (if any).
+  virtual void on_trade(const SymbolBook&, const TradeUpdate&) {}
+};
+
+} // namespace ob
@@ -0,0 +1,84 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace ob {
+
+// Where a SymbolBook's containers (order index, order pool, level storage) allocate.
+enum class BookMemory : std::uint8_t {
+  Global,    // straight to the upstream resource (malloc by default)
+  PerSymbol, // one unsynchronized pool per SymbolBook
+  Shared     // one unsynchronized pool per OrderBook (one shard's universe)
+};
+
+inline const char* to_string(BookMemory m) {
+  switch (m) {
+    case BookMemory::Global: return "global";
+    case BookMemory::PerSymbol: return "per-symbol";
+    case BookMemory::Shared: return "shared";
+  }
+  return "unknown";
+}
+
+// Bytes held by a book's containers, by part.
+struct MemoryFootprint {
+  std::size_t pool_bytes{};  // order slots and their free list
+  std::size_t index_bytes{}; // order-id map buckets and nodes
+  std::size_t level_bytes{}; // price levels, both sides
+
+  std::size_t total() const { return pool_bytes + index_bytes + level_bytes; }
+  MemoryFootprint& operator+=(const MemoryFootprint& o) {
+    pool_bytes += o.pool_bytes;
+    index_bytes += o.index_bytes;
+    level_bytes += o.level_bytes;
+    return *this;
+  }
+  // Part-wise maximum.
+  static MemoryFootprint max(const MemoryFootprint& a, const MemoryFootprint& b) {
+    return {std::max(a.pool_bytes, b.pool_bytes), std::max(a.index_bytes, b.index_bytes),
+            std::max(a.level_bytes, b.level_bytes)};
+  }
+};
+
+// Pass-through resource that counts calls and bytes. Not thread-safe, like the
+// pools it usually sits under.
+class CountingResource final : public std::pmr::memory_resource {
+public:
+  explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+    : upstream_(upstream) {}
+
+  std::uint64_t allocations() const { return allocations_; }
+  std::uint64_t deallocations() const { return deallocations_; }
+  std::size_t bytes_in_use() const { return bytes_in_use_; }
+  std::size_t peak_bytes() const { return peak_bytes_; }
+  void reset_counts() { allocations_ = deallocations_ = 0; peak_bytes_ = bytes_in_use_; }
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    void* p = upstream_->allocate(bytes, align);
+    ++allocations_;
+    bytes_in_use_ += bytes;
+    if (bytes_in_use_ > peak_bytes_) peak_bytes_ = bytes_in_use_;
+    return p;
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+    upstream_->deallocate(p, bytes, align);
+    ++deallocations_;
+    bytes_in_use_ -= bytes;
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* upstream_;
+  std::uint64_t allocations_{0};
+  std::uint64_t deallocations_{0};
+  std::size_t bytes_in_use_{0};
+  std::size_t peak_bytes_{0};
+};
+
+} // namespace ob
@@ -1,28 +1,131 @@
 #pragma once
+#include "capacity.hpp"
+#include "memory.hpp"
 #include "symbol_book.hpp"
+#include "top_table.hpp"
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace ob {
 
+// When OrderBook::trim_idle() compacts a book: its live orders have fallen below
+// live_fraction of its order slots and it holds at least min_bytes.
+struct TrimPolicy {
+  double live_fraction{0.125};
+  std::size_t min_bytes{64 << 10};
+};
+
+struct TrimStats {
+  std::size_t checked{};
+  std::size_t trimmed{};
+  std::size_t bytes_before{}; // footprint of the trimmed books before and after
+  std::size_t bytes_after{};
+};
+
 // Keeps mapping from locate -> SymbolBook
 class OrderBook {
 public:
-  // Register a symbol (later: from ITCH Stock Directory 'R')
+  // Register a symbol. The level backend comes from backend_for(symbol); the book is
+  // presized from the capacity profile when it has an entry.
   void add_symbol(StockLocate locate, std::string symbol);
+  void add_symbol(StockLocate locate, std::string symbol, LevelBackend backend);
+
+  // Backend registry, consulted at registration: explicit per-symbol choice, else
+  // Flat when the capacity profile shows a book of at most flat_max_levels levels,
+  // else the default.
+  void set_default_backend(LevelBackend b) { default_backend_ = b; }
+  void set_backend(std::string_view symbol, LevelBackend b) { backend_by_symbol_[std::string(symbol)] = b; }
+  void set_flat_max_levels(std::size_t n) { flat_max_levels_ = n; }
+  LevelBackend backend_for(std::string_view symbol) const;
+
+  // Allocation strategy for books registered from now on (see BookMemory). Pools draw
+  // from upstream, which must outlive this OrderBook. Default: PerSymbol over new/delete.
+  void set_memory(BookMemory mode, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+  BookMemory memory() const { return memory_; }
+
+  // Presizing hints for symbols registered from now on (also reserves the locate
+  // table for the profile's symbol count). headroom scales the recorded peaks.
+  void set_capacity_profile(CapacityProfile profile, double headroom = 1.25);
+  // Today's per-symbol peaks, for tomorrow's set_capacity_profile().
+  CapacityProfile capacity_profile() const;
 
   // Apply events (what your ITCH decoder will call later)
+  Status apply(const StockDirectoryEvent& e); // registers the symbol; repeats are no-ops
   Status apply(const AddEvent& e);
   Status apply(const CancelEvent& e);
   Status apply(const DeleteEvent& e);
   Status apply(const ExecuteEvent& e);
   Status apply(const ReplaceEvent& e);
+  Status apply(const TradeEvent& e);
+
+  // Bulk reset (halt, day roll, gap resync): empties one symbol's book, or every book,
+  // keeping registrations, reserved capacity and listeners. See SymbolBook::reset().
+  Status reset(StockLocate locate);
+  void reset();
 
   // Queries
   const SymbolBook* find(StockLocate locate) const;
   SymbolBook*       find(StockLocate locate);
+  std::vector<StockLocate> locates() const; // registered locates, ascending
+
+  // Universe-wide top of book, one row per locate, kept current by apply().
+  const TopTable& tops() const { return tops_; }
+  void mark_top_reference() { tops_.mark_reference(); }
+
+  // Hash of every book's L3 state: the sum over books of their state_hash() mixed with
+  // the locate. Empty books add nothing, so the hashes of replays over disjoint symbol
+  // sets (shards) add up to that of one replay over all of them. O(symbols).
+  std::uint64_t state_hash() const;
+
+  // Memory accounting summed over every book (see SymbolBook::footprint()).
+  MemoryFootprint footprint() const;
+  MemoryFootprint peak_footprint() const;
+
+  // Rebuilds one book in fresh containers (and, under PerSymbol, a fresh pool) sized to
+  // its live orders, so the memory left over from its peak goes back upstream. Time
+  // priority, peaks and the listener are kept and no notifications are sent. Pointers
+  // from find(locate) and into the old book are invalidated.
+  Status compact(StockLocate locate);
+  // Checks up to max_symbols books, resuming after the last one checked, and compacts
+  // those the policy selects. Run it between events, e.g. on a feed-time interval.
+  TrimStats trim_idle(const TrimPolicy& policy, std::size_t max_symbols = SIZE_MAX);
+
+  // Installs an L2 change observer on every current and future symbol.
+  void set_listener(BookListener* l);
 
 private:
-  std::unordered_map<StockLocate, SymbolBook> books_;
+  struct Entry {
+    std::unique_ptr<std::pmr::unsynchronized_pool_resource> pool; // PerSymbol only; outlives book
+    std::unique_ptr<SymbolBook> book;
+    LevelBackend backend{};
+  };
+
+  // Calls fn with the concrete book type so event handlers bind statically.
+  template <typename Fn>
+  Status apply_to(StockLocate locate, Fn&& fn);
+  Entry make_entry(StockLocate locate, std::string symbol, LevelBackend backend) const;
+
+  BookMemory memory_{BookMemory::PerSymbol};
+  std::pmr::memory_resource* upstream_{std::pmr::new_delete_resource()};
+  // Shared pools, newest last; older ones stay alive for the books built on them.
+  // Declared before books_ so the books are destroyed first.
+  std::vector<std::unique_ptr<std::pmr::unsynchronized_pool_resource>> shared_pools_;
+
+  std::unordered_map<StockLocate, Entry> books_;
+  BookListener* listener_{nullptr};
+  TopTable tops_;
+  CapacityProfile capacity_;
+  double headroom_{1.25};
+  StockLocate trim_cursor_{0}; // next locate trim_idle() looks at
+
+  LevelBackend default_backend_{LevelBackend::Map};
+  std::size_t flat_max_levels_{64};
+  std::unordered_map<std::string, LevelBackend> backend_by_symbol_;
 };
 
-} // namespace ob
\ No newline at end of file
+} // namespace ob
@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace ob {
+
+// Bounded single-producer/single-consumer ring. Occupancy and stall counters are
+// relaxed atomics written by one side each, so a monitor thread may read them live.
+template <typename T>
+class SpscRing {
+public:
+  explicit SpscRing(std::size_t capacity) {
+    std::size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+    slots_.resize(cap);
+    mask_ = cap - 1;
+  }
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Producer side.
+  bool try_push(T&& v) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) return false;
+    }
+    slots_[tail & mask_] = std::move(v);
+    tail_.store(tail + 1, std::memory_order_release);
+    const std::size_t used = tail + 1 - head_cache_;
+    if (used > high_water_.load(std::memory_order_relaxed)) high_water_.store(used, std::memory_order_relaxed);
+    return true;
+  }
+  // Spins until there is room; counts one full stall per push that had to wait.
+  void push(T&& v) {
+    if (try_push(std::move(v))) return;
+    full_stalls_.store(full_stalls_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    while (!try_push(std::move(v))) std::this_thread::yield();
+  }
+
+  // Consumer side.
+  bool try_pop(T* out) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        empty_polls_.store(empty_polls_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+      }
+    }
+    *out = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::size_t capacity() const { return mask_ + 1; }
+  std::size_t size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+  std::uint64_t pushed() const { return tail_.load(std::memory_order_relaxed); }
+  std::size_t high_water() const { return high_water_.load(std::memory_order_relaxed); }
+  std::uint64_t full_stalls() const { return full_stalls_.load(std::memory_order_relaxed); }
+  std::uint64_t empty_polls() const { return empty_polls_.load(std::memory_order_relaxed); }
+
+private:
+  std::vector<T> slots_;
+  std::size_t mask_{0};
+  alignas(64) std::atomic<std::size_t> head_{0};
+  std::size_t tail_cache_{0}; // consumer's view of tail_
+  std::atomic<std::uint64_t> empty_polls_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  std::size_t head_cache_{0}; // producer's view of head_
+  std::atomic<std::size_t> high_water_{0};
+  std::atomic<std::uint64_t> full_stalls_{0};
+};
+
+} // namespace ob
@@ -2,21 +2,18 @@
 #include "types.hpp"
 #include "events.hpp"
 #include "level.hpp"
+#include "level_store.hpp"
+#include "listener.hpp"
+#include "memory.hpp"
 #include <deque>
-#include <map>
+#include <functional>
+#include <memory_resource>
 #include <unordered_map>
 #include <vector>
 #include <string>
 
 namespace ob {
 
-struct DescBid {
-  bool operator()(Price a, Price b) const { return a > b; }
-};
-struct AscAsk {
-  bool operator()(Price a, Price b) const { return a < b; }
-};
-
 struct LevelView {
   Price price{};
   std::uint64_t qty{};
@@ -30,66 +27,221 @@ struct TopOfBook {
   LevelView ask{};
 };
 
-// Simple object pool for Orders (no deletes, reuse slots).
+// Simple object pool for Orders (no deletes, reuse slots). Fresh slots are handed
+// out from a bump index, so reset() drops every order in O(1) and keeps the storage.
 class OrderPool {
 public:
+  explicit OrderPool(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+    : storage_(mr), free_list_(mr) {}
+
   Order* allocate();
   void  free(Order* o);
+  // Pre-creates slots so the first n allocations never grow storage.
+  void reserve(std::size_t n);
+  // Forgets every live order; all slots become fresh again.
+  void reset();
 
   // optional sanity
   std::size_t live() const { return live_; }
+  std::size_t capacity() const { return storage_.size(); }
+  std::size_t memory_bytes() const {
+    return storage_.size() * sizeof(Order) + free_list_.capacity() * sizeof(Order*);
+  }
 
 private:
-  std::deque<Order> storage_;
-  std::vector<Order*> free_list_;
+  std::pmr::deque<Order> storage_;
+  std::pmr::vector<Order*> free_list_;
+  std::size_t next_{0}; // storage_[next_..] has never been handed out since the last reset
   std::size_t live_{0};
 };
 
+// Level-storage backend chosen per symbol by OrderBook.
+enum class LevelBackend : std::uint8_t {
+  Map,  // std::map per side: wide, sparse books
+  Flat  // sorted arrays searched from the inside: books packed around the touch
+};
+
+inline const char* to_string(LevelBackend b) {
+  return (b == LevelBackend::Map) ? "map" : "flat";
+}
+
+// splitmix64 finalizer: the mixing step of the state hashes.
+inline std::uint64_t hash_mix(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// One symbol's L3 book. The order index, order pool and listener live here; the
+// price levels and the event logic live in BasicSymbolBook<LevelPolicy>.
+// Every internal container allocates from the memory resource given at
+// construction, which must outlive the book.
 class SymbolBook {
 public:
-  explicit SymbolBook(StockLocate loc = 0, std::string sym = {})
-    : locate_(loc), symbol_(std::move(sym)) {}
+  SymbolBook(StockLocate loc, std::string sym, std::pmr::memory_resource* mr)
+    : locate_(loc), symbol_(std::move(sym)), mr_(mr), orders_(mr), pool_(mr) {}
+  virtual ~SymbolBook() = default;
+  SymbolBook(const SymbolBook&) = delete;
+  SymbolBook& operator=(const SymbolBook&) = delete;
 
   // Book mutation API
-  Status on_add(const AddEvent& e);
-  Status on_cancel(const CancelEvent& e);
-  Status on_delete(const DeleteEvent& e);
-  Status on_execute(const ExecuteEvent& e);
-  Status on_replace(const ReplaceEvent& e);
+  virtual Status on_add(const AddEvent& e) = 0;
+  virtual Status on_cancel(const CancelEvent& e) = 0;
+  virtual Status on_delete(const DeleteEvent& e) = 0;
+  virtual Status on_execute(const ExecuteEvent& e) = 0;
+  virtual Status on_replace(const ReplaceEvent& e) = 0;
+  // Hidden trade: no book change, the listener gets on_trade().
+  Status on_trade(const TradeEvent& e);
 
   // Queries
-  TopOfBook top() const;
+  virtual TopOfBook top() const = 0;
   std::vector<LevelView> depth(Side s, std::size_t n) const;
+  std::pmr::vector<LevelView> depth(Side s, std::size_t n, std::pmr::memory_resource* mr) const;
+  // Non-allocating variant: fills up to n levels into out, returns how many were written.
+  virtual std::size_t depth(Side s, LevelView* out, std::size_t n) const = 0;
+  virtual std::size_t level_count(Side s) const = 0;
+  // L3 walk: fn(level) from best to worst until it returns false. A level's orders run
+  // head -> next in time priority.
+  virtual void for_each_level(Side s, const std::function<bool(const Level&)>& fn) const = 0;
+  // The same walk resumed past price p (a level there or not): only levels worse than
+  // p, found with one search instead of stepping from the best.
+  virtual void for_each_level_after(Side s, Price p, const std::function<bool(const Level&)>& fn) const = 0;
+  virtual const Level* find_level(Side s, Price p) const = 0;
+  const Order* find_order(OrderId id) const {
+    auto it = orders_.find(id);
+    return (it == orders_.end()) ? nullptr : it->second;
+  }
 
   // Debug / correctness
-  bool validate() const;
-
+  virtual bool validate() const = 0;
+  // Bounded slice of validate() over the order index: checks the orders in buckets
+  // [first, first + n) of order_buckets() against their levels. Returns orders checked
+  // and adds the inconsistent ones to *bad.
+  std::size_t check_orders(std::size_t first, std::size_t n, std::uint64_t* bad) const;
+  // Hash of the full L3 state, kept current in O(1) per event: the sum (mod 2^64) over
+  // live orders of a mix of id, side, price, quantity and the id queued just ahead of
+  // it at its level, so time priority counts too. Two books holding the same orders in
+  // the same queues hash alike whatever path led there; 0 for an empty book.
+  std::uint64_t state_hash() const { return state_hash_; }
+
+  // Drops every order and level in bulk (halt, day roll, gap resync) without per-order
+  // teardown or level notifications; the listener gets one on_reset(). Reserved
+  // capacity and the day's peaks are kept.
+  virtual void reset() = 0;
+
+  // Presizing: reserve before the session so the open does not rehash orders_ or
+  // grow the order and level pools. Peaks feed next day's CapacityProfile.
+  virtual void reserve(std::size_t orders, std::size_t levels) = 0;
+  std::size_t order_count() const { return orders_.size(); }
+  std::size_t order_buckets() const { return orders_.bucket_count(); }
+  std::size_t order_capacity() const { return pool_.capacity(); }
+  std::size_t peak_orders() const { return peak_orders_; }
+  std::size_t peak_levels() const { return peak_levels_; }
+
+  // Bytes held by the pool, order index and levels, estimated from container sizes and
+  // capacities (a pooled memory resource may keep more). peak_footprint() is each
+  // part's high-water mark, kept across reset() and compaction.
+  virtual MemoryFootprint footprint() const = 0;
+  virtual MemoryFootprint peak_footprint() const = 0;
+  // Takes over from's peaks; for a book rebuilt in place of from.
+  void carry_peaks(const SymbolBook& from);
+
+  virtual LevelBackend backend() const = 0;
   std::string_view symbol() const { return symbol_; }
   StockLocate locate() const { return locate_; }
+  std::pmr::memory_resource* resource() const { return mr_; }
+
+  // L2 change observer (not owned). nullptr disables notifications.
+  void set_listener(BookListener* l) { listener_ = l; }
+
+protected:
+  void notify(Side s, Price p, std::uint64_t qty, std::uint32_t count) const {
+    if (listener_) listener_->on_level(*this, LevelUpdate{locate_, s, p, qty, count});
+  }
+  void notify_trade(const TradeUpdate& t) const {
+    if (listener_) listener_->on_trade(*this, t);
+  }
+  // Level::push_back() and Level::unlink() with state_hash_ kept in step: unlinking
+  // also re-terms the order that moves up behind o's predecessor.
+  void link_order(Level& lvl, Order* o);
+  void unlink_order(Order* o);
+  // Pool and index bytes; the index is charged one node per order in `orders`.
+  MemoryFootprint order_footprint(std::size_t orders) const;
+
+  StockLocate locate_{0};
+  std::string symbol_;
+  std::pmr::memory_resource* mr_;
+
+  // Orders by id (L3)
+  std::pmr::unordered_map<OrderId, Order*> orders_;
+
+  // Order memory
+  OrderPool pool_;
+
+  BookListener* listener_{nullptr};
+
+  std::size_t peak_orders_{0};
+  std::size_t peak_levels_{0};
+  MemoryFootprint carried_peak_{}; // peak_footprint() of the books this one replaced
+  std::uint64_t state_hash_{0};
+};
+
+// Event logic over a compile-time level-storage policy (see level_store.hpp).
+// Instantiated in symbol_book.cc for MapLevelPolicy and FlatLevelPolicy.
+template <typename LevelPolicy>
+class BasicSymbolBook final : public SymbolBook {
+public:
+  explicit BasicSymbolBook(StockLocate loc = 0, std::string sym = {},
+                           std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+    : SymbolBook(loc, std::move(sym), mr), bids_(mr), asks_(mr) {}
+
+  Status on_add(const AddEvent& e) override;
+  Status on_cancel(const CancelEvent& e) override;
+  Status on_delete(const DeleteEvent& e) override;
+  Status on_execute(const ExecuteEvent& e) override;
+  Status on_replace(const ReplaceEvent& e) override;
+
+  TopOfBook top() const override;
+  using SymbolBook::depth;
+  std::size_t depth(Side s, LevelView* out, std::size_t n) const override;
+  std::size_t level_count(Side s) const override {
+    return (s == Side::Buy) ? bids_.size() : asks_.size();
+  }
+  void for_each_level(Side s, const std::function<bool(const Level&)>& fn) const override;
+  void for_each_level_after(Side s, Price p, const std::function<bool(const Level&)>& fn) const override;
+  const Level* find_level(Side s, Price p) const override {
+    return (s == Side::Buy) ? bids_.find(p) : asks_.find(p);
+  }
+
+  bool validate() const override;
+  void reset() override;
+  void reserve(std::size_t orders, std::size_t levels) override;
+  MemoryFootprint footprint() const override;
+  MemoryFootprint peak_footprint() const override;
+  LevelBackend backend() const override;
 
 private:
-  using BidMap = std::map<Price, Level, DescBid>;
-  using AskMap = std::map<Price, Level, AscAsk>;
+  using Bids = typename LevelPolicy::template side_type<DescBid>;
+  using Asks = typename LevelPolicy::template side_type<AscAsk>;
 
   // Helpers
   Level& get_or_create_level(Side s, Price p);
-  void maybe_erase_level(Side s, Price p);
+  void erase_level(Side s, Level& lvl);
 
   Status remove_order_fully(Order* o);
   Status reduce_order_qty(Order* o, Qty delta); // cancels/execs
 
-  StockLocate locate_{0};
-  std::string symbol_;
-
-  // Orders by id (L3)
-  std::unordered_map<OrderId, Order*> orders_;
-
   // Price levels (L2 aggregates + FIFO lists)
-  BidMap bids_;
-  AskMap asks_;
-
-  // Order memory
-  OrderPool pool_;
+  Bids bids_;
+  Asks asks_;
 };
 
+using MapSymbolBook = BasicSymbolBook<MapLevelPolicy>;
+using FlatSymbolBook = BasicSymbolBook<FlatLevelPolicy>;
+
+extern template class BasicSymbolBook<MapLevelPolicy>;
+extern template class BasicSymbolBook<FlatLevelPolicy>;
+
 } // namespace ob
@@ -0,0 +1,52 @@
+#pragma once
+#include "symbol_book.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ob {
+
+// Structure-of-arrays top of book for the whole universe, indexed by locate.
+// OrderBook keeps it current on every applied event. A price of 0 means that side
+// is empty (or the locate is not registered).
+//
+// Scans walk the contiguous price columns four locates at a time with SSE2 when
+// available and fall back to scalar loops otherwise.
+class TopTable {
+public:
+  std::size_t size() const { return bid_price_.size(); }
+
+  void ensure(StockLocate locate);
+  void update(StockLocate locate, const TopOfBook& t) {
+    bid_price_[locate] = t.has_bid ? t.bid.price : 0;
+    ask_price_[locate] = t.has_ask ? t.ask.price : 0;
+    bid_qty_[locate] = t.has_bid ? t.bid.qty : 0;
+    ask_qty_[locate] = t.has_ask ? t.ask.qty : 0;
+  }
+
+  // Columns, size() entries each.
+  const Price* bid_price() const { return bid_price_.data(); }
+  const Price* ask_price() const { return ask_price_.data(); }
+  const std::uint64_t* bid_qty() const { return bid_qty_.data(); }
+  const std::uint64_t* ask_qty() const { return ask_qty_.data(); }
+
+  // Two-sided books with ask - bid > min_spread. Replaces *out, returns its size.
+  std::size_t scan_spread_over(Price min_spread, std::vector<StockLocate>* out) const;
+  // Two-sided books with bid >= ask.
+  std::size_t scan_crossed_or_locked(std::vector<StockLocate>* out) const;
+
+  // Snapshots every two-sided mid as the reference for top_movers().
+  void mark_reference();
+  // Up to k locates with the largest |mid / reference - 1|, largest first.
+  std::size_t top_movers(std::size_t k, std::vector<StockLocate>* out) const;
+
+private:
+  std::vector<Price> bid_price_;
+  std::vector<Price> ask_price_;
+  std::vector<std::uint64_t> bid_qty_;
+  std::vector<std::uint64_t> ask_qty_;
+  std::vector<double> ref_mid_; // 0 = no reference
+  mutable std::vector<double> move_scratch_;
+};
+
+} // namespace ob
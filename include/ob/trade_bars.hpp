@@ -0,0 +1,103 @@
+#pragma once
+#include "listener.hpp"
+#include "symbol_book.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace ob {
+
+// OHLCV of one symbol over one time bucket [start_ns, start_ns + period).
+struct TradeBar {
+  StockLocate locate{};
+  std::uint32_t period{};        // index into TradeBarsConfig::periods_ns
+  std::uint64_t start_ns{};      // nanoseconds since midnight, a multiple of the period
+  Price open{};
+  Price high{};
+  Price low{};
+  Price close{};
+  std::uint64_t volume{};
+  std::uint64_t hidden_volume{}; // part of volume printed by hidden trades ('P')
+  double notional{};             // sum of price * qty
+  std::uint32_t trades{};
+
+  double vwap() const { return volume ? notional / static_cast<double>(volume) : 0.0; }
+};
+
+struct TradeBarsConfig {
+  std::vector<std::uint64_t> periods_ns{1'000'000'000, 60'000'000'000}; // each > 0
+  std::size_t batch{256}; // closed bars per sink call
+};
+
+struct TradeBarsStats {
+  std::uint64_t trades{};        // prints folded into bars
+  std::uint64_t volume{};
+  std::uint64_t non_printable{}; // executions flagged non-printable, not counted
+  std::uint64_t bars{};          // bars closed
+  std::uint64_t batches{};       // sink calls
+};
+
+// Per-symbol trade bars at several bucket sizes at once, built from the book's
+// on_trade() prints: executions at the resting order's price and hidden trades.
+//
+// Every period keeps one open bar per traded symbol plus the list of symbols with an
+// open bar. advance() closes a period's open bars when the clock crosses its bucket
+// boundary, so quiet symbols close on time without a trade of their own. Closed bars
+// collect in a preallocated batch handed to the sink when full and on flush(); the
+// only allocations are growth for a new locate or more concurrently open bars.
+//
+// Install with OrderBook::set_listener(); set_next() chains the listener it displaces.
+class TradeBars final : public BookListener {
+public:
+  using Sink = std::function<void(std::span<const TradeBar>)>;
+
+  explicit TradeBars(const TradeBarsConfig& cfg = {}, Sink sink = {});
+
+  void set_next(BookListener* next) { next_ = next; }
+  void set_sink(Sink sink) { sink_ = std::move(sink); }
+  const TradeBarsConfig& config() const { return cfg_; }
+  const TradeBarsStats& stats() const { return stats_; }
+
+  // Sets the clock for the prints that follow; call with each message timestamp before
+  // its event is applied. Closes every bar whose bucket ended at or before ts.
+  void advance(std::uint64_t ts);
+  // Hands buffered closed bars to the sink.
+  void flush();
+  // End of session: closes every open bar and flushes.
+  void finish();
+
+  // The open bar of locate for period index p, or nullptr if nothing traded in the
+  // current bucket.
+  const TradeBar* current(StockLocate locate, std::size_t p) const;
+
+  void on_level(const SymbolBook& book, const LevelUpdate& u) override {
+    if (next_) next_->on_level(book, u);
+  }
+  void on_reset(const SymbolBook& book) override {
+    if (next_) next_->on_reset(book);
+  }
+  void on_trade(const SymbolBook& book, const TradeUpdate& t) override;
+
+private:
+  struct Period {
+    std::uint64_t ns{};
+    std::uint64_t end{};            // end of the current bucket; 0 before the first advance()
+    std::vector<StockLocate> open;  // locates with a bar open in this period
+  };
+
+  void close_period(Period& p, std::size_t index);
+  void emit(const TradeBar& bar);
+
+  TradeBarsConfig cfg_;
+  Sink sink_;
+  BookListener* next_{nullptr};
+  std::vector<Period> periods_;
+  std::vector<TradeBar> bars_;  // [locate * periods + p], grown on demand; trades == 0: closed
+  std::vector<TradeBar> batch_; // closed, not yet delivered
+  std::uint64_t now_{0};
+  TradeBarsStats stats_;
+};
+
+} // namespace ob
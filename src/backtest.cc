@@ -0,0 +1,184 @@
+#include "ob/backtest.hpp"
+#include <algorithm>
+
+namespace ob {
+
+namespace {
+
+// True if price a ranks ahead of b on side s.
+bool better(Side s, Price a, Price b) {
+  return s == Side::Buy ? a > b : a < b;
+}
+
+} // namespace
+
+Backtester::Backtester(OrderBook& book, Strategy& strategy, const BacktestConfig& cfg)
+  : book_(book), strategy_(strategy), cfg_(cfg), subscribed_(std::size_t{1} << 16),
+    working_(std::size_t{1} << 16) {}
+
+void Backtester::subscribe(StockLocate locate) {
+  subscribed_[locate] = true;
+}
+
+void Backtester::advance(std::uint64_t ts) {
+  now_ = ts;
+  while (!pending_.empty() && pending_.front().due <= ts) {
+    const Pending p = pending_.front();
+    pending_.pop_front();
+    ShadowOrder& o = orders_[p.id - 1];
+    if (!p.cancel) {
+      activate(o);
+    } else if (!o.done) {
+      o.done = true;
+      o.working = false;
+      ++stats_.cancelled;
+      drop_done(o.locate);
+      strategy_.on_cancelled(*this, o);
+    }
+  }
+}
+
+ShadowId Backtester::submit(StockLocate locate, Side side, Price price, Qty qty) {
+  if (qty == 0 || !book_.find(locate)) return 0;
+  const ShadowId id = orders_.size() + 1;
+  orders_.push_back(ShadowOrder{.id=id, .locate=locate, .side=side, .price=price, .qty=qty, .submit_ns=now_});
+  pending_.push_back(Pending{now_ + cfg_.latency_ns, id, false});
+  ++stats_.submitted;
+  return id;
+}
+
+bool Backtester::cancel(ShadowId id) {
+  if (id == 0 || id > orders_.size() || orders_[id - 1].done) return false;
+  pending_.push_back(Pending{now_ + cfg_.latency_ns, id, true});
+  return true;
+}
+
+const ShadowOrder* Backtester::find(ShadowId id) const {
+  return (id == 0 || id > orders_.size()) ? nullptr : &orders_[id - 1];
+}
+
+void Backtester::activate(ShadowOrder& o) {
+  const SymbolBook* b = book_.find(o.locate);
+  ++stats_.activated;
+  o.working = true;
+  working_[o.locate].push_back(o.id);
+  // Marketable on arrival: take the displayed opposite levels it crosses.
+  const Side opp = o.side == Side::Buy ? Side::Sell : Side::Buy;
+  b->for_each_level(opp, [&](const Level& l) {
+    if (better(opp, o.price, l.price)) return false;
+    fill(o, l.price, static_cast<Qty>(std::min<std::uint64_t>(o.leaves(), l.total_qty)));
+    return !o.done;
+  });
+  if (o.done) {
+    drop_done(o.locate);
+    return;
+  }
+  const Level* l = b->find_level(o.side, o.price);
+  o.ahead = l ? l->total_qty : 0;
+  o.anchor = last_order_id_;
+}
+
+void Backtester::fill(ShadowOrder& o, Price price, Qty qty) {
+  qty = std::min(qty, o.leaves());
+  if (qty == 0) return;
+  o.filled += qty;
+  ++stats_.fills;
+  stats_.filled_qty += qty;
+  if (o.leaves() == 0) {
+    o.done = true;
+    o.working = false;
+  }
+  strategy_.on_fill(*this, ShadowFill{o.id, o.locate, o.side, price, qty, o.leaves(), now_});
+}
+
+void Backtester::drop_done(StockLocate locate) {
+  std::vector<ShadowId>& w = working_[locate];
+  w.erase(std::remove_if(w.begin(), w.end(), [&](ShadowId id) { return orders_[id - 1].done; }), w.end());
+}
+
+void Backtester::on_removed(StockLocate locate, const Order& o, Qty removed) {
+  for (ShadowId id : working_[locate]) {
+    ShadowOrder& s = orders_[id - 1];
+    if (s.side == o.side && s.price == o.price && o.order_id <= s.anchor) s.ahead -= std::min<std::uint64_t>(s.ahead, removed);
+  }
+}
+
+Status Backtester::apply(const AddEvent& e) {
+  last_order_id_ = std::max(last_order_id_, e.order_id);
+  return book_.apply(e);
+}
+
+Status Backtester::apply(const CancelEvent& e) {
+  if (!working_[e.locate].empty()) {
+    const SymbolBook* b = book_.find(e.locate);
+    if (const Order* o = b ? b->find_order(e.order_id) : nullptr) on_removed(e.locate, *o, std::min(e.cancel_qty, o->qty));
+  }
+  return book_.apply(e);
+}
+
+Status Backtester::apply(const DeleteEvent& e) {
+  if (!working_[e.locate].empty()) {
+    const SymbolBook* b = book_.find(e.locate);
+    if (const Order* o = b ? b->find_order(e.order_id) : nullptr) on_removed(e.locate, *o, o->qty);
+  }
+  return book_.apply(e);
+}
+
+Status Backtester::apply(const ReplaceEvent& e) {
+  // The new order queues behind every shadow order; only the old one's removal counts.
+  last_order_id_ = std::max(last_order_id_, e.new_order_id);
+  if (!working_[e.locate].empty()) {
+    const SymbolBook* b = book_.find(e.locate);
+    if (const Order* o = b ? b->find_order(e.old_order_id) : nullptr) on_removed(e.locate, *o, o->qty);
+  }
+  return book_.apply(e);
+}
+
+Status Backtester::apply(const ExecuteEvent& e) {
+  if (!working_[e.locate].empty()) {
+    const SymbolBook* b = book_.find(e.locate);
+    if (const Order* o = b ? b->find_order(e.order_id) : nullptr) {
+      // Flow behind a shadow order, or through its price, is shared out in submit order.
+      std::uint64_t flow = std::min(e.exec_qty, o->qty);
+      for (ShadowId id : working_[e.locate]) {
+        ShadowOrder& s = orders_[id - 1];
+        if (s.side != o->side) continue;
+        if (s.price == o->price && o->order_id <= s.anchor) {
+          s.ahead -= std::min<std::uint64_t>(s.ahead, e.exec_qty);
+        } else if (s.price == o->price || better(s.side, s.price, o->price)) {
+          const Qty q = static_cast<Qty>(std::min<std::uint64_t>(flow, s.leaves()));
+          flow -= q;
+          fill(s, s.price, q);
+        }
+      }
+      drop_done(e.locate);
+    }
+  }
+  return book_.apply(e);
+}
+
+void Backtester::on_level(const SymbolBook& book, const LevelUpdate& u) {
+  if (next_) next_->on_level(book, u);
+  if (subscribed(u.locate)) strategy_.on_book(*this, book, u);
+}
+
+void Backtester::on_reset(const SymbolBook& book) {
+  // The queue positions are gone with the book.
+  for (ShadowId id : working_[book.locate()]) {
+    ShadowOrder& o = orders_[id - 1];
+    o.done = true;
+    o.working = false;
+    ++stats_.cancelled;
+  }
+  std::vector<ShadowId> dropped;
+  dropped.swap(working_[book.locate()]);
+  if (next_) next_->on_reset(book);
+  for (ShadowId id : dropped) strategy_.on_cancelled(*this, orders_[id - 1]);
+}
+
+void Backtester::on_trade(const SymbolBook& book, const TradeUpdate& t) {
+  if (next_) next_->on_trade(book, t);
+  if (subscribed(t.locate)) strategy_.on_trade(*this, book, t);
+}
+
+} // namespace ob
@@ -0,0 +1,46 @@
+#include "ob/capacity.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace ob {
+
+bool CapacityProfile::load(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    auto hash = line.find('#');
+    if (hash != std::string::npos) line.erase(hash);
+    std::istringstream fields(line);
+    std::string symbol;
+    SymbolCapacity c;
+    if (!(fields >> symbol)) continue; // blank
+    if (!(fields >> c.orders >> c.levels)) return false;
+    by_symbol_[symbol] = c;
+  }
+  return true;
+}
+
+bool CapacityProfile::save(const std::string& path) const {
+  std::ofstream out(path);
+  if (!out) return false;
+  std::vector<std::string_view> symbols;
+  symbols.reserve(by_symbol_.size());
+  for (const auto& [sym, c] : by_symbol_) symbols.push_back(sym);
+  std::sort(symbols.begin(), symbols.end());
+  out << "# symbol peak_orders peak_levels\n";
+  for (std::string_view sym : symbols) {
+    const SymbolCapacity& c = *find(sym);
+    out << sym << ' ' << c.orders << ' ' << c.levels << '\n';
+  }
+  return static_cast<bool>(out);
+}
+
+const SymbolCapacity* CapacityProfile::find(std::string_view symbol) const {
+  auto it = by_symbol_.find(std::string(symbol));
+  return (it == by_symbol_.end()) ? nullptr : &it->second;
+}
+
+} // namespace ob
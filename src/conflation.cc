@@ -0,0 +1,69 @@
+#include "ob/conflation.hpp"
+#include <algorithm>
+
+namespace ob {
+
+bool ConflatingPublisher::same_top(const TopOfBook& a, const TopOfBook& b) {
+  auto same = [](bool ha, const LevelView& la, bool hb, const LevelView& lb) {
+    if (ha != hb) return false;
+    return !ha || (la.price == lb.price && la.qty == lb.qty && la.count == lb.count);
+  };
+  return same(a.has_bid, a.bid, b.has_bid, b.bid) && same(a.has_ask, a.ask, b.has_ask, b.ask);
+}
+
+std::size_t ConflatingPublisher::add_consumer(std::uint64_t min_interval_ns, Sink sink) {
+  Consumer c;
+  c.interval_ns = min_interval_ns;
+  c.sink = std::move(sink);
+  c.merged.assign(kLocates, 0);
+  consumers_.push_back(std::move(c));
+  return consumers_.size() - 1;
+}
+
+void ConflatingPublisher::observe(StockLocate locate, const TopOfBook& top) {
+  TopOfBook& last = last_top_[locate];
+  if (same_top(top, last)) return; // deeper level changed, BBO did not
+  last = top;
+
+  for (Consumer& c : consumers_) {
+    ++c.stats.changes;
+    if (c.merged[locate]++ == 0) c.dirty.push_back(locate);
+  }
+}
+
+void ConflatingPublisher::on_level(const SymbolBook& book, const LevelUpdate& u) {
+  observe(u.locate, book.top());
+}
+
+void ConflatingPublisher::on_reset(const SymbolBook& book) {
+  observe(book.locate(), TopOfBook{});
+}
+
+void ConflatingPublisher::poll(std::uint64_t now_ns) {
+  for (std::size_t i = 0; i < consumers_.size(); ++i) {
+    const Consumer& c = consumers_[i];
+    if (c.dirty.empty()) continue;
+    if (c.stats.flushes > 0 && now_ns - c.last_flush_ns < c.interval_ns) continue;
+    flush(i, now_ns);
+  }
+}
+
+void ConflatingPublisher::flush(std::size_t consumer, std::uint64_t now_ns) {
+  Consumer& c = consumers_[consumer];
+  c.last_flush_ns = now_ns;
+  if (c.dirty.empty()) return;
+
+  c.batch.clear();
+  for (StockLocate loc : c.dirty) {
+    c.batch.push_back(ConflatedUpdate{loc, last_top_[loc], c.merged[loc]});
+    c.merged[loc] = 0;
+  }
+  c.dirty.clear();
+
+  ++c.stats.flushes;
+  c.stats.delivered += c.batch.size();
+  c.stats.max_batch = std::max<std::uint64_t>(c.stats.max_batch, c.batch.size());
+  if (c.sink) c.sink(std::span<const ConflatedUpdate>(c.batch));
+}
+
+} // namespace ob
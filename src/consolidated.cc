@@ -0,0 +1,137 @@
+#include "ob/consolidated.hpp"
+#include <algorithm>
+
+namespace ob {
+
+ConsolidatedBook::ConsolidatedBook(std::size_t venues)
+  : venues_(std::clamp<std::size_t>(venues, 1, kMaxVenues)) {
+  for (std::size_t v = 0; v < venues_.size(); ++v) {
+    venues_[v].listener.owner = this;
+    venues_[v].listener.venue = static_cast<std::uint32_t>(v);
+    venues_[v].by_locate.assign(std::size_t{1} << 16, kUnmapped);
+  }
+}
+
+bool ConsolidatedBook::find(std::string_view symbol, ConsolidatedId* id) const {
+  auto it = by_name_.find(std::string(symbol));
+  if (it == by_name_.end()) return false;
+  *id = it->second;
+  return true;
+}
+
+bool ConsolidatedBook::resolve(std::uint32_t venue, const SymbolBook& book, ConsolidatedId* id) {
+  ConsolidatedId& slot = venues_[venue].by_locate[book.locate()];
+  if (slot == kUnmapped) {
+    if (book.symbol().empty()) return false;
+    auto [it, inserted] = by_name_.try_emplace(std::string(book.symbol()), static_cast<ConsolidatedId>(symbols_.size()));
+    if (inserted) {
+      symbols_.emplace_back();
+      symbols_.back().name = it->first;
+    }
+    slot = it->second;
+  }
+  *id = slot;
+  return true;
+}
+
+template <typename Map>
+void ConsolidatedBook::set_venue_level(Map& side, Price price, std::uint32_t venue, std::uint64_t qty,
+                                       std::uint32_t count) {
+  auto it = side.find(price);
+  if (it == side.end()) {
+    if (qty == 0) return;
+    it = side.try_emplace(price).first;
+  }
+  Level& l = it->second;
+  l.qty = l.qty - l.venue_qty[venue] + qty;
+  l.count = l.count - l.venue_count[venue] + count;
+  l.venue_qty[venue] = qty;
+  l.venue_count[venue] = count;
+  if (qty > 0) {
+    l.venues |= 1u << venue;
+  } else {
+    l.venues &= ~(1u << venue);
+  }
+  if (l.venues == 0) side.erase(it);
+}
+
+template <typename Map>
+void ConsolidatedBook::drop_venue(Map& side, std::uint32_t venue) {
+  for (auto it = side.begin(); it != side.end();) {
+    Level& l = it->second;
+    if (l.venues & (1u << venue)) {
+      l.qty -= l.venue_qty[venue];
+      l.count -= l.venue_count[venue];
+      l.venue_qty[venue] = 0;
+      l.venue_count[venue] = 0;
+      l.venues &= ~(1u << venue);
+    }
+    it = l.venues == 0 ? side.erase(it) : std::next(it);
+  }
+}
+
+void ConsolidatedBook::refresh_nbbo(ConsolidatedId id) {
+  Symbol& s = symbols_[id];
+  Nbbo n;
+  if (!s.bids.empty()) {
+    const auto& [px, l] = *s.bids.begin();
+    n.has_bid = true;
+    n.bid = px;
+    n.bid_qty = l.qty;
+    n.bid_venues = l.venues;
+  }
+  if (!s.asks.empty()) {
+    const auto& [px, l] = *s.asks.begin();
+    n.has_ask = true;
+    n.ask = px;
+    n.ask_qty = l.qty;
+    n.ask_venues = l.venues;
+  }
+  if (n == s.nbbo) return;
+  s.nbbo = n;
+  ++stats_.nbbo_changes;
+  if (on_nbbo_) on_nbbo_(id, n);
+}
+
+void ConsolidatedBook::on_level(std::uint32_t venue, const SymbolBook& book, const LevelUpdate& u) {
+  ConsolidatedId id;
+  if (!resolve(venue, book, &id)) {
+    ++stats_.unmapped;
+    return;
+  }
+  ++stats_.updates;
+  Symbol& s = symbols_[id];
+  if (u.side == Side::Buy) {
+    set_venue_level(s.bids, u.price, venue, u.qty, u.count);
+  } else {
+    set_venue_level(s.asks, u.price, venue, u.qty, u.count);
+  }
+  refresh_nbbo(id);
+}
+
+void ConsolidatedBook::on_reset(std::uint32_t venue, const SymbolBook& book) {
+  ConsolidatedId id;
+  if (!resolve(venue, book, &id)) return;
+  drop_venue(symbols_[id].bids, venue);
+  drop_venue(symbols_[id].asks, venue);
+  refresh_nbbo(id);
+}
+
+std::size_t ConsolidatedBook::depth(ConsolidatedId id, Side s, ConsolidatedLevel* out, std::size_t n) const {
+  auto fill = [&](const auto& side) {
+    std::size_t i = 0;
+    for (auto it = side.begin(); it != side.end() && i < n; ++it, ++i) {
+      out[i] = ConsolidatedLevel{it->first, it->second.qty, it->second.count, it->second.venues};
+    }
+    return i;
+  };
+  const Symbol& sym = symbols_[id];
+  return s == Side::Buy ? fill(sym.bids) : fill(sym.asks);
+}
+
+std::size_t ConsolidatedBook::level_count(ConsolidatedId id, Side s) const {
+  const Symbol& sym = symbols_[id];
+  return s == Side::Buy ? sym.bids.size() : sym.asks.size();
+}
+
+} // namespace ob
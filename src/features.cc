@@ -0,0 +1,178 @@
+#include "ob/features.hpp"
+#include <algorithm>
+
+namespace ob {
+
+namespace {
+
+constexpr std::size_t side_index(Side s) {
+  return s == Side::Buy ? 0 : 1;
+}
+
+// Rank key of a price on side s; keys order best first on both sides.
+Price key(Side s, Price p) {
+  return s == Side::Buy ? ~p : p;
+}
+
+double imbalance(std::uint64_t bid, std::uint64_t ask) {
+  const std::uint64_t total = bid + ask;
+  return total ? (static_cast<double>(bid) - static_cast<double>(ask)) / static_cast<double>(total) : 0.0;
+}
+
+} // namespace
+
+FeatureEngine::FeatureEngine(const FeatureConfig& cfg)
+  : depth_(std::clamp<std::uint32_t>(cfg.depth, 1, kMaxDepth)), slots_(std::size_t{1} << 16, kNoSlot) {}
+
+std::uint32_t FeatureEngine::slot(StockLocate locate) {
+  std::uint32_t& s = slots_[locate];
+  if (s == kNoSlot) {
+    s = static_cast<std::uint32_t>(tops_.size());
+    tops_.emplace_back();
+    flows_.emplace_back();
+    flows_.back().locate = locate;
+  }
+  return s;
+}
+
+void FeatureEngine::refill(const SymbolBook& book, Side s, SideTop& t) const {
+  LevelView levels[kMaxDepth];
+  t.n = static_cast<std::uint32_t>(book.depth(s, levels, depth_));
+  t.sum = 0;
+  for (std::uint32_t i = 0; i < t.n; ++i) {
+    t.key[i] = key(s, levels[i].price);
+    t.qty[i] = levels[i].qty;
+    t.sum += levels[i].qty;
+  }
+}
+
+void FeatureEngine::on_level(const SymbolBook& book, const LevelUpdate& u) {
+  const std::uint32_t id = slot(u.locate);
+  const std::size_t si = side_index(u.side);
+  Top& top = tops_[id];
+  SideTop& t = top.side[si];
+  top.last_cut_side = -1;
+
+  const Price k = key(u.side, u.price);
+  std::uint32_t i = 0;
+  while (i < t.n && t.key[i] < k) ++i;
+  const bool tracked = i < t.n && t.key[i] == k;
+  if (tracked || i < depth_) {
+    Flow& f = flows_[id];
+    const bool had_best = t.n > 0;
+    const Price old_key = t.key[0];
+    const std::uint64_t old_qty = had_best ? t.qty[0] : 0;
+
+    const std::uint64_t prev = tracked ? t.qty[i] : 0;
+    if (u.qty > prev) {
+      ++f.adds[si][i];
+    } else if (u.qty < prev) {
+      ++f.cancels[si][i];
+      top.last_cut_side = static_cast<std::int8_t>(si);
+      top.last_cut_rank = static_cast<std::uint8_t>(i);
+    }
+
+    if (tracked && u.qty == 0) {
+      if (t.n == depth_) {
+        refill(book, u.side, t); // the level below the window moves up
+      } else {
+        std::copy(t.key.begin() + i + 1, t.key.begin() + t.n, t.key.begin() + i);
+        std::copy(t.qty.begin() + i + 1, t.qty.begin() + t.n, t.qty.begin() + i);
+        --t.n;
+        t.sum -= prev;
+      }
+    } else if (tracked) {
+      t.qty[i] = u.qty;
+      t.sum = t.sum - prev + u.qty;
+    } else if (u.qty > 0) {
+      const std::uint32_t last = std::min(t.n, depth_ - 1); // full window drops its worst level
+      if (t.n == depth_) t.sum -= t.qty[last];
+      std::copy_backward(t.key.begin() + i, t.key.begin() + last, t.key.begin() + last + 1);
+      std::copy_backward(t.qty.begin() + i, t.qty.begin() + last, t.qty.begin() + last + 1);
+      t.key[i] = k;
+      t.qty[i] = u.qty;
+      t.sum += u.qty;
+      t.n = last + 1;
+    }
+
+    // OFI term of this side's best level: size joining at or ahead of the old best
+    // counts for the side, size leaving at or ahead of the new best counts against it.
+    if (i == 0) {
+      const bool has_best = t.n > 0;
+      const Price new_key = t.key[0];
+      const std::uint64_t new_qty = has_best ? t.qty[0] : 0;
+      std::int64_t e = 0;
+      if (!had_best || (has_best && new_key <= old_key)) e += static_cast<std::int64_t>(new_qty);
+      if (!has_best || (had_best && new_key >= old_key)) e -= static_cast<std::int64_t>(old_qty);
+      f.ofi += u.side == Side::Buy ? e : -e;
+    }
+  }
+
+  if (next_) next_->on_level(book, u);
+}
+
+void FeatureEngine::on_reset(const SymbolBook& book) {
+  const std::uint32_t id = slots_[book.locate()];
+  if (id != kNoSlot) tops_[id] = Top{};
+  if (next_) next_->on_reset(book);
+}
+
+void FeatureEngine::on_trade(const SymbolBook& book, const TradeUpdate& t) {
+  // An execution's level change arrives just before its trade: move it from cancels.
+  const std::uint32_t id = slots_[t.locate];
+  if (!t.hidden && id != kNoSlot) {
+    Top& top = tops_[id];
+    if (top.last_cut_side == static_cast<std::int8_t>(side_index(t.side))) {
+      Flow& f = flows_[id];
+      --f.cancels[top.last_cut_side][top.last_cut_rank];
+      ++f.executions[top.last_cut_side][top.last_cut_rank];
+    }
+    top.last_cut_side = -1;
+  }
+  if (next_) next_->on_trade(book, t);
+}
+
+void FeatureEngine::fill_row(std::uint32_t id, FeatureRow* out) const {
+  const Top& top = tops_[id];
+  const Flow& f = flows_[id];
+  const SideTop& b = top.side[0];
+  const SideTop& a = top.side[1];
+  FeatureRow& r = *out;
+  r.locate = f.locate;
+  r.depth = depth_;
+  r.has_bid = b.n > 0;
+  r.has_ask = a.n > 0;
+  r.bid = r.has_bid ? key(Side::Buy, b.key[0]) : 0;
+  r.ask = r.has_ask ? key(Side::Sell, a.key[0]) : 0;
+  r.bid_qty = r.has_bid ? b.qty[0] : 0;
+  r.ask_qty = r.has_ask ? a.qty[0] : 0;
+  r.bid_depth_qty = b.sum;
+  r.ask_depth_qty = a.sum;
+  if (r.has_bid && r.has_ask) {
+    r.microprice = (static_cast<double>(r.bid) * static_cast<double>(r.ask_qty) +
+                    static_cast<double>(r.ask) * static_cast<double>(r.bid_qty)) /
+                   static_cast<double>(r.bid_qty + r.ask_qty);
+  } else {
+    r.microprice = r.has_bid ? r.bid : r.has_ask ? r.ask : 0.0;
+  }
+  r.queue_imbalance = imbalance(r.bid_qty, r.ask_qty);
+  r.depth_imbalance = imbalance(b.sum, a.sum);
+  r.ofi = f.ofi;
+  r.adds = f.adds;
+  r.cancels = f.cancels;
+  r.executions = f.executions;
+}
+
+void FeatureEngine::export_rows(std::vector<FeatureRow>* out) const {
+  out->resize(tops_.size());
+  for (std::uint32_t id = 0; id < tops_.size(); ++id) fill_row(id, &(*out)[id]);
+}
+
+bool FeatureEngine::row(StockLocate locate, FeatureRow* out) const {
+  const std::uint32_t id = slots_[locate];
+  if (id == kNoSlot) return false;
+  fill_row(id, out);
+  return true;
+}
+
+} // namespace ob
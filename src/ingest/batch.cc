@@ -0,0 +1,257 @@
+#include "ob/ingest/batch.hpp"
+#include "ob/ingest/framing.hpp"
+#include "ob/ingest/itch.hpp"
+#include "ob/order_book.hpp"
+
+#include <glob.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace ob::ingest {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point t0) {
+  return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// Blocking byte budget shared by all workers.
+class MemoryBudget {
+public:
+  explicit MemoryBudget(std::uint64_t limit) : limit_(limit) {}
+
+  void acquire(std::uint64_t bytes) {
+    std::unique_lock<std::mutex> lk(mu_);
+    cv_.wait(lk, [&] { return limit_ == 0 || used_ == 0 || used_ + bytes <= limit_; });
+    used_ += bytes;
+    peak_ = std::max(peak_, used_);
+  }
+
+  void release(std::uint64_t bytes) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      used_ -= bytes;
+    }
+    cv_.notify_all();
+  }
+
+  std::uint64_t peak() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return peak_;
+  }
+
+private:
+  const std::uint64_t limit_;
+  mutable std::mutex mu_;
+  std::condition_variable cv_;
+  std::uint64_t used_{0};
+  std::uint64_t peak_{0};
+};
+
+// Fixed task set over per-worker deques. A worker takes from the front of its own
+// deque (largest file first) and, once empty, steals from the back of another's.
+class WorkStealingPool {
+public:
+  using Task = std::function<void(unsigned worker)>;
+
+  explicit WorkStealingPool(unsigned threads) : queues_(threads) {}
+
+  void push(unsigned worker, Task t) { queues_[worker].tasks.push_back(std::move(t)); }
+
+  void run() {
+    std::vector<std::thread> threads;
+    for (unsigned w = 0; w < queues_.size(); ++w) {
+      threads.emplace_back([this, w] { worker_loop(w); });
+    }
+    for (auto& t : threads) t.join();
+  }
+
+private:
+  struct Queue {
+    std::mutex mu;
+    std::deque<Task> tasks;
+  };
+
+  bool take(unsigned w, Task* out) {
+    {
+      Queue& own = queues_[w];
+      std::lock_guard<std::mutex> lk(own.mu);
+      if (!own.tasks.empty()) {
+        *out = std::move(own.tasks.front());
+        own.tasks.pop_front();
+        return true;
+      }
+    }
+    for (std::size_t i = 1; i < queues_.size(); ++i) {
+      Queue& victim = queues_[(w + i) % queues_.size()];
+      std::lock_guard<std::mutex> lk(victim.mu);
+      if (!victim.tasks.empty()) {
+        *out = std::move(victim.tasks.back());
+        victim.tasks.pop_back();
+        return true;
+      }
+    }
+    return false; // no task is ever added after run(), so every queue is drained
+  }
+
+  void worker_loop(unsigned w) {
+    Task t;
+    while (take(w, &t)) t(w);
+  }
+
+  std::vector<Queue> queues_;
+};
+
+void replay_one(const std::string& path, const BatchConfig& cfg, FileResult* r) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    r->error = "cannot open";
+    return;
+  }
+  std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  const ItchFraming framing =
+      cfg.framing == ItchFraming::Auto ? detect_itch_framing(data.data(), data.size()) : cfg.framing;
+  ItchIndex index;
+  if (framing != ItchFraming::Raw && !unframe_itch(&data, framing, &index)) {
+    r->error = std::string(to_string(framing)) + " framing stops at offset " + std::to_string(index.end);
+    return;
+  }
+
+  CountingResource counter;
+  OrderBook book;
+  book.set_memory(cfg.memory, &counter);
+  std::size_t offset = 0;
+  ItchMessageView msg;
+  ItchRun run;
+  ItchDecoder decoder(cfg.filter);
+  for (;;) {
+    if (std::size_t n = decoder.next_run(data.data(), data.size(), &offset, &run)) {
+      r->messages += n;
+      r->events += n;
+      visit_itch_run(run, [&](std::uint64_t, const auto& e) { book.apply(e); });
+      continue;
+    }
+    if (!decoder.next(data.data(), data.size(), &offset, &msg)) break;
+    ++r->messages;
+    if (visit_itch_book_event(msg, [&](const auto& e) { book.apply(e); })) ++r->events;
+  }
+  r->skipped = decoder.stats().skipped_type + decoder.stats().skipped_locate;
+  r->symbols = book.locates().size();
+  r->book_bytes = counter.peak_bytes();
+  if (offset != data.size()) {
+    r->error = "stopped at offset " + std::to_string(offset);
+    return;
+  }
+  r->ok = true;
+}
+
+} // namespace
+
+BatchSummary replay_files(const std::vector<std::string>& files, const BatchConfig& cfg,
+                          const std::function<void(const FileResult&)>& on_result) {
+  BatchSummary sum;
+  sum.files = files.size();
+  unsigned threads = cfg.threads ? cfg.threads : std::max(1u, std::thread::hardware_concurrency());
+  threads = static_cast<unsigned>(std::min<std::size_t>(threads, std::max<std::size_t>(files.size(), 1)));
+  sum.threads = threads;
+
+  struct Job {
+    std::string path;
+    std::uint64_t bytes;
+  };
+  std::vector<Job> jobs;
+  for (const std::string& f : files) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(f, ec);
+    jobs.push_back(Job{f, ec ? 0 : static_cast<std::uint64_t>(size)});
+  }
+  std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.bytes > b.bytes; });
+
+  MemoryBudget budget(cfg.memory_budget);
+  std::mutex mu; // guards ratio, sum and on_result
+  double ratio = cfg.book_ratio;
+
+  WorkStealingPool pool(threads);
+  for (std::size_t i = 0; i < jobs.size(); ++i) {
+    const Job& job = jobs[i];
+    pool.push(static_cast<unsigned>(i % threads), [&, job](unsigned worker) {
+      FileResult r;
+      r.path = job.path;
+      r.worker = worker;
+      r.bytes = job.bytes;
+
+      std::uint64_t charge;
+      {
+        std::lock_guard<std::mutex> lk(mu);
+        charge = job.bytes + static_cast<std::uint64_t>(static_cast<double>(job.bytes) * ratio);
+      }
+      const auto queued = Clock::now();
+      budget.acquire(charge);
+      r.queued_seconds = seconds_since(queued);
+
+      const auto t0 = Clock::now();
+      replay_one(job.path, cfg, &r);
+      r.seconds = seconds_since(t0);
+      budget.release(charge);
+
+      std::lock_guard<std::mutex> lk(mu);
+      if (job.bytes > 0) ratio = std::max(ratio, static_cast<double>(r.book_bytes) / static_cast<double>(job.bytes));
+      sum.bytes += r.bytes;
+      sum.messages += r.messages;
+      if (!r.ok) ++sum.failed;
+      if (on_result) on_result(r);
+    });
+  }
+
+  const auto t0 = Clock::now();
+  pool.run();
+  sum.seconds = seconds_since(t0);
+  sum.peak_budget_bytes = budget.peak();
+  return sum;
+}
+
+std::vector<std::string> expand_file_args(const std::vector<std::string>& args) {
+  std::vector<std::string> out;
+  auto expand = [&](const std::string& pattern) {
+    glob_t g{};
+    if (::glob(pattern.c_str(), 0, nullptr, &g) == 0) {
+      for (std::size_t i = 0; i < g.gl_pathc; ++i) out.emplace_back(g.gl_pathv[i]);
+    } else {
+      out.push_back(pattern);
+    }
+    ::globfree(&g);
+  };
+  for (const std::string& a : args) {
+    if (a.size() > 1 && a[0] == '@') {
+      std::ifstream in(a.substr(1));
+      if (!in) {
+        out.push_back(a);
+        continue;
+      }
+      std::string line;
+      while (std::getline(in, line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) line.pop_back();
+        std::size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#') continue;
+        expand(line.substr(start));
+      }
+    } else {
+      expand(a);
+    }
+  }
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+  return out;
+}
+
+} // namespace ob::ingest
@@ -0,0 +1,173 @@
+#include "ob/ingest/framing.hpp"
+#include "ob/ingest/itch.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ob::ingest {
+
+namespace {
+
+// Messages checked per framing by detect_itch_framing().
+constexpr std::size_t kProbe = 16;
+
+std::size_t read_len(const std::uint8_t* p) {
+  return (static_cast<std::size_t>(p[0]) << 8) | p[1];
+}
+
+std::size_t message_size(std::uint8_t type) {
+  return itch_message_size(static_cast<char>(type));
+}
+
+// SoupBinTCP packet types a server sends.
+bool is_soupbin_packet(std::uint8_t type) {
+  switch (type) {
+    case '+': case 'A': case 'J': case 'H': case 'S': case 'Z': return true;
+    default: return false;
+  }
+}
+
+// Bytes taken by the frame at off if it is well formed under f, else 0.
+std::size_t probe_frame(const std::uint8_t* buf, std::size_t size, std::size_t off, ItchFraming f) {
+  switch (f) {
+    case ItchFraming::Raw:
+      return message_size(buf[off]);
+    case ItchFraming::LengthPrefixed: {
+      if (off + 3 > size) return 0;
+      const std::size_t len = read_len(buf + off);
+      return (len > 0 && message_size(buf[off + 2]) == len) ? len + 2 : 0;
+    }
+    case ItchFraming::SoupBin: {
+      if (off + 3 > size) return 0;
+      const std::size_t len = read_len(buf + off);
+      if (len == 0 || !is_soupbin_packet(buf[off + 2])) return 0;
+      if (buf[off + 2] == 'S' && (off + 4 > size || message_size(buf[off + 3]) + 1 != len)) return 0;
+      return len + 2;
+    }
+    case ItchFraming::Auto:
+      break;
+  }
+  return 0;
+}
+
+bool consistent(const std::uint8_t* buf, std::size_t size, ItchFraming f) {
+  std::size_t off = 0;
+  std::size_t n = 0;
+  while (n < kProbe && off < size) {
+    const std::size_t step = probe_frame(buf, size, off, f);
+    if (step == 0 || off + step > size) return false;
+    off += step;
+    ++n;
+  }
+  return n > 0;
+}
+
+} // namespace
+
+const char* to_string(ItchFraming f) {
+  switch (f) {
+    case ItchFraming::Auto: return "auto";
+    case ItchFraming::Raw: return "raw";
+    case ItchFraming::LengthPrefixed: return "length";
+    case ItchFraming::SoupBin: return "soupbin";
+  }
+  return "unknown";
+}
+
+bool parse_itch_framing(std::string_view name, ItchFraming* out) {
+  for (ItchFraming f : {ItchFraming::Auto, ItchFraming::Raw, ItchFraming::LengthPrefixed, ItchFraming::SoupBin}) {
+    if (name == to_string(f)) {
+      *out = f;
+      return true;
+    }
+  }
+  return false;
+}
+
+ItchFraming detect_itch_framing(const std::uint8_t* buffer, std::size_t size) {
+  for (ItchFraming f : {ItchFraming::LengthPrefixed, ItchFraming::SoupBin}) {
+    if (consistent(buffer, size, f)) return f;
+  }
+  return ItchFraming::Raw;
+}
+
+bool index_itch(const std::uint8_t* buffer, std::size_t size, ItchFraming framing, ItchIndex* out) {
+  if (framing == ItchFraming::Auto) framing = detect_itch_framing(buffer, size);
+  *out = ItchIndex{};
+  out->framing = framing;
+  out->offsets.reserve(size / 24); // a typical day averages about 30 bytes a message
+  std::size_t off = 0;
+  switch (framing) {
+    case ItchFraming::Raw:
+      while (off < size) {
+        const std::size_t len = message_size(buffer[off]);
+        if (len == 0 || off + len > size) break;
+        out->offsets.push_back(off);
+        off += len;
+      }
+      break;
+    case ItchFraming::LengthPrefixed:
+      while (off + 2 <= size) {
+        const std::size_t len = read_len(buffer + off);
+        if (off + 2 + len > size) break;
+        if (len > 0 && message_size(buffer[off + 2]) == len) {
+          out->offsets.push_back(off + 2);
+        } else {
+          ++out->unknown;
+        }
+        off += 2 + len;
+      }
+      break;
+    case ItchFraming::SoupBin:
+      while (off + 2 <= size) {
+        const std::size_t len = read_len(buffer + off);
+        if (len == 0 || off + 2 + len > size) break;
+        if (buffer[off + 2] != 'S') {
+          ++out->other;
+        } else if (len > 1 && message_size(buffer[off + 3]) + 1 == len) {
+          out->offsets.push_back(off + 3);
+        } else {
+          ++out->unknown;
+        }
+        off += 2 + len;
+      }
+      break;
+    case ItchFraming::Auto:
+      break;
+  }
+  out->end = off;
+  return off == size;
+}
+
+std::vector<std::size_t> split_itch_index(const ItchIndex& index, std::size_t parts) {
+  parts = std::max<std::size_t>(parts, 1);
+  std::vector<std::size_t> cuts;
+  cuts.reserve(parts + 1);
+  cuts.push_back(0);
+  const std::uint64_t first = index.offsets.empty() ? 0 : index.offsets.front();
+  const std::uint64_t span = index.end > first ? index.end - first : 0;
+  for (std::size_t k = 1; k < parts; ++k) {
+    const std::uint64_t target = first + span * k / parts;
+    auto it = std::lower_bound(index.offsets.begin(), index.offsets.end(), target);
+    cuts.push_back(std::max(cuts.back(), static_cast<std::size_t>(it - index.offsets.begin())));
+  }
+  cuts.push_back(index.size());
+  return cuts;
+}
+
+bool unframe_itch(std::vector<std::uint8_t>* data, ItchFraming framing, ItchIndex* index) {
+  const bool whole = index_itch(data->data(), data->size(), framing, index);
+  if (index->framing == ItchFraming::Raw) return whole;
+  std::uint8_t* buf = data->data();
+  std::size_t w = 0;
+  for (std::uint64_t& off : index->offsets) {
+    const std::size_t len = message_size(buf[off]);
+    std::memmove(buf + w, buf + off, len); // w <= off: each frame shrinks by its header
+    off = w;
+    w += len;
+  }
+  data->resize(w);
+  return whole;
+}
+
+} // namespace ob::ingest
@@ -1,18 +1,178 @@
 #include "ob/ingest/itch.hpp"
 
+#include <cstring>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
 namespace ob::ingest {
 
+namespace {
+
+// Body offsets below exclude the type byte (ItchMessageView::body starts after it).
+constexpr std::size_t kLocateOff = 0;
+constexpr std::size_t kTrackingOff = 2;
+constexpr std::size_t kTimestampOff = 4;
+constexpr std::size_t kOrderRefOff = 10;
+
+std::uint16_t read_be16(const std::uint8_t* p) {
+  return static_cast<std::uint16_t>((p[0] << 8) | p[1]);
+}
+
+std::uint32_t read_be32(const std::uint8_t* p) {
+  return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16) |
+         (static_cast<std::uint32_t>(p[2]) << 8) | static_cast<std::uint32_t>(p[3]);
+}
+
+std::uint64_t read_be48(const std::uint8_t* p) {
+  return (static_cast<std::uint64_t>(read_be16(p)) << 32) | read_be32(p + 2);
+}
+
+std::uint64_t read_be64(const std::uint8_t* p) {
+  return (static_cast<std::uint64_t>(read_be32(p)) << 32) | read_be32(p + 4);
+}
+
+bool has_body(const ItchMessageView& msg) {
+  return msg.body && msg.body_size + 1 == itch_message_size(msg.type);
+}
+
+std::uint32_t load_be32(const std::uint8_t* p) {
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return __builtin_bswap32(v);
+}
+
+std::uint64_t load_be64(const std::uint8_t* p) {
+  std::uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return __builtin_bswap64(v);
+}
+
+// Body offset of the count field in each run type ('D' has none).
+constexpr std::size_t run_qty_offset(char type) {
+  return type == 'A' ? 19 : 18;
+}
+
+// Messages of `type` starting at buffer[offset], up to kMax and whole messages only.
+std::size_t run_length(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t offset, char type,
+                       std::size_t size, const ItchFilter* filter) {
+  std::size_t n = 0;
+  while (n < ItchRun::kMax && offset + size <= buffer_size && buffer[offset] == static_cast<std::uint8_t>(type)) {
+    if (filter && !filter->wants_locate(read_be16(buffer + offset + 1))) break;
+    ++n;
+    offset += size;
+  }
+  return n;
+}
+
+template <char Type>
+void decode_run_scalar(const std::uint8_t* p, std::size_t n, ItchRun* out) {
+  constexpr std::size_t size = Type == 'A' ? 36 : Type == 'D' ? 19 : Type == 'X' ? 23 : 31;
+  for (std::size_t i = 0; i < n; ++i, p += size) {
+    const std::uint8_t* b = p + 1;
+    out->locate[i] = read_be16(b + kLocateOff);
+    out->timestamp[i] = read_be48(b + kTimestampOff);
+    out->order_id[i] = load_be64(b + kOrderRefOff);
+    if constexpr (Type != 'D') out->qty[i] = load_be32(b + run_qty_offset(Type));
+    if constexpr (Type == 'A') {
+      out->side[i] = (b[18] == 'S') ? Side::Sell : Side::Buy;
+      out->price[i] = static_cast<Price>(load_be32(b + 31));
+    }
+  }
+}
+
+#if defined(__SSSE3__)
+// One 16-byte load at body+0 gives the header: timestamp to lane bytes 0-5, locate to 8-9.
+// A second load gives the order reference (bytes 0-7) and count (bytes 8-11), byte-swapped
+// by one shuffle; its start is chosen per type so the load stays inside the message.
+template <char Type>
+void decode_run_ssse3(const std::uint8_t* p, std::size_t n, ItchRun* out) {
+  constexpr std::size_t size = Type == 'A' ? 36 : Type == 'D' ? 19 : Type == 'X' ? 23 : 31;
+  constexpr int at = Type == 'A' ? 10 : Type == 'D' ? 2 : 6; // second load, body-relative
+  constexpr int o = kOrderRefOff - at;                        // order reference within it
+  constexpr int q = static_cast<int>(run_qty_offset(Type)) - at;
+  const __m128i hdr_mask = _mm_setr_epi8(9, 8, 7, 6, 5, 4, -1, -1, 1, 0, -1, -1, -1, -1, -1, -1);
+  const __m128i fld_mask = Type == 'D'
+      ? _mm_setr_epi8(o + 7, o + 6, o + 5, o + 4, o + 3, o + 2, o + 1, o, -1, -1, -1, -1, -1, -1, -1, -1)
+      : _mm_setr_epi8(o + 7, o + 6, o + 5, o + 4, o + 3, o + 2, o + 1, o, q + 3, q + 2, q + 1, q, -1, -1, -1, -1);
+  for (std::size_t i = 0; i < n; ++i, p += size) {
+    const std::uint8_t* b = p + 1;
+    const __m128i h = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b)), hdr_mask);
+    const __m128i f = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + at)), fld_mask);
+    out->timestamp[i] = static_cast<std::uint64_t>(_mm_cvtsi128_si64(h));
+    out->locate[i] = static_cast<StockLocate>(_mm_extract_epi16(h, 4));
+    out->order_id[i] = static_cast<OrderId>(_mm_cvtsi128_si64(f));
+    if constexpr (Type != 'D') out->qty[i] = static_cast<Qty>(_mm_cvtsi128_si32(_mm_srli_si128(f, 8)));
+    if constexpr (Type == 'A') {
+      out->side[i] = (b[18] == 'S') ? Side::Sell : Side::Buy;
+      out->price[i] = static_cast<Price>(load_be32(b + 31));
+    }
+  }
+}
+#endif
+
+template <bool Simd>
+std::size_t decode_run(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset, ItchRun* out,
+                       const ItchFilter* filter = nullptr) {
+  if (!buffer || !offset || !out || *offset >= buffer_size) return 0;
+  const char type = static_cast<char>(buffer[*offset]);
+  if (type != 'A' && type != 'D' && type != 'X' && type != 'E') return 0;
+  const std::size_t size = itch_message_size(type);
+  const std::size_t n = run_length(buffer, buffer_size, *offset, type, size, filter);
+  if (n == 0) return 0;
+
+  const std::uint8_t* p = buffer + *offset;
+  auto dispatch = [&]<char T>() {
+#if defined(__SSSE3__)
+    if constexpr (Simd) {
+      decode_run_ssse3<T>(p, n, out);
+      return;
+    }
+#endif
+    decode_run_scalar<T>(p, n, out);
+  };
+  switch (type) {
+    case 'A': dispatch.template operator()<'A'>(); break;
+    case 'D': dispatch.template operator()<'D'>(); break;
+    case 'X': dispatch.template operator()<'X'>(); break;
+    default: dispatch.template operator()<'E'>(); break;
+  }
+  out->type = type;
+  out->count = n;
+  *offset += n * size;
+  return n;
+}
+
+} // namespace
+
 std::size_t itch_message_size(char type) {
-  // TODO: verify these ITCH 5.0 message sizes against the official spec.
+  // Sizes include the type byte (ITCH 5.0 spec).
   switch (type) {
     case 'R': return 39; // Stock Directory
     case 'A': return 36; // Add Order (no MPID)
     case 'F': return 40; // Add Order (with MPID)
     case 'X': return 23; // Order Cancel
     case 'D': return 19; // Order Delete
-    case 'E': return 30; // Order Executed
-    case 'C': return 35; // Order Executed With Price
+    case 'E': return 31; // Order Executed
+    case 'C': return 36; // Order Executed With Price
     case 'U': return 35; // Order Replace
+    case 'P': return 44; // Trade (non-cross)
+    // Not decoded, sized so that raw files step over them.
+    case 'S': return 12; // System Event
+    case 'H': return 25; // Stock Trading Action
+    case 'Y': return 20; // Reg SHO Restriction
+    case 'L': return 26; // Market Participant Position
+    case 'V': return 35; // MWCB Decline Level
+    case 'W': return 12; // MWCB Status
+    case 'K': return 28; // IPO Quoting Period Update
+    case 'J': return 35; // LULD Auction Collar
+    case 'h': return 21; // Operational Halt
+    case 'Q': return 40; // Cross Trade
+    case 'B': return 19; // Broken Trade
+    case 'I': return 50; // NOII
+    case 'N': return 20; // Retail Price Improvement Indicator
+    case 'O': return 48; // Direct Listing with Capital Raise
     default: return 0;
   }
 }
@@ -34,4 +194,161 @@ bool decode_next_itch(const std::uint8_t* buffer, std::size_t buffer_size, std::
   return true;
 }
 
+std::size_t decode_itch_run(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset, ItchRun* out) {
+  return decode_run<true>(buffer, buffer_size, offset, out);
+}
+
+std::size_t decode_itch_run_scalar(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset,
+                                   ItchRun* out) {
+  return decode_run<false>(buffer, buffer_size, offset, out);
+}
+
+// ---------------- ItchFilter / ItchDecoder ----------------
+
+void ItchFilter::allow_type(char type) {
+  all_types_ = false;
+  types_.set(static_cast<unsigned char>(type));
+}
+
+void ItchFilter::allow_locate(StockLocate locate) {
+  all_locates_ = false;
+  locates_.set(locate);
+}
+
+void ItchFilter::allow_symbol(std::string_view symbol) {
+  all_locates_ = false;
+  std::string padded(symbol.substr(0, 8));
+  padded.resize(8, ' ');
+  symbols_.push_back(std::move(padded));
+}
+
+bool ItchFilter::wants_symbol(std::string_view padded) const {
+  for (const std::string& s : symbols_) {
+    if (s == padded) return true;
+  }
+  return false;
+}
+
+void ItchDecoder::skip(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset) {
+  if (!filter_.active()) return;
+  while (buffer && *offset < buffer_size) {
+    const char type = static_cast<char>(buffer[*offset]);
+    const std::size_t size = itch_message_size(type);
+    if (size == 0 || *offset + size > buffer_size) return;
+    const std::uint8_t* b = buffer + *offset + 1;
+    if (type == 'R' && filter_.has_symbols()) {
+      const StockLocate loc = read_be16(b + kLocateOff);
+      if (!filter_.wants_locate(loc) && filter_.wants_symbol(std::string_view(reinterpret_cast<const char*>(b + 10), 8))) {
+        filter_.allow_locate(loc);
+        ++stats_.learned_locates;
+      }
+    }
+    if (!filter_.wants_type(type)) {
+      ++stats_.skipped_type;
+    } else if (!filter_.wants_locate(read_be16(b + kLocateOff))) {
+      ++stats_.skipped_locate;
+    } else {
+      return;
+    }
+    stats_.skipped_bytes += size;
+    *offset += size;
+  }
+}
+
+bool ItchDecoder::next(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset, ItchMessageView* out) {
+  if (!offset) return false;
+  skip(buffer, buffer_size, offset);
+  if (!decode_next_itch(buffer, buffer_size, offset, out)) return false;
+  ++stats_.passed;
+  return true;
+}
+
+std::size_t ItchDecoder::next_run(const std::uint8_t* buffer, std::size_t buffer_size, std::size_t* offset,
+                                  ItchRun* out) {
+  if (!offset) return 0;
+  skip(buffer, buffer_size, offset);
+  const std::size_t n = decode_run<true>(buffer, buffer_size, offset, out, filter_.active() ? &filter_ : nullptr);
+  stats_.passed += n;
+  return n;
+}
+
+bool decode_itch_header(const ItchMessageView& msg, ItchHeader* out) {
+  if (!out || !msg.body || msg.body_size < kOrderRefOff) return false;
+  out->locate = read_be16(msg.body + kLocateOff);
+  out->tracking = read_be16(msg.body + kTrackingOff);
+  out->timestamp = read_be48(msg.body + kTimestampOff);
+  return true;
+}
+
+bool decode_itch_stock_directory(const ItchMessageView& msg, StockDirectoryEvent* out) {
+  if (!out || msg.type != 'R' || !has_body(msg)) return false;
+  const std::uint8_t* b = msg.body;
+  std::size_t len = 8;
+  while (len > 0 && b[10 + len - 1] == ' ') --len;
+  out->locate = read_be16(b + kLocateOff);
+  out->symbol = std::string_view(reinterpret_cast<const char*>(b + 10), len);
+  return true;
+}
+
+bool decode_itch_add(const ItchMessageView& msg, AddEvent* out) {
+  if (!out || (msg.type != 'A' && msg.type != 'F') || !has_body(msg)) return false;
+  const std::uint8_t* b = msg.body;
+  out->locate = read_be16(b + kLocateOff);
+  out->order_id = read_be64(b + kOrderRefOff);
+  out->side = (b[18] == 'S') ? Side::Sell : Side::Buy;
+  out->qty = read_be32(b + 19);
+  out->price = static_cast<Price>(read_be32(b + 31));
+  out->has_mpid = (msg.type == 'F');
+  out->mpid = out->has_mpid ? read_be32(b + 35) : 0;
+  return true;
+}
+
+bool decode_itch_cancel(const ItchMessageView& msg, CancelEvent* out) {
+  if (!out || msg.type != 'X' || !has_body(msg)) return false;
+  out->locate = read_be16(msg.body + kLocateOff);
+  out->order_id = read_be64(msg.body + kOrderRefOff);
+  out->cancel_qty = read_be32(msg.body + 18);
+  return true;
+}
+
+bool decode_itch_delete(const ItchMessageView& msg, DeleteEvent* out) {
+  if (!out || msg.type != 'D' || !has_body(msg)) return false;
+  out->locate = read_be16(msg.body + kLocateOff);
+  out->order_id = read_be64(msg.body + kOrderRefOff);
+  return true;
+}
+
+bool decode_itch_execute(const ItchMessageView& msg, ExecuteEvent* out) {
+  if (!out || (msg.type != 'E' && msg.type != 'C') || !has_body(msg)) return false;
+  out->locate = read_be16(msg.body + kLocateOff);
+  out->order_id = read_be64(msg.body + kOrderRefOff);
+  out->exec_qty = read_be32(msg.body + 18);
+  out->has_price = (msg.type == 'C');
+  out->printable = !out->has_price || msg.body[30] == 'Y';
+  out->price = out->has_price ? static_cast<Price>(read_be32(msg.body + 31)) : 0;
+  return true;
+}
+
+bool decode_itch_replace(const ItchMessageView& msg, ReplaceEvent* out) {
+  if (!out || msg.type != 'U' || !has_body(msg)) return false;
+  const std::uint8_t* b = msg.body;
+  out->locate = read_be16(b + kLocateOff);
+  out->old_order_id = read_be64(b + kOrderRefOff);
+  out->new_order_id = read_be64(b + 18);
+  out->new_qty = read_be32(b + 26);
+  out->new_price = static_cast<Price>(read_be32(b + 30));
+  return true;
+}
+
+bool decode_itch_trade(const ItchMessageView& msg, TradeEvent* out) {
+  if (!out || msg.type != 'P' || !has_body(msg)) return false;
+  const std::uint8_t* b = msg.body;
+  out->locate = read_be16(b + kLocateOff);
+  out->order_id = read_be64(b + kOrderRefOff);
+  out->side = (b[18] == 'S') ? Side::Sell : Side::Buy;
+  out->qty = read_be32(b + 19);
+  out->price = static_cast<Price>(read_be32(b + 31));
+  return true;
+}
+
 } // namespace ob::ingest
@@ -0,0 +1,145 @@
+#include "ob/ingest/pipeline.hpp"
+#include "ob/ingest/itch.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace ob::ingest {
+
+namespace {
+
+template <typename T>
+RingStats ring_stats(const SpscRing<T>& r) {
+  RingStats s;
+  s.capacity = r.capacity();
+  s.occupancy = r.size();
+  s.high_water = r.high_water();
+  s.pushed = r.pushed();
+  s.full_stalls = r.full_stalls();
+  s.empty_polls = r.empty_polls();
+  return s;
+}
+
+} // namespace
+
+bool pin_current_thread(int cpu) {
+  if (cpu < 0) return true;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
+
+IngestPipeline::IngestPipeline(const PipelineConfig& cfg)
+  : cfg_(cfg), frames_(cfg.frame_ring), spare_frames_(cfg.frame_ring), events_(cfg.event_ring) {}
+
+IngestPipeline::~IngestPipeline() {
+  join();
+}
+
+void IngestPipeline::start(Source source) {
+  recv_done_.store(false, std::memory_order_relaxed);
+  decode_done_.store(false, std::memory_order_relaxed);
+  type_counts_.fill(0);
+  recv_ = std::thread([this, src = std::move(source)]() mutable { recv_loop(std::move(src)); });
+  decode_ = std::thread([this] { decode_loop(); });
+}
+
+void IngestPipeline::join() {
+  if (recv_.joinable()) recv_.join();
+  if (decode_.joinable()) decode_.join();
+}
+
+void IngestPipeline::recv_loop(Source source) {
+  pin_current_thread(cfg_.recv_cpu);
+  std::vector<std::uint8_t> payload;
+  for (;;) {
+    // A pushed payload leaves a moved-from vector; take a decoded frame's buffer instead.
+    if (payload.capacity() == 0) spare_frames_.try_pop(&payload);
+    payload.clear();
+    if (!source(&payload)) break;
+    if (!payload.empty()) frames_.push(std::move(payload));
+  }
+  recv_done_.store(true, std::memory_order_release);
+}
+
+void IngestPipeline::decode_loop() {
+  pin_current_thread(cfg_.decode_cpu);
+  ItchDecoder decoder(cfg_.filter);
+  std::vector<std::uint8_t> frame;
+  ItchRun run;
+  std::uint64_t messages = 0;
+  std::uint64_t frames = 0;
+  for (;;) {
+    if (!frames_.try_pop(&frame)) {
+      if (!recv_done_.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (!frames_.try_pop(&frame)) break;
+    }
+
+    std::size_t offset = 0;
+    ItchMessageView msg;
+    for (;;) {
+      if (std::size_t n = decoder.next_run(frame.data(), frame.size(), &offset, &run)) {
+        type_counts_[static_cast<unsigned char>(run.type)] += n;
+        messages += n;
+        visit_itch_run(run, [&](std::uint64_t ts, const auto& e) { events_.push(TimedEvent{ts, e}); });
+        continue;
+      }
+      if (!decoder.next(frame.data(), frame.size(), &offset, &msg)) break;
+      ++type_counts_[static_cast<unsigned char>(msg.type)];
+      ++messages;
+      ItchHeader hdr;
+      if (!decode_itch_header(msg, &hdr)) continue;
+      visit_itch_book_event(msg, [&](const auto& e) {
+        using E = std::decay_t<decltype(e)>;
+        if constexpr (std::is_same_v<E, StockDirectoryEvent>) {
+          DirectoryRecord d;
+          d.locate = e.locate;
+          d.len = static_cast<std::uint8_t>(std::min(e.symbol.size(), sizeof(d.symbol)));
+          std::memcpy(d.symbol, e.symbol.data(), d.len);
+          events_.push(TimedEvent{hdr.timestamp, d});
+        } else {
+          events_.push(TimedEvent{hdr.timestamp, e});
+        }
+      });
+    }
+    // The next frame starts on a message boundary again, so decoding goes on there.
+    if (offset != frame.size()) {
+      last_stop_frame_.store(frames, std::memory_order_relaxed);
+      last_stop_offset_.store(offset, std::memory_order_relaxed);
+      leftover_bytes_.store(leftover_bytes_.load(std::memory_order_relaxed) + (frame.size() - offset),
+                            std::memory_order_relaxed);
+      stopped_frames_.store(stopped_frames_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    ++frames;
+    frame.clear();
+    spare_frames_.try_push(std::move(frame)); // if the ring is full, the next pop frees it
+    messages_.store(messages, std::memory_order_release);
+    const ItchFilterStats& fs = decoder.stats();
+    skipped_.store(fs.skipped_type + fs.skipped_locate, std::memory_order_relaxed);
+  }
+  filter_stats_ = decoder.stats();
+  decode_done_.store(true, std::memory_order_release);
+}
+
+PipelineStats IngestPipeline::stats() const {
+  PipelineStats s;
+  s.frames = ring_stats(frames_);
+  s.events = ring_stats(events_);
+  s.messages = messages_.load(std::memory_order_acquire);
+  s.skipped = skipped_.load(std::memory_order_relaxed);
+  s.events_applied = applied_.load(std::memory_order_relaxed);
+  s.stopped_frames = stopped_frames_.load(std::memory_order_relaxed);
+  s.leftover_bytes = leftover_bytes_.load(std::memory_order_relaxed);
+  s.last_stop_frame = last_stop_frame_.load(std::memory_order_relaxed);
+  s.last_stop_offset = last_stop_offset_.load(std::memory_order_relaxed);
+  return s;
+}
+
+} // namespace ob::ingest
@@ -127,13 +127,12 @@ bool SoupBinClient::read_frame(SoupBinFrame* out) {
   std::uint8_t type = 0;
   if (!read_exact(&type, 1)) return false;
 
-  std::vector<std::uint8_t> payload;
-  std::size_t payload_len = len - 1;
-  payload.resize(payload_len);
-  if (payload_len > 0 && !read_exact(payload.data(), payload_len)) return false;
+  // Read into out's own buffer, so a caller reusing one frame allocates only to grow it.
+  const std::size_t payload_len = len - 1;
+  out->payload.resize(payload_len);
+  if (payload_len > 0 && !read_exact(out->payload.data(), payload_len)) return false;
 
   out->type = static_cast<char>(type);
-  out->payload = std::move(payload);
   return true;
 }
 
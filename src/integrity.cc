@@ -0,0 +1,116 @@
+#include "ob/integrity.hpp"
+
+namespace ob {
+
+void IntegrityChecker::violation(std::uint64_t* counter, StockLocate locate) {
+  ++*counter;
+  stats_.last_violation = locate;
+}
+
+IntegrityChecker::Cursor& IntegrityChecker::cursor(StockLocate locate) {
+  if (locate >= cursors_.size()) cursors_.resize(static_cast<std::size_t>(locate) + 1);
+  return cursors_[locate];
+}
+
+// FIFO links, per-order fields and totals of one level; `better` is the level walked
+// just before it on the same side, if any.
+bool IntegrityChecker::check_level(const Level& l, Side s, const Level* better) const {
+  if (better && (s == Side::Buy ? l.price >= better->price : l.price <= better->price)) return false;
+  if (l.order_count == 0 || !l.head || !l.tail) return false;
+  std::uint64_t qty = 0;
+  std::uint32_t count = 0;
+  const Order* prev = nullptr;
+  for (const Order* o = l.head; o; o = o->next) {
+    if (o->level != &l || o->side != s || o->price != l.price || o->prev != prev) return false;
+    if (++count > l.order_count) return false; // also stops on a cycle
+    qty += o->qty;
+    prev = o;
+  }
+  return prev == l.tail && count == l.order_count && qty == l.total_qty;
+}
+
+void IntegrityChecker::on_level(const SymbolBook& book, const LevelUpdate& u) {
+  ++stats_.updates;
+
+  const Level* l = book.find_level(u.side, u.price);
+  const bool gone = u.qty == 0 && u.count == 0;
+  if (gone ? l != nullptr
+           : (!l || l->total_qty != u.qty || l->order_count != u.count || (u.qty == 0) != (u.count == 0))) {
+    violation(&stats_.level_mismatch, u.locate);
+  }
+  const TopOfBook t = book.top();
+  if (t.has_bid && t.has_ask && t.bid.price >= t.ask.price) violation(&stats_.crossed, u.locate);
+
+  if (cfg_.sample_every > 0) {
+    if (!started_) {
+      started_ = true;
+      start_ = Clock::now();
+    }
+    if (until_slice_ == 0) {
+      until_slice_ = cfg_.sample_every;
+      const auto now = Clock::now();
+      const double budget = cfg_.max_overhead * static_cast<double>((now - start_).count());
+      if (stats_.slices > 0 && static_cast<double>(stats_.check_ns) > budget) {
+        ++stats_.throttled;
+      } else {
+        check_slice(book);
+        stats_.check_ns += static_cast<std::uint64_t>(std::chrono::nanoseconds(Clock::now() - now).count());
+      }
+    }
+    --until_slice_;
+  }
+
+  if (next_) next_->on_level(book, u);
+}
+
+void IntegrityChecker::on_reset(const SymbolBook& book) {
+  if (book.locate() < cursors_.size()) cursors_[book.locate()] = Cursor{};
+  if (next_) next_->on_reset(book);
+}
+
+void IntegrityChecker::check_slice(const SymbolBook& book) {
+  ++stats_.slices;
+  Cursor& c = cursor(book.locate());
+
+  // Levels: resume past the cursor's price; at the end of a side, continue on the other one.
+  std::uint32_t walked = 0;
+  for (int pass = 0; pass < 2 && walked < cfg_.slice_levels; ++pass) {
+    const Level* prev = nullptr;
+    bool reached_end = true;
+    auto walk = [&](const Level& l) {
+      if (walked == cfg_.slice_levels) {
+        reached_end = false;
+        return false;
+      }
+      if (!check_level(l, c.side, prev)) violation(&stats_.level_mismatch, book.locate());
+      stats_.orders_checked += l.order_count;
+      ++stats_.levels_checked;
+      ++walked;
+      c.after = l.price;
+      c.resume = true;
+      prev = &l;
+      return true;
+    };
+    if (c.resume) {
+      book.for_each_level_after(c.side, c.after, walk);
+    } else {
+      book.for_each_level(c.side, walk);
+    }
+    if (!reached_end) break;
+    c.resume = false;
+    c.side = (c.side == Side::Buy) ? Side::Sell : Side::Buy;
+  }
+
+  // Order index.
+  const std::size_t buckets = book.order_buckets();
+  if (c.bucket >= buckets) c.bucket = 0;
+  std::uint64_t bad = 0;
+  stats_.orders_checked += book.check_orders(c.bucket, cfg_.slice_buckets, &bad);
+  if (bad > 0) {
+    stats_.order_mismatch += bad;
+    stats_.last_violation = book.locate();
+  }
+  c.bucket += cfg_.slice_buckets;
+}
+
+} // namespace ob
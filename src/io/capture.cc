@@ -0,0 +1,247 @@
+#include "ob/io/capture.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+
+namespace ob::io {
+
+namespace {
+
+constexpr std::size_t kAlign = 4096; // O_DIRECT offset/length/buffer alignment
+
+std::size_t round_up(std::size_t n, std::size_t a) {
+  return (n + a - 1) / a * a;
+}
+
+} // namespace
+
+CaptureWriter::~CaptureWriter() {
+  close();
+}
+
+std::uint64_t CaptureWriter::now_ns() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1'000'000'000ULL + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+CaptureWriter::Chunk* CaptureWriter::make_chunk() {
+  auto* mem = static_cast<std::uint8_t*>(std::aligned_alloc(kAlign, cfg_.chunk_bytes));
+  if (!mem) return nullptr;
+  auto c = std::make_unique<Chunk>();
+  c->data = {mem, &std::free};
+  chunks_.push_back(std::move(c));
+  return chunks_.back().get();
+}
+
+bool CaptureWriter::open(const std::string& path, const CaptureConfig& cfg) {
+  close();
+  cfg_ = cfg;
+  cfg_.chunk_bytes = round_up(std::max<std::size_t>(cfg.chunk_bytes, kAlign), kAlign);
+  cfg_.ring_chunks = std::max<std::size_t>(cfg.ring_chunks, 2);
+  path_ = path;
+  file_index_ = 0;
+  files_.store(0, std::memory_order_relaxed);
+
+  full_ = std::make_unique<SpscRing<Chunk*>>(cfg_.ring_chunks);
+  free_ = std::make_unique<SpscRing<Chunk*>>(cfg_.ring_chunks);
+  chunks_.clear();
+  bool ok = true;
+  for (std::size_t i = 1; ok && i < cfg_.ring_chunks; ++i) {
+    Chunk* c = make_chunk();
+    ok = c != nullptr && free_->try_push(std::move(c));
+  }
+  current_ = ok ? make_chunk() : nullptr;
+  if (!current_ || !open_file(0)) {
+    current_ = nullptr;
+    chunks_.clear();
+    full_.reset();
+    free_.reset();
+    return false;
+  }
+  records_ = 0;
+  bytes_ = 0;
+  chunks_allocated_ = 0;
+  stalls_ = 0;
+  file_bytes_ = 0;
+  roll_pending_ = false;
+  stop_.store(false, std::memory_order_relaxed);
+  failed_.store(false, std::memory_order_relaxed);
+
+  // The file header travels through the chunk stream like any record, so every chunk
+  // but a file's last is written whole and O_DIRECT stays aligned.
+  CaptureFileHeader fh{};
+  std::memcpy(fh.magic, kCaptureMagic, sizeof(fh.magic));
+  fh.version = kCaptureVersion;
+  put(&fh, sizeof(fh));
+  writer_ = std::thread([this] { writer_loop(); });
+  return true;
+}
+
+bool CaptureWriter::close() {
+  if (!writer_.joinable()) return true;
+  if (current_->used > 0) {
+    hand_off(false);
+  }
+  stop_.store(true, std::memory_order_release);
+  writer_.join();
+
+  current_ = nullptr;
+  stalls_ = full_->full_stalls();
+  full_.reset();
+  free_.reset();
+  chunks_.clear();
+  return !failed_.load(std::memory_order_relaxed);
+}
+
+void CaptureWriter::put(const void* p, std::size_t n) {
+  const auto* src = static_cast<const std::uint8_t*>(p);
+  while (n > 0) {
+    if (current_->used == cfg_.chunk_bytes) hand_off(false);
+    const std::size_t take = std::min(n, cfg_.chunk_bytes - current_->used);
+    std::memcpy(current_->data.get() + current_->used, src, take);
+    current_->used += take;
+    src += take;
+    n -= take;
+  }
+  file_bytes_ += static_cast<std::uint64_t>(src - static_cast<const std::uint8_t*>(p));
+}
+
+void CaptureWriter::hand_off(bool roll_after) {
+  current_->roll_after = roll_after;
+  full_->push(std::move(current_)); // stalls only when ring_chunks chunks are queued
+  if (!free_->try_pop(&current_)) {
+    current_ = make_chunk();
+    if (current_) {
+      ++chunks_allocated_;
+    } else {
+      // Out of memory: wait for the writer to return a chunk instead.
+      while (!free_->try_pop(&current_)) std::this_thread::yield();
+    }
+  }
+  current_->used = 0;
+  current_->roll_after = false;
+}
+
+void CaptureWriter::record(char type, const std::uint8_t* data, std::size_t len, std::uint64_t recv_ns) {
+  static constexpr std::uint8_t kZeros[8] = {};
+  if (roll_pending_) {
+    // Deferred so that a capture never ends in a file holding only a header.
+    roll_pending_ = false;
+    file_bytes_ = 0;
+    CaptureFileHeader fh{};
+    std::memcpy(fh.magic, kCaptureMagic, sizeof(fh.magic));
+    fh.version = kCaptureVersion;
+    fh.file_index = ++file_index_;
+    put(&fh, sizeof(fh));
+  }
+  CaptureRecordHeader h{};
+  h.recv_ns = recv_ns;
+  h.length = static_cast<std::uint32_t>(len);
+  h.type = type;
+  put(&h, sizeof(h));
+  put(data, len);
+  put(kZeros, round_up(len, 8) - len);
+  ++records_;
+  bytes_ += len;
+
+  if (cfg_.roll_bytes > 0 && file_bytes_ >= cfg_.roll_bytes) {
+    hand_off(true);
+    roll_pending_ = true;
+  }
+}
+
+CaptureStats CaptureWriter::stats() const {
+  CaptureStats s;
+  s.records = records_;
+  s.bytes = bytes_;
+  s.files = files_.load(std::memory_order_relaxed);
+  s.chunks_allocated = chunks_allocated_;
+  s.stalls = full_ ? full_->full_stalls() : stalls_;
+  return s;
+}
+
+// ---------------- writer thread ----------------
+
+bool CaptureWriter::open_file(std::uint32_t index) {
+  const std::string name = index == 0 ? path_ : path_ + "." + std::to_string(index);
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  if (cfg_.direct) {
+    fd_ = ::open(name.c_str(), flags | O_DIRECT, 0644);
+    if (fd_ >= 0) {
+      direct_ = true;
+    } else if (errno != EINVAL) {
+      return false;
+    }
+  }
+  if (fd_ < 0) {
+    // Buffered fallback, also for filesystems without O_DIRECT (tmpfs).
+    direct_ = false;
+    fd_ = ::open(name.c_str(), flags, 0644);
+    if (fd_ < 0) return false;
+  }
+  fd_bytes_ = 0;
+  files_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool CaptureWriter::write_chunk(Chunk& c) {
+  std::size_t len = c.used;
+  if (direct_ && len % kAlign != 0) {
+    // A file's tail: write whole blocks, then cut the padding off again.
+    const std::size_t padded = round_up(len, kAlign);
+    std::memset(c.data.get() + len, 0, padded - len);
+    len = padded;
+  }
+  std::size_t off = 0;
+  while (off < len) {
+    const ssize_t n = ::write(fd_, c.data.get() + off, len - off);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    off += static_cast<std::size_t>(n);
+  }
+  fd_bytes_ += c.used;
+  return len == c.used || ::ftruncate(fd_, static_cast<off_t>(fd_bytes_)) == 0;
+}
+
+bool CaptureWriter::close_file() {
+  if (fd_ < 0) return true;
+  const bool ok = ::close(fd_) == 0;
+  fd_ = -1;
+  return ok;
+}
+
+void CaptureWriter::writer_loop() {
+  std::uint32_t index = 0;
+  bool open_next = false; // a roll closed the last file; the next opens with its first chunk
+  Chunk* c = nullptr;
+  for (;;) {
+    if (!full_->try_pop(&c)) {
+      if (stop_.load(std::memory_order_acquire)) {
+        if (!full_->try_pop(&c)) break;
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        continue;
+      }
+    }
+    if (open_next) {
+      open_next = false;
+      if (!open_file(++index)) failed_.store(true, std::memory_order_relaxed);
+    }
+    if (fd_ >= 0 && !write_chunk(*c)) failed_.store(true, std::memory_order_relaxed);
+    if (c->roll_after) {
+      if (!close_file()) failed_.store(true, std::memory_order_relaxed);
+      open_next = true;
+    }
+    free_->try_push(std::move(c)); // if the ring is full the chunk idles in chunks_ until close()
+  }
+  if (!close_file()) failed_.store(true, std::memory_order_relaxed);
+}
+
+} // namespace ob::io
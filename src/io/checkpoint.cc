@@ -0,0 +1,197 @@
+#include "ob/io/checkpoint.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace ob::io {
+
+namespace {
+
+// Appends one symbol's checkpoint; returns false on a write error.
+bool write_checkpoint(std::FILE* f, const SymbolBook& b, std::uint64_t ts, std::uint64_t next_record,
+                      std::vector<CheckpointOrder>* scratch) {
+  scratch->clear();
+  for (Side side : {Side::Buy, Side::Sell}) {
+    b.for_each_level(side, [&](const Level& l) {
+      for (const Order* o = l.head; o; o = o->next) {
+        scratch->push_back(CheckpointOrder{o->order_id, o->price, o->qty, o->mpid, o->side,
+                                           static_cast<std::uint8_t>(o->has_mpid), 0});
+      }
+      return true;
+    });
+  }
+  CheckpointHeader h{};
+  h.timestamp = ts;
+  h.next_record = next_record;
+  h.locate = b.locate();
+  h.orders = static_cast<std::uint32_t>(scratch->size());
+  std::memset(h.symbol, ' ', sizeof(h.symbol));
+  std::memcpy(h.symbol, b.symbol().data(), std::min(b.symbol().size(), sizeof(h.symbol)));
+  return std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+         std::fwrite(scratch->data(), sizeof(CheckpointOrder), scratch->size(), f) == scratch->size();
+}
+
+} // namespace
+
+bool build_checkpoints(const JournalReader& journal, const std::string& path, std::uint64_t interval_ns) {
+  if (interval_ns == 0) return false;
+  std::FILE* f = std::fopen(path.c_str(), "wb");
+  if (!f) return false;
+
+  CheckpointFileHeader hdr{};
+  std::memcpy(hdr.magic, kCheckpointMagic, sizeof(hdr.magic));
+  hdr.version = kCheckpointVersion;
+  hdr.interval_ns = interval_ns;
+  hdr.journal_records = journal.records().size();
+  bool ok = std::fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+  std::uint64_t offset = sizeof(hdr);
+
+  OrderBook book;
+  std::vector<CheckpointRef> refs;
+  std::vector<CheckpointOrder> scratch;
+  std::vector<bool> is_dirty(std::size_t{1} << 16, false);
+  std::vector<StockLocate> dirty;
+  std::uint64_t grid = 0;
+
+  auto emit = [&](std::uint64_t next_record) {
+    std::sort(dirty.begin(), dirty.end());
+    for (StockLocate loc : dirty) {
+      is_dirty[loc] = false;
+      const SymbolBook* b = book.find(loc);
+      if (!b) continue;
+      refs.push_back(CheckpointRef{grid, offset, loc, {}});
+      ok = ok && write_checkpoint(f, *b, grid, next_record, &scratch);
+      offset += sizeof(CheckpointHeader) + scratch.size() * sizeof(CheckpointOrder);
+    }
+    dirty.clear();
+  };
+
+  const auto records = journal.records();
+  for (std::uint64_t i = 0; i < records.size() && ok; ++i) {
+    const JournalRecord& r = records[i];
+    if (grid == 0) grid = (r.timestamp / interval_ns + 1) * interval_ns;
+    if (r.timestamp > grid) {
+      emit(i);
+      grid = (r.timestamp + interval_ns - 1) / interval_ns * interval_ns;
+    }
+    visit_journal_event(r, [&](const auto& e) { book.apply(e); });
+    if (!is_dirty[r.locate]) {
+      is_dirty[r.locate] = true;
+      dirty.push_back(r.locate);
+    }
+  }
+
+  std::sort(refs.begin(), refs.end(), [](const CheckpointRef& a, const CheckpointRef& b) {
+    return (a.locate != b.locate) ? a.locate < b.locate : a.timestamp < b.timestamp;
+  });
+  hdr.checkpoints = refs.size();
+  hdr.refs_offset = offset;
+  ok = ok && std::fwrite(refs.data(), sizeof(CheckpointRef), refs.size(), f) == refs.size() &&
+       std::fseek(f, 0, SEEK_SET) == 0 && std::fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+  if (std::fclose(f) != 0) ok = false;
+  return ok;
+}
+
+// ---------------- CheckpointReader ----------------
+
+CheckpointReader::~CheckpointReader() {
+  close();
+}
+
+void CheckpointReader::close() {
+  if (data_) ::munmap(const_cast<std::uint8_t*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+  refs_ = {};
+  journal_ = nullptr;
+}
+
+bool CheckpointReader::open(const std::string& path, const JournalReader& journal) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st{};
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(CheckpointFileHeader)) {
+    ::close(fd);
+    return false;
+  }
+  void* m = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (m == MAP_FAILED) return false;
+  data_ = static_cast<const std::uint8_t*>(m);
+  size_ = static_cast<std::size_t>(st.st_size);
+
+  CheckpointFileHeader hdr;
+  std::memcpy(&hdr, data_, sizeof(hdr));
+  if (std::memcmp(hdr.magic, kCheckpointMagic, sizeof(hdr.magic)) != 0 ||
+      hdr.version != kCheckpointVersion || hdr.journal_records != journal.records().size() ||
+      hdr.refs_offset + hdr.checkpoints * sizeof(CheckpointRef) != size_) {
+    close();
+    return false;
+  }
+  interval_ns_ = hdr.interval_ns;
+  refs_ = {reinterpret_cast<const CheckpointRef*>(data_ + hdr.refs_offset), hdr.checkpoints};
+  journal_ = &journal;
+  return true;
+}
+
+const CheckpointRef* CheckpointReader::find(StockLocate locate, std::uint64_t ts) const {
+  // Last ref of locate with timestamp <= ts.
+  auto it = std::upper_bound(refs_.begin(), refs_.end(), std::pair{locate, ts},
+                             [](const std::pair<StockLocate, std::uint64_t>& k, const CheckpointRef& r) {
+                               return (k.first != r.locate) ? k.first < r.locate : k.second < r.timestamp;
+                             });
+  if (it == refs_.begin()) return nullptr;
+  --it;
+  return (it->locate == locate) ? &*it : nullptr;
+}
+
+bool CheckpointReader::book_at(StockLocate locate, std::uint64_t ts, OrderBook& book, AsOfStats* stats) const {
+  if (!journal_) return false;
+  AsOfStats st;
+  book.reset(locate);
+
+  // A reused book may keep locate registered from a later time: the symbol is known
+  // only if a checkpoint or a directory record up to ts says so.
+  bool known = false;
+  std::uint64_t from = 0;
+  if (const CheckpointRef* ref = find(locate, ts)) {
+    known = true;
+    CheckpointHeader h;
+    std::memcpy(&h, data_ + ref->offset, sizeof(h));
+    const auto* orders = reinterpret_cast<const CheckpointOrder*>(data_ + ref->offset + sizeof(h));
+    std::size_t len = sizeof(h.symbol);
+    while (len > 0 && h.symbol[len - 1] == ' ') --len;
+    book.apply(StockDirectoryEvent{.locate=locate, .symbol=std::string_view(h.symbol, len)});
+    for (std::uint32_t i = 0; i < h.orders; ++i) {
+      const CheckpointOrder& o = orders[i];
+      book.apply(AddEvent{.locate=locate, .order_id=o.order_id, .side=o.side, .qty=o.qty, .price=o.price,
+                          .mpid=o.mpid, .has_mpid=o.has_mpid != 0});
+    }
+    from = h.next_record;
+    st.checkpoint_ts = h.timestamp;
+    st.restored_orders = h.orders;
+  }
+
+  journal_->scan(locate, from, [&](std::uint64_t, const JournalRecord& r) {
+    if (r.timestamp > ts) return false;
+    visit_journal_event(r, [&](const auto& e) {
+      if constexpr (std::is_same_v<std::decay_t<decltype(e)>, StockDirectoryEvent>) known = true;
+      book.apply(e);
+    });
+    ++st.replayed_records;
+    return true;
+  });
+  if (stats) *stats = st;
+  return known;
+}
+
+} // namespace ob::io
@@ -0,0 +1,265 @@
+#include "ob/io/journal.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace ob::io {
+
+// ---------------- JournalWriter ----------------
+
+JournalWriter::~JournalWriter() {
+  close();
+}
+
+bool JournalWriter::open(const std::string& path, const JournalConfig& cfg) {
+  close();
+  if (cfg.block_records == 0) return false;
+  file_ = std::fopen(path.c_str(), "wb");
+  if (!file_) return false;
+  cfg_ = cfg;
+
+  // Placeholder header; close() rewrites it with the counts and index offset.
+  JournalFileHeader hdr{};
+  std::memcpy(hdr.magic, kJournalMagic, sizeof(hdr.magic));
+  hdr.version = kJournalVersion;
+  hdr.block_records = cfg_.block_records;
+  if (std::fwrite(&hdr, sizeof(hdr), 1, file_) != 1) {
+    std::fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+
+  records_ = 0;
+  block_ = 0;
+  write_failed_ = false;
+  buf_.clear();
+  buf_.reserve(cfg_.block_records);
+  blocks_by_locate_.assign(std::size_t{1} << 16, {});
+  return true;
+}
+
+bool JournalWriter::close() {
+  if (!file_) return true;
+  if (!buf_.empty() && !flush_block()) write_failed_ = true;
+
+  std::vector<JournalIndexEntry> index;
+  std::vector<std::uint32_t> ids;
+  for (std::size_t loc = 0; loc < blocks_by_locate_.size(); ++loc) {
+    const auto& blocks = blocks_by_locate_[loc];
+    if (blocks.empty()) continue;
+    index.push_back(JournalIndexEntry{static_cast<StockLocate>(loc), 0,
+                                      static_cast<std::uint32_t>(ids.size()),
+                                      static_cast<std::uint32_t>(blocks.size())});
+    ids.insert(ids.end(), blocks.begin(), blocks.end());
+  }
+
+  JournalFileHeader hdr{};
+  std::memcpy(hdr.magic, kJournalMagic, sizeof(hdr.magic));
+  hdr.version = kJournalVersion;
+  hdr.block_records = cfg_.block_records;
+  hdr.records = records_;
+  hdr.index_offset = sizeof(JournalFileHeader) + records_ * sizeof(JournalRecord);
+  hdr.index_locates = static_cast<std::uint32_t>(index.size());
+
+  bool ok = !write_failed_ &&
+            std::fwrite(index.data(), sizeof(JournalIndexEntry), index.size(), file_) == index.size() &&
+            std::fwrite(ids.data(), sizeof(std::uint32_t), ids.size(), file_) == ids.size() &&
+            std::fseek(file_, 0, SEEK_SET) == 0 &&
+            std::fwrite(&hdr, sizeof(hdr), 1, file_) == 1;
+  if (std::fclose(file_) != 0) ok = false;
+  file_ = nullptr;
+  blocks_by_locate_.clear();
+  return ok;
+}
+
+void JournalWriter::push(const JournalRecord& r) {
+  if (!file_) return;
+  auto& blocks = blocks_by_locate_[r.locate];
+  if (blocks.empty() || blocks.back() != block_) blocks.push_back(block_);
+  buf_.push_back(r);
+  ++records_;
+  if (buf_.size() == cfg_.block_records && !flush_block()) write_failed_ = true;
+}
+
+bool JournalWriter::flush_block() {
+  const bool ok = std::fwrite(buf_.data(), sizeof(JournalRecord), buf_.size(), file_) == buf_.size();
+  buf_.clear();
+  ++block_;
+  return ok;
+}
+
+void JournalWriter::append(std::uint64_t ts, const StockDirectoryEvent& e) {
+  JournalRecord r{};
+  r.timestamp = ts;
+  r.locate = e.locate;
+  r.kind = JournalKind::Directory;
+  char sym[sizeof(r.aux)];
+  std::memset(sym, ' ', sizeof(sym));
+  std::memcpy(sym, e.symbol.data(), std::min(e.symbol.size(), sizeof(sym)));
+  std::memcpy(&r.aux, sym, sizeof(sym));
+  push(r);
+}
+
+void JournalWriter::append(std::uint64_t ts, const AddEvent& e) {
+  JournalRecord r{};
+  r.timestamp = ts;
+  r.locate = e.locate;
+  r.kind = JournalKind::Add;
+  r.order_id = e.order_id;
+  r.price = e.price;
+  r.qty = e.qty;
+  r.aux = e.mpid;
+  r.flags = static_cast<std::uint8_t>((e.side == Side::Sell ? kJournalSell : 0) |
+                                      (e.has_mpid ? kJournalHasMpid : 0));
+  push(r);
+}
+
+void JournalWriter::append(std::uint64_t ts, const CancelEvent& e) {
+  JournalRecord r{};
+  r.timestamp = ts;
+  r.locate = e.locate;
+  r.kind = JournalKind::Cancel;
+  r.order_id = e.order_id;
+  r.qty = e.cancel_qty;
+  push(r);
+}
+
+void JournalWriter::append(std::uint64_t ts, const DeleteEvent& e) {
+  JournalRecord r{};
+  r.timestamp = ts;
+  r.locate = e.locate;
+  r.kind = JournalKind::Delete;
+  r.order_id = e.order_id;
+  push(r);
+}
+
+void JournalWriter::append(std::uint64_t ts, const ExecuteEvent& e) {
+  JournalRecord r{};
+  r.timestamp = ts;
+  r.locate = e.locate;
+  r.kind = JournalKind::Execute;
+  r.order_id = e.order_id;
+  r.qty = e.exec_qty;
+  r.price = e.price;
+  r.flags = static_cast<std::uint8_t>((e.has_price ? kJournalHasPrice : 0) |
+                                      (e.printable ? 0 : kJournalNonPrintable));
+  push(r);
+}
+
+void JournalWriter::append(std::uint64_t ts, const ReplaceEvent& e) {
+  JournalRecord r{};
+  r.timestamp = ts;
+  r.locate = e.locate;
+  r.kind = JournalKind::Replace;
+  r.order_id = e.old_order_id;
+  r.aux = e.new_order_id;
+  r.price = e.new_price;
+  r.qty = e.new_qty;
+  push(r);
+}
+
+void JournalWriter::append(std::uint64_t ts, const TradeEvent& e) {
+  JournalRecord r{};
+  r.timestamp = ts;
+  r.locate = e.locate;
+  r.kind = JournalKind::Trade;
+  r.order_id = e.order_id;
+  r.price = e.price;
+  r.qty = e.qty;
+  r.flags = e.side == Side::Sell ? kJournalSell : 0;
+  push(r);
+}
+
+// ---------------- JournalReader ----------------
+
+JournalReader::~JournalReader() {
+  close();
+}
+
+void JournalReader::close() {
+  if (data_) ::munmap(const_cast<std::uint8_t*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+  block_records_ = 1;
+  records_ = {};
+  index_ = {};
+  block_ids_ = {};
+}
+
+bool JournalReader::open(const std::string& path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st{};
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(JournalFileHeader)) {
+    ::close(fd);
+    return false;
+  }
+  void* m = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (m == MAP_FAILED) return false;
+  data_ = static_cast<const std::uint8_t*>(m);
+  size_ = static_cast<std::size_t>(st.st_size);
+  ::madvise(m, size_, MADV_SEQUENTIAL);
+
+  JournalFileHeader hdr;
+  std::memcpy(&hdr, data_, sizeof(hdr));
+  const std::size_t records_end = sizeof(hdr) + hdr.records * sizeof(JournalRecord);
+  const std::size_t index_end = hdr.index_offset + hdr.index_locates * sizeof(JournalIndexEntry);
+  // Version 1 journals read unchanged: they have no Trade records and no Execute flags.
+  if (std::memcmp(hdr.magic, kJournalMagic, sizeof(hdr.magic)) != 0 || hdr.version == 0 ||
+      hdr.version > kJournalVersion || hdr.block_records == 0 || hdr.index_offset != records_end ||
+      index_end > size_) {
+    close();
+    return false;
+  }
+  block_records_ = hdr.block_records;
+  records_ = {reinterpret_cast<const JournalRecord*>(data_ + sizeof(hdr)), hdr.records};
+  index_ = {reinterpret_cast<const JournalIndexEntry*>(data_ + hdr.index_offset), hdr.index_locates};
+  block_ids_ = {reinterpret_cast<const std::uint32_t*>(data_ + index_end),
+                (size_ - index_end) / sizeof(std::uint32_t)};
+  for (const JournalIndexEntry& e : index_) {
+    if (std::size_t{e.first} + e.count > block_ids_.size()) {
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+std::span<const JournalRecord> JournalReader::block(std::uint32_t id) const {
+  const std::size_t first = static_cast<std::size_t>(id) * block_records_;
+  if (first >= records_.size()) return {};
+  return records_.subspan(first, std::min<std::size_t>(block_records_, records_.size() - first));
+}
+
+std::span<const std::uint32_t> JournalReader::blocks_for(StockLocate locate) const {
+  // Entries are written in locate order.
+  auto it = std::lower_bound(index_.begin(), index_.end(), locate,
+                             [](const JournalIndexEntry& e, StockLocate l) { return e.locate < l; });
+  if (it == index_.end() || it->locate != locate) return {};
+  return block_ids_.subspan(it->first, it->count);
+}
+
+std::uint64_t JournalReader::replay(OrderBook& book) const {
+  std::uint64_t n = 0;
+  for_each([&](const JournalRecord& r) {
+    n += visit_journal_event(r, [&](const auto& e) { book.apply(e); }) ? 1 : 0;
+  });
+  return n;
+}
+
+std::uint64_t JournalReader::replay(OrderBook& book, StockLocate locate) const {
+  std::uint64_t n = 0;
+  for_each(locate, [&](const JournalRecord& r) {
+    n += visit_journal_event(r, [&](const auto& e) { book.apply(e); }) ? 1 : 0;
+  });
+  return n;
+}
+
+} // namespace ob::io
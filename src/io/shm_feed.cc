@@ -0,0 +1,338 @@
+#include "ob/io/shm_feed.hpp"
+#include "ob/symbol_book.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <new>
+
+namespace ob::io {
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "shared-memory feed requires lock-free 64-bit atomics");
+
+namespace {
+
+constexpr std::uint64_t kShmBusy = ~std::uint64_t{0};
+
+std::size_t segment_size(std::uint64_t ring_capacity, std::uint32_t max_locates) {
+  return sizeof(ShmFeedHeader) + ring_capacity * sizeof(ShmSlot) +
+         static_cast<std::size_t>(max_locates) * sizeof(ShmSymbolState);
+}
+
+std::uint64_t round_up_pow2(std::uint64_t v) {
+  std::uint64_t p = 1;
+  while (p < v) p <<= 1;
+  return p;
+}
+
+bool same_level(std::uint32_t n_a, const ShmLevel& a, std::uint32_t n_b, const ShmLevel& b) {
+  if (n_a == 0 || n_b == 0) return n_a == n_b;
+  return a.price == b.price && a.qty == b.qty && a.count == b.count;
+}
+
+} // namespace
+
+// ---------------- ShmPublisher ----------------
+
+ShmPublisher::~ShmPublisher() {
+  close();
+}
+
+bool ShmPublisher::create(const std::string& name, const ShmFeedConfig& cfg) {
+  close();
+  if (cfg.ring_capacity == 0 || cfg.max_locates == 0) return false;
+
+  const std::uint64_t cap = round_up_pow2(cfg.ring_capacity);
+  const std::size_t size = segment_size(cap, cfg.max_locates);
+
+  // Readers may still map a previous segment under this name: it is left intact,
+  // marked with the new epoch only once the new segment is ready.
+  ShmFeedHeader* old_hdr = nullptr;
+  std::uint64_t epoch = 1;
+  if (int old_fd = ::shm_open(name.c_str(), O_RDWR, 0); old_fd >= 0) {
+    struct stat st{};
+    if (::fstat(old_fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(ShmFeedHeader)) {
+      void* om = ::mmap(nullptr, sizeof(ShmFeedHeader), PROT_READ | PROT_WRITE, MAP_SHARED, old_fd, 0);
+      if (om != MAP_FAILED) {
+        old_hdr = static_cast<ShmFeedHeader*>(om);
+        if (old_hdr->magic == kShmFeedMagic && old_hdr->version == kShmFeedVersion) {
+          epoch = old_hdr->epoch.load(std::memory_order_relaxed) + 1;
+        }
+      }
+    }
+    ::close(old_fd);
+    ::shm_unlink(name.c_str());
+  }
+  auto release_old = [&](bool mark) {
+    if (!old_hdr) return;
+    if (mark && old_hdr->magic == kShmFeedMagic && old_hdr->version == kShmFeedVersion) {
+      old_hdr->epoch.store(epoch, std::memory_order_release);
+    }
+    ::munmap(old_hdr, sizeof(ShmFeedHeader));
+  };
+
+  int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    release_old(false);
+    return false;
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    ::close(fd);
+    ::shm_unlink(name.c_str());
+    release_old(false);
+    return false;
+  }
+  void* m = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (m == MAP_FAILED) {
+    ::shm_unlink(name.c_str());
+    release_old(false);
+    return false;
+  }
+
+  name_ = name;
+  base_ = m;
+  size_ = size;
+  auto* bytes = static_cast<std::uint8_t*>(m);
+  hdr_ = new (bytes) ShmFeedHeader{};
+  ring_ = reinterpret_cast<ShmSlot*>(bytes + sizeof(ShmFeedHeader));
+  table_ = reinterpret_cast<ShmSymbolState*>(bytes + sizeof(ShmFeedHeader) + cap * sizeof(ShmSlot));
+  for (std::uint64_t i = 0; i < cap; ++i) new (&ring_[i]) ShmSlot{};
+  for (std::uint32_t i = 0; i < cfg.max_locates; ++i) new (&table_[i]) ShmSymbolState{};
+
+  mask_ = cap - 1;
+  next_seq_ = 1;
+  hdr_->version = kShmFeedVersion;
+  hdr_->max_locates = cfg.max_locates;
+  hdr_->ring_capacity = cap;
+  hdr_->epoch.store(epoch, std::memory_order_relaxed);
+  hdr_->write_seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  hdr_->magic = kShmFeedMagic; // readers reject the segment until this is set
+  release_old(true);
+  return true;
+}
+
+void ShmPublisher::close(bool unlink) {
+  if (!base_) return;
+  ::munmap(base_, size_);
+  if (unlink) ::shm_unlink(name_.c_str());
+  base_ = nullptr;
+  size_ = 0;
+  hdr_ = nullptr;
+  ring_ = nullptr;
+  table_ = nullptr;
+}
+
+std::uint64_t ShmPublisher::publish(const ShmUpdate& rec) {
+  const std::uint64_t seq = next_seq_++;
+  ShmSlot& slot = ring_[seq & mask_];
+  slot.seq.store(kShmBusy, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.rec = rec;
+  slot.rec.seq = seq;
+  slot.seq.store(seq, std::memory_order_release);
+  hdr_->write_seq.store(seq, std::memory_order_release);
+  return seq;
+}
+
+void ShmPublisher::refresh_side(ShmSymbolSnapshot& snap, const SymbolBook& book, Side s) {
+  LevelView lv[kShmDepth];
+  std::size_t n = book.depth(s, lv, kShmDepth);
+  ShmLevel* out = (s == Side::Buy) ? snap.bids : snap.asks;
+  for (std::size_t i = 0; i < n; ++i) out[i] = ShmLevel{lv[i].price, lv[i].count, lv[i].qty};
+  for (std::size_t i = n; i < kShmDepth; ++i) out[i] = ShmLevel{};
+  if (s == Side::Buy) {
+    snap.bid_levels = static_cast<std::uint32_t>(n);
+  } else {
+    snap.ask_levels = static_cast<std::uint32_t>(n);
+  }
+}
+
+void ShmPublisher::on_level(const SymbolBook& book, const LevelUpdate& u) {
+  if (!hdr_) return;
+
+  ShmUpdate lvl{};
+  lvl.kind = ShmRecordKind::Level;
+  lvl.side = u.side;
+  lvl.locate = u.locate;
+  lvl.bid_price = u.price;
+  lvl.bid_count = u.count;
+  lvl.bid_qty = u.qty;
+  if (u.locate >= hdr_->max_locates) {
+    publish(lvl);
+    return;
+  }
+
+  // Only this thread writes the table, so it may read its own entries directly.
+  ShmSymbolState& st = table_[u.locate];
+  ShmSymbolSnapshot& snap = st.snap;
+  const bool buy = (u.side == Side::Buy);
+  const std::uint32_t n = buy ? snap.bid_levels : snap.ask_levels;
+  const ShmLevel* side_levels = buy ? snap.bids : snap.asks;
+  const bool in_window = n < kShmDepth ||
+                         (buy ? u.price >= side_levels[n - 1].price : u.price <= side_levels[n - 1].price);
+
+  const std::uint32_t old_bid_n = snap.bid_levels;
+  const std::uint32_t old_ask_n = snap.ask_levels;
+  const ShmLevel old_bid = snap.bids[0];
+  const ShmLevel old_ask = snap.asks[0];
+
+  // State is updated before the ring records go out, so a reader that resyncs to the
+  // live edge and then reads the table never misses a record.
+  const std::uint64_t v = st.version.load(std::memory_order_relaxed);
+  st.version.store(v + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  if (in_window) refresh_side(snap, book, u.side);
+  const bool bbo_changed = in_window &&
+      (!same_level(old_bid_n, old_bid, snap.bid_levels, snap.bids[0]) ||
+       !same_level(old_ask_n, old_ask, snap.ask_levels, snap.asks[0]));
+  snap.last_seq = next_seq_ + (bbo_changed ? 1 : 0);
+  st.version.store(v + 2, std::memory_order_release);
+
+  publish(lvl);
+  if (bbo_changed) {
+    ShmUpdate bbo{};
+    bbo.kind = ShmRecordKind::Bbo;
+    bbo.locate = u.locate;
+    if (snap.bid_levels) {
+      bbo.bid_price = snap.bids[0].price;
+      bbo.bid_count = snap.bids[0].count;
+      bbo.bid_qty = snap.bids[0].qty;
+    }
+    if (snap.ask_levels) {
+      bbo.ask_price = snap.asks[0].price;
+      bbo.ask_count = snap.asks[0].count;
+      bbo.ask_qty = snap.asks[0].qty;
+    }
+    publish(bbo);
+  }
+}
+
+void ShmPublisher::on_reset(const SymbolBook& book) {
+  if (!hdr_) return;
+  ShmUpdate bbo{};
+  bbo.kind = ShmRecordKind::Bbo;
+  bbo.locate = book.locate();
+  if (bbo.locate < hdr_->max_locates) {
+    ShmSymbolState& st = table_[bbo.locate];
+    const std::uint64_t v = st.version.load(std::memory_order_relaxed);
+    st.version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    st.snap = ShmSymbolSnapshot{};
+    st.snap.last_seq = next_seq_;
+    st.version.store(v + 2, std::memory_order_release);
+  }
+  publish(bbo);
+}
+
+// ---------------- ShmSubscriber ----------------
+
+ShmSubscriber::~ShmSubscriber() {
+  detach();
+}
+
+bool ShmSubscriber::attach(const std::string& name) {
+  detach();
+  if (!map_segment(name)) return false;
+  name_ = name;
+  overruns_ = 0;
+  resync();
+  return true;
+}
+
+bool ShmSubscriber::map_segment(const std::string& name) {
+  int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) return false;
+  struct stat st{};
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(ShmFeedHeader)) {
+    ::close(fd);
+    return false;
+  }
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* m = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (m == MAP_FAILED) return false;
+
+  const auto* hdr = static_cast<const ShmFeedHeader*>(m);
+  if (hdr->magic != kShmFeedMagic || hdr->version != kShmFeedVersion ||
+      segment_size(hdr->ring_capacity, hdr->max_locates) != size) {
+    ::munmap(m, size);
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  detach();
+  base_ = m;
+  size_ = size;
+  hdr_ = hdr;
+  const auto* bytes = static_cast<const std::uint8_t*>(m);
+  ring_ = reinterpret_cast<const ShmSlot*>(bytes + sizeof(ShmFeedHeader));
+  table_ = reinterpret_cast<const ShmSymbolState*>(bytes + sizeof(ShmFeedHeader) +
+                                                    hdr_->ring_capacity * sizeof(ShmSlot));
+  mask_ = hdr_->ring_capacity - 1;
+  epoch_ = hdr_->epoch.load(std::memory_order_acquire);
+  return true;
+}
+
+void ShmSubscriber::detach() {
+  if (base_) ::munmap(const_cast<void*>(base_), size_);
+  base_ = nullptr;
+  size_ = 0;
+  hdr_ = nullptr;
+  ring_ = nullptr;
+  table_ = nullptr;
+}
+
+void ShmSubscriber::resync() {
+  if (hdr_ && hdr_->epoch.load(std::memory_order_acquire) != epoch_) map_segment(name_);
+  if (hdr_) cursor_ = hdr_->write_seq.load(std::memory_order_acquire);
+}
+
+ShmSubscriber::Poll ShmSubscriber::poll(ShmUpdate* out) {
+  if (!hdr_ || !out) return Poll::Empty;
+  if (hdr_->epoch.load(std::memory_order_acquire) != epoch_) {
+    ++overruns_;
+    return Poll::Overrun;
+  }
+  const std::uint64_t w = hdr_->write_seq.load(std::memory_order_acquire);
+  if (w <= cursor_) return Poll::Empty;
+  const std::uint64_t want = cursor_ + 1;
+  if (w - cursor_ > hdr_->ring_capacity) {
+    ++overruns_;
+    return Poll::Overrun;
+  }
+
+  const ShmSlot& slot = ring_[want & mask_];
+  const std::uint64_t s1 = slot.seq.load(std::memory_order_acquire);
+  if (s1 != want) {
+    ++overruns_;
+    return Poll::Overrun;
+  }
+  *out = slot.rec;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot.seq.load(std::memory_order_relaxed) != s1) {
+    ++overruns_;
+    return Poll::Overrun;
+  }
+  cursor_ = want;
+  return Poll::Update;
+}
+
+bool ShmSubscriber::read_state(StockLocate locate, ShmSymbolSnapshot* out) const {
+  if (!hdr_ || !out || locate >= hdr_->max_locates) return false;
+  if (hdr_->epoch.load(std::memory_order_acquire) != epoch_) return false;
+  const ShmSymbolState& st = table_[locate];
+  for (int tries = 0; tries < kStateReadTries; ++tries) {
+    const std::uint64_t v1 = st.version.load(std::memory_order_acquire);
+    if (v1 & 1) continue;
+    *out = st.snap;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (st.version.load(std::memory_order_relaxed) == v1) return true;
+  }
+  return false;
+}
+
+} // namespace ob::io
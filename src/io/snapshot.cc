@@ -0,0 +1,313 @@
+#include "ob/io/snapshot.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace ob::io {
+
+namespace {
+
+constexpr std::size_t pad8(std::size_t n) { return (n + 7) & ~std::size_t{7}; }
+
+std::size_t data_payload_bytes(std::uint32_t rows, std::uint32_t depth) {
+  std::size_t levels = static_cast<std::size_t>(rows) * depth;
+  std::size_t side = pad8(levels * sizeof(Price)) + pad8(levels * sizeof(std::uint64_t)) +
+                     pad8(levels * sizeof(std::uint32_t));
+  return pad8(rows * sizeof(std::uint64_t)) + pad8(rows * sizeof(StockLocate)) + 2 * side;
+}
+
+constexpr std::size_t kSymbolEntryBytes = sizeof(StockLocate) + 8;
+
+} // namespace
+
+// ---------------- SnapshotWriter ----------------
+
+SnapshotWriter::~SnapshotWriter() {
+  close();
+}
+
+std::unique_ptr<SnapshotWriter::Block> SnapshotWriter::make_block() const {
+  auto b = std::make_unique<Block>();
+  std::size_t levels = static_cast<std::size_t>(cfg_.block_rows) * cfg_.depth;
+  b->timestamp.resize(cfg_.block_rows);
+  b->locate.resize(cfg_.block_rows);
+  b->bid_price.resize(levels);
+  b->bid_qty.resize(levels);
+  b->bid_count.resize(levels);
+  b->ask_price.resize(levels);
+  b->ask_qty.resize(levels);
+  b->ask_count.resize(levels);
+  return b;
+}
+
+bool SnapshotWriter::open(const std::string& path, const SnapshotConfig& cfg) {
+  close();
+  if (cfg.depth == 0 || cfg.interval_ns == 0 || cfg.block_rows == 0) return false;
+
+  file_ = std::fopen(path.c_str(), "wb");
+  if (!file_) return false;
+  cfg_ = cfg;
+
+  SnapshotFileHeader hdr{};
+  std::memcpy(hdr.magic, kSnapshotMagic, sizeof(hdr.magic));
+  hdr.version = kSnapshotVersion;
+  hdr.depth = cfg_.depth;
+  hdr.interval_ns = cfg_.interval_ns;
+  if (std::fwrite(&hdr, sizeof(hdr), 1, file_) != 1) {
+    std::fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+
+  next_sample_ = 0;
+  rows_ = samples_ = spare_allocs_ = 0;
+  scratch_.assign(cfg_.depth, LevelView{});
+  seen_locate_.assign(std::size_t{1} << 16, false);
+  symbols_.clear();
+  stop_ = false;
+  write_failed_ = false;
+  current_ = make_block();
+  spare_.push_back(make_block()); // double buffer
+  writer_ = std::thread([this] { writer_loop(); });
+  return true;
+}
+
+bool SnapshotWriter::close() {
+  if (!file_) return true;
+  if (current_ && current_->rows > 0) hand_off();
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  if (writer_.joinable()) writer_.join();
+
+  bool ok = !write_failed_ && write_symbols();
+  if (std::fclose(file_) != 0) ok = false;
+  file_ = nullptr;
+  current_.reset();
+  pending_.clear();
+  spare_.clear();
+  return ok;
+}
+
+void SnapshotWriter::sample(std::uint64_t ts, const OrderBook& book) {
+  if (!file_) return;
+  ++samples_;
+  const std::size_t depth = cfg_.depth;
+  for (StockLocate loc : book.locates()) {
+    const SymbolBook* sb = book.find(loc);
+    if (!seen_locate_[loc]) {
+      seen_locate_[loc] = true;
+      symbols_.emplace_back(loc, std::string(sb->symbol()));
+    }
+
+    Block& b = *current_;
+    const std::size_t row = b.rows;
+    b.timestamp[row] = ts;
+    b.locate[row] = loc;
+
+    std::size_t n = sb->depth(Side::Buy, scratch_.data(), depth);
+    for (std::size_t lvl = 0; lvl < depth; ++lvl) {
+      LevelView lv = (lvl < n) ? scratch_[lvl] : LevelView{};
+      std::size_t idx = lvl * cfg_.block_rows + row;
+      b.bid_price[idx] = lv.price;
+      b.bid_qty[idx] = lv.qty;
+      b.bid_count[idx] = lv.count;
+    }
+    n = sb->depth(Side::Sell, scratch_.data(), depth);
+    for (std::size_t lvl = 0; lvl < depth; ++lvl) {
+      LevelView lv = (lvl < n) ? scratch_[lvl] : LevelView{};
+      std::size_t idx = lvl * cfg_.block_rows + row;
+      b.ask_price[idx] = lv.price;
+      b.ask_qty[idx] = lv.qty;
+      b.ask_count[idx] = lv.count;
+    }
+
+    ++b.rows;
+    ++rows_;
+    if (b.rows == cfg_.block_rows) hand_off();
+  }
+}
+
+void SnapshotWriter::hand_off() {
+  std::unique_ptr<Block> next;
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    pending_.push_back(std::move(current_));
+    if (!spare_.empty()) {
+      next = std::move(spare_.back());
+      spare_.pop_back();
+    }
+  }
+  cv_.notify_one();
+  if (!next) {
+    // Writer is behind on both buffers; grow rather than stall the replay thread.
+    next = make_block();
+    ++spare_allocs_;
+  }
+  next->rows = 0;
+  current_ = std::move(next);
+}
+
+void SnapshotWriter::writer_loop() {
+  std::unique_lock<std::mutex> lk(mu_);
+  for (;;) {
+    cv_.wait(lk, [this] { return stop_ || !pending_.empty(); });
+    if (pending_.empty()) return; // stop_ and drained
+    std::unique_ptr<Block> b = std::move(pending_.front());
+    pending_.pop_front();
+    lk.unlock();
+    bool ok = write_block(*b);
+    lk.lock();
+    if (!ok) write_failed_ = true;
+    spare_.push_back(std::move(b));
+  }
+}
+
+bool SnapshotWriter::write_block(const Block& b) {
+  static const std::uint8_t zeros[8] = {};
+  const std::size_t rows = b.rows;
+  SnapshotChunkHeader ch{kSnapshotDataChunk, b.rows, data_payload_bytes(b.rows, cfg_.depth)};
+  if (std::fwrite(&ch, sizeof(ch), 1, file_) != 1) return false;
+
+  auto put = [&](const void* p, std::size_t bytes) -> bool {
+    return bytes == 0 || std::fwrite(p, 1, bytes, file_) == bytes;
+  };
+  auto pad = [&](std::size_t bytes) -> bool {
+    return put(zeros, pad8(bytes) - bytes);
+  };
+  // Per-level columns are stored with a block_rows stride; write only the used rows.
+  auto put_levels = [&](const auto& col) -> bool {
+    using T = typename std::decay_t<decltype(col)>::value_type;
+    for (std::size_t lvl = 0; lvl < cfg_.depth; ++lvl) {
+      if (!put(col.data() + lvl * cfg_.block_rows, rows * sizeof(T))) return false;
+    }
+    return pad(rows * cfg_.depth * sizeof(T));
+  };
+
+  return put(b.timestamp.data(), rows * sizeof(std::uint64_t)) &&
+         pad(rows * sizeof(std::uint64_t)) &&
+         put(b.locate.data(), rows * sizeof(StockLocate)) &&
+         pad(rows * sizeof(StockLocate)) &&
+         put_levels(b.bid_price) && put_levels(b.bid_qty) && put_levels(b.bid_count) &&
+         put_levels(b.ask_price) && put_levels(b.ask_qty) && put_levels(b.ask_count);
+}
+
+bool SnapshotWriter::write_symbols() {
+  if (symbols_.empty()) return true;
+  std::vector<std::uint8_t> payload(pad8(symbols_.size() * kSymbolEntryBytes), 0);
+  std::uint8_t* p = payload.data();
+  for (const auto& [loc, sym] : symbols_) {
+    std::memcpy(p, &loc, sizeof(loc));
+    std::memset(p + sizeof(loc), ' ', 8);
+    std::memcpy(p + sizeof(loc), sym.data(), std::min<std::size_t>(sym.size(), 8));
+    p += kSymbolEntryBytes;
+  }
+  SnapshotChunkHeader ch{kSnapshotSymbolChunk, static_cast<std::uint32_t>(symbols_.size()),
+                         payload.size()};
+  return std::fwrite(&ch, sizeof(ch), 1, file_) == 1 &&
+         std::fwrite(payload.data(), 1, payload.size(), file_) == payload.size();
+}
+
+// ---------------- SnapshotReader ----------------
+
+SnapshotReader::~SnapshotReader() {
+  close();
+}
+
+void SnapshotReader::close() {
+  if (data_) ::munmap(const_cast<std::uint8_t*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+  rows_ = 0;
+  blocks_.clear();
+  symbols_.clear();
+}
+
+bool SnapshotReader::open(const std::string& path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st{};
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(SnapshotFileHeader)) {
+    ::close(fd);
+    return false;
+  }
+  void* m = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (m == MAP_FAILED) return false;
+  data_ = static_cast<const std::uint8_t*>(m);
+  size_ = static_cast<std::size_t>(st.st_size);
+
+  SnapshotFileHeader hdr;
+  std::memcpy(&hdr, data_, sizeof(hdr));
+  if (std::memcmp(hdr.magic, kSnapshotMagic, sizeof(hdr.magic)) != 0 ||
+      hdr.version != kSnapshotVersion || hdr.depth == 0) {
+    close();
+    return false;
+  }
+  depth_ = hdr.depth;
+  interval_ns_ = hdr.interval_ns;
+
+  std::size_t off = sizeof(hdr);
+  while (off + sizeof(SnapshotChunkHeader) <= size_) {
+    SnapshotChunkHeader ch;
+    std::memcpy(&ch, data_ + off, sizeof(ch));
+    off += sizeof(ch);
+    if (ch.payload_bytes > size_ - off) break; // truncated tail
+    const std::uint8_t* p = data_ + off;
+
+    if (ch.tag == kSnapshotDataChunk) {
+      if (ch.payload_bytes != data_payload_bytes(ch.rows, depth_)) break;
+      const std::size_t rows = ch.rows;
+      const std::size_t levels = rows * depth_;
+      SnapshotBlock b;
+      b.rows = ch.rows;
+      b.timestamp = reinterpret_cast<const std::uint64_t*>(p);
+      p += pad8(rows * sizeof(std::uint64_t));
+      b.locate = reinterpret_cast<const StockLocate*>(p);
+      p += pad8(rows * sizeof(StockLocate));
+      b.bid_price = reinterpret_cast<const Price*>(p);
+      p += pad8(levels * sizeof(Price));
+      b.bid_qty = reinterpret_cast<const std::uint64_t*>(p);
+      p += pad8(levels * sizeof(std::uint64_t));
+      b.bid_count = reinterpret_cast<const std::uint32_t*>(p);
+      p += pad8(levels * sizeof(std::uint32_t));
+      b.ask_price = reinterpret_cast<const Price*>(p);
+      p += pad8(levels * sizeof(Price));
+      b.ask_qty = reinterpret_cast<const std::uint64_t*>(p);
+      p += pad8(levels * sizeof(std::uint64_t));
+      b.ask_count = reinterpret_cast<const std::uint32_t*>(p);
+      blocks_.push_back(b);
+      rows_ += rows;
+    } else if (ch.tag == kSnapshotSymbolChunk) {
+      if (ch.rows * kSymbolEntryBytes > ch.payload_bytes) break;
+      for (std::uint32_t i = 0; i < ch.rows; ++i, p += kSymbolEntryBytes) {
+        StockLocate loc;
+        std::memcpy(&loc, p, sizeof(loc));
+        const char* s = reinterpret_cast<const char*>(p + sizeof(loc));
+        std::size_t len = 8;
+        while (len > 0 && s[len - 1] == ' ') --len;
+        symbols_.emplace_back(loc, std::string_view(s, len));
+      }
+    }
+    off += ch.payload_bytes;
+  }
+  return true;
+}
+
+std::string_view SnapshotReader::symbol(StockLocate locate) const {
+  for (const auto& [loc, sym] : symbols_) {
+    if (loc == locate) return sym;
+  }
+  return {};
+}
+
+} // namespace ob::io
@@ -1,14 +1,35 @@
+#include "ob/backtest.hpp"
+#include "ob/features.hpp"
+#include "ob/ingest/batch.hpp"
+#include "ob/ingest/framing.hpp"
 #include "ob/ingest/itch.hpp"
+#include "ob/ingest/pipeline.hpp"
 #include "ob/ingest/soupbin.hpp"
+#include "ob/integrity.hpp"
+#include "ob/io/capture.hpp"
+#include "ob/io/checkpoint.hpp"
+#include "ob/io/journal.hpp"
+#include "ob/io/shm_feed.hpp"
+#include "ob/io/snapshot.hpp"
+#include "ob/order_book.hpp"
+#include "ob/trade_bars.hpp"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cctype>
 #include <cstdint>
 #include <cstdlib>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <span>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -25,6 +46,49 @@ struct Options {
   std::size_t frames{5};
   bool no_login{false};
   bool verbose{false};
+  std::string snapshot_out;
+  std::uint64_t snapshot_interval_ms{100};
+  std::uint32_t snapshot_depth{5};
+  std::string shm_publish;
+  std::string capacity_in;
+  std::string capacity_out;
+  std::string journal_out;
+  std::string journal;
+  int journal_locate{-1}; // -1: every symbol
+  std::string checkpoint_out;
+  std::uint64_t checkpoint_interval_ms{60'000};
+  std::string checkpoints;
+  std::string as_of;
+  std::vector<std::string> batch; // globs or @list files
+  unsigned threads{0};
+  std::uint64_t memory_budget_mb{0};
+  bool pipeline{false};
+  ob::ingest::PipelineConfig pipeline_cfg;
+  std::uint64_t stats_interval_ms{0};
+  std::string capture_out;
+  std::uint64_t capture_roll_mb{1024};
+  bool capture_direct{false};
+  bool replay_timing{false};
+  std::string types;   // ITCH type letters to keep, e.g. "RADXEU"
+  std::string locates; // "1,5,10-20"
+  std::string symbols; // "AAPL,MSFT"
+  ob::ingest::ItchFilter filter; // built from the three above by build_filter()
+  std::uint32_t check_every{0};   // IntegrityChecker slice interval; 0: off
+  double check_max_overhead{0.01};
+  std::string bars_out;
+  std::string bar_seconds{"1,60"}; // TradeBars periods
+  std::string features_out;
+  std::uint64_t features_interval_ms{1000};
+  std::uint32_t feature_depth{5};
+  std::string memory_out;              // per-symbol footprint CSV at close
+  std::uint64_t trim_interval_ms{0};   // idle-symbol compaction interval, feed time; 0: off
+  double trim_live_fraction{0.125};
+  std::string framing{"auto"};         // auto, raw, length, soupbin
+  ob::ingest::ItchFraming framing_mode{ob::ingest::ItchFraming::Auto}; // parsed from framing
+  std::uint32_t backtest_join{0};      // JoinTouch quote size; 0: no backtest
+  std::uint64_t backtest_latency_us{0};
+  std::string hash_out;                // state-hash checkpoints CSV
+  std::uint64_t hash_every{0};         // events between checkpoints; 0: close only
 };
 
 std::string trim_ws(std::string_view in) {
@@ -72,6 +136,53 @@ void apply_env_value(Options* opt, const std::string& key, const std::string& va
   else if (key == "OB_FRAMES" && !value.empty()) opt->frames = static_cast<std::size_t>(std::stoull(value));
   else if (key == "OB_NO_LOGIN") opt->no_login = parse_bool(value);
   else if (key == "OB_VERBOSE") opt->verbose = parse_bool(value);
+  else if (key == "OB_SNAPSHOT_OUT") opt->snapshot_out = value;
+  else if (key == "OB_SNAPSHOT_INTERVAL_MS" && !value.empty()) opt->snapshot_interval_ms = std::stoull(value);
+  else if (key == "OB_SNAPSHOT_DEPTH" && !value.empty()) opt->snapshot_depth = static_cast<std::uint32_t>(std::stoul(value));
+  else if (key == "OB_SHM_PUBLISH") opt->shm_publish = value;
+  else if (key == "OB_CAPACITY_IN") opt->capacity_in = value;
+  else if (key == "OB_CAPACITY_OUT") opt->capacity_out = value;
+  else if (key == "OB_JOURNAL_OUT") opt->journal_out = value;
+  else if (key == "OB_JOURNAL") opt->journal = value;
+  else if (key == "OB_JOURNAL_LOCATE" && !value.empty()) opt->journal_locate = std::stoi(value);
+  else if (key == "OB_CHECKPOINT_OUT") opt->checkpoint_out = value;
+  else if (key == "OB_CHECKPOINT_INTERVAL_MS" && !value.empty()) opt->checkpoint_interval_ms = std::stoull(value);
+  else if (key == "OB_CHECKPOINTS") opt->checkpoints = value;
+  else if (key == "OB_BATCH") {
+    std::istringstream in(value);
+    opt->batch.clear();
+    for (std::string item; in >> item;) opt->batch.push_back(item);
+  }
+  else if (key == "OB_THREADS" && !value.empty()) opt->threads = static_cast<unsigned>(std::stoul(value));
+  else if (key == "OB_MEMORY_BUDGET_MB" && !value.empty()) opt->memory_budget_mb = std::stoull(value);
+  else if (key == "OB_PIPELINE") opt->pipeline = parse_bool(value);
+  else if (key == "OB_CPU_RECV" && !value.empty()) opt->pipeline_cfg.recv_cpu = std::stoi(value);
+  else if (key == "OB_CPU_DECODE" && !value.empty()) opt->pipeline_cfg.decode_cpu = std::stoi(value);
+  else if (key == "OB_CPU_BOOK" && !value.empty()) opt->pipeline_cfg.book_cpu = std::stoi(value);
+  else if (key == "OB_RING_EVENTS" && !value.empty()) opt->pipeline_cfg.event_ring = std::stoull(value);
+  else if (key == "OB_STATS_INTERVAL_MS" && !value.empty()) opt->stats_interval_ms = std::stoull(value);
+  else if (key == "OB_CAPTURE_OUT") opt->capture_out = value;
+  else if (key == "OB_CAPTURE_ROLL_MB" && !value.empty()) opt->capture_roll_mb = std::stoull(value);
+  else if (key == "OB_CAPTURE_DIRECT") opt->capture_direct = parse_bool(value);
+  else if (key == "OB_REPLAY_TIMING") opt->replay_timing = parse_bool(value);
+  else if (key == "OB_TYPES") opt->types = value;
+  else if (key == "OB_LOCATES") opt->locates = value;
+  else if (key == "OB_SYMBOLS") opt->symbols = value;
+  else if (key == "OB_CHECK_EVERY" && !value.empty()) opt->check_every = static_cast<std::uint32_t>(std::stoul(value));
+  else if (key == "OB_CHECK_MAX_OVERHEAD" && !value.empty()) opt->check_max_overhead = std::stod(value);
+  else if (key == "OB_BARS_OUT") opt->bars_out = value;
+  else if (key == "OB_BAR_SECONDS" && !value.empty()) opt->bar_seconds = value;
+  else if (key == "OB_FEATURES_OUT") opt->features_out = value;
+  else if (key == "OB_FEATURES_INTERVAL_MS" && !value.empty()) opt->features_interval_ms = std::stoull(value);
+  else if (key == "OB_FEATURE_DEPTH" && !value.empty()) opt->feature_depth = static_cast<std::uint32_t>(std::stoul(value));
+  else if (key == "OB_MEMORY_OUT") opt->memory_out = value;
+  else if (key == "OB_FRAMING" && !value.empty()) opt->framing = value;
+  else if (key == "OB_BACKTEST_JOIN" && !value.empty()) opt->backtest_join = static_cast<std::uint32_t>(std::stoul(value));
+  else if (key == "OB_BACKTEST_LATENCY_US" && !value.empty()) opt->backtest_latency_us = std::stoull(value);
+  else if (key == "OB_TRIM_INTERVAL_MS" && !value.empty()) opt->trim_interval_ms = std::stoull(value);
+  else if (key == "OB_TRIM_LIVE_FRACTION" && !value.empty()) opt->trim_live_fraction = std::stod(value);
+  else if (key == "OB_HASH_OUT") opt->hash_out = value;
+  else if (key == "OB_HASH_EVERY" && !value.empty()) opt->hash_every = std::stoull(value);
 }
 
 void load_env_defaults(Options* opt) {
@@ -81,7 +192,17 @@ void load_env_defaults(Options* opt) {
 
   const char* keys[] = {
     "OB_HOST", "OB_PORT", "OB_USER", "OB_PASS", "OB_SESSION",
-    "OB_SEQ", "OB_FRAMES", "OB_NO_LOGIN", "OB_VERBOSE", "OB_ITCH_FILE"
+    "OB_SEQ", "OB_FRAMES", "OB_NO_LOGIN", "OB_VERBOSE", "OB_ITCH_FILE",
+    "OB_SNAPSHOT_OUT", "OB_SNAPSHOT_INTERVAL_MS", "OB_SNAPSHOT_DEPTH", "OB_SHM_PUBLISH",
+    "OB_CAPACITY_IN", "OB_CAPACITY_OUT", "OB_JOURNAL_OUT", "OB_JOURNAL", "OB_JOURNAL_LOCATE",
+    "OB_CHECKPOINT_OUT", "OB_CHECKPOINT_INTERVAL_MS", "OB_CHECKPOINTS",
+    "OB_BATCH", "OB_THREADS", "OB_MEMORY_BUDGET_MB",
+    "OB_PIPELINE", "OB_CPU_RECV", "OB_CPU_DECODE", "OB_CPU_BOOK", "OB_RING_EVENTS", "OB_STATS_INTERVAL_MS",
+    "OB_CAPTURE_OUT", "OB_CAPTURE_ROLL_MB", "OB_CAPTURE_DIRECT", "OB_REPLAY_TIMING",
+    "OB_TYPES", "OB_LOCATES", "OB_SYMBOLS", "OB_CHECK_EVERY", "OB_CHECK_MAX_OVERHEAD",
+    "OB_BARS_OUT", "OB_BAR_SECONDS", "OB_FEATURES_OUT", "OB_FEATURES_INTERVAL_MS", "OB_FEATURE_DEPTH",
+    "OB_MEMORY_OUT", "OB_TRIM_INTERVAL_MS", "OB_TRIM_LIVE_FRACTION", "OB_BACKTEST_JOIN", "OB_BACKTEST_LATENCY_US",
+    "OB_FRAMING", "OB_HASH_OUT", "OB_HASH_EVERY"
   };
   for (const char* key : keys) {
     const char* val = std::getenv(key);
@@ -94,9 +215,34 @@ void print_usage(std::string_view prog) {
     << "Usage:\n"
     << "  " << prog << " --host HOST --port PORT --user USER --pass PASS --session SESSION [--seq N] [--frames N]\n"
     << "  " << prog << " --host HOST --port PORT --no-login [--frames N]\n"
-    << "  " << prog << " --file PATH\n"
+    << "  " << prog << " --file PATH [--snapshot-out PATH [--snapshot-interval-ms N] [--snapshot-depth N]]\n"
+    << "      [--shm-publish NAME] [--capacity-in PATH] [--capacity-out PATH] [--journal-out PATH]\n"
+    << "      [--check-every N [--check-max-overhead FRACTION]] [--bars-out PATH [--bar-seconds 1,60]]\n"
+    << "      [--features-out PATH [--features-interval-ms N] [--feature-depth K]]\n"
+    << "      [--memory-out PATH] [--trim-interval-ms N [--trim-live-fraction F]]\n"
+    << "      [--backtest-join QTY [--backtest-latency-us N]] [--hash-out PATH [--hash-every N]]\n"
+    << "  " << prog << " --journal PATH [--journal-locate N] [same outputs as --file]\n"
+    << "      [--checkpoint-out PATH [--checkpoint-interval-ms N]]\n"
+    << "  " << prog << " --journal PATH --checkpoints PATH --journal-locate N --as-of HH:MM:SS[.fraction]|NANOS\n"
+    << "  " << prog << " --batch GLOB|@LIST [--batch ...] [--threads N] [--memory-budget-mb N]\n"
+    << "  Live and --file modes: [--pipeline [--cpu-recv N] [--cpu-decode N] [--cpu-book N] [--ring-events N]\n"
+    << "      [--stats-interval-ms N]]  (live pipeline: --frames 0 reads until disconnect)\n"
+    << "  Live mode: [--capture-out PATH [--capture-roll-mb N] [--capture-direct]]\n"
+    << "  --file also reads --capture-out files (and their rolled parts): [--replay-timing]\n"
+    << "  Decode filter (--file, --batch, --pipeline): [--types LETTERS] [--locates 1,5,10-20] [--symbols AAPL,MSFT]\n"
+    << "  Input framing (--file, --batch): [--framing auto|raw|length|soupbin]\n"
     << "\n"
-    << "Env (.env or environment): OB_HOST, OB_PORT, OB_USER, OB_PASS, OB_SESSION, OB_SEQ, OB_FRAMES, OB_NO_LOGIN, OB_VERBOSE, OB_ITCH_FILE\n";
+    << "Env (.env or environment): OB_HOST, OB_PORT, OB_USER, OB_PASS, OB_SESSION, OB_SEQ, OB_FRAMES, OB_NO_LOGIN, OB_VERBOSE, OB_ITCH_FILE,\n"
+    << "  OB_SNAPSHOT_OUT, OB_SNAPSHOT_INTERVAL_MS, OB_SNAPSHOT_DEPTH, OB_SHM_PUBLISH,\n"
+    << "  OB_CAPACITY_IN, OB_CAPACITY_OUT, OB_JOURNAL_OUT, OB_JOURNAL, OB_JOURNAL_LOCATE,\n"
+    << "  OB_CHECKPOINT_OUT, OB_CHECKPOINT_INTERVAL_MS, OB_CHECKPOINTS,\n"
+    << "  OB_BATCH (space separated), OB_THREADS, OB_MEMORY_BUDGET_MB,\n"
+    << "  OB_PIPELINE, OB_CPU_RECV, OB_CPU_DECODE, OB_CPU_BOOK, OB_RING_EVENTS, OB_STATS_INTERVAL_MS,\n"
+    << "  OB_CAPTURE_OUT, OB_CAPTURE_ROLL_MB, OB_CAPTURE_DIRECT, OB_REPLAY_TIMING,\n"
+    << "  OB_TYPES, OB_LOCATES, OB_SYMBOLS, OB_CHECK_EVERY, OB_CHECK_MAX_OVERHEAD, OB_BARS_OUT, OB_BAR_SECONDS,\n"
+    << "  OB_FEATURES_OUT, OB_FEATURES_INTERVAL_MS, OB_FEATURE_DEPTH,\n"
+    << "  OB_MEMORY_OUT, OB_TRIM_INTERVAL_MS, OB_TRIM_LIVE_FRACTION, OB_BACKTEST_JOIN, OB_BACKTEST_LATENCY_US,\n"
+    << "  OB_FRAMING, OB_HASH_OUT, OB_HASH_EVERY\n";
 }
 
 bool parse_args(int argc, char** argv, Options* out) {
@@ -127,6 +273,94 @@ bool parse_args(int argc, char** argv, Options* out) {
       out->file = require_value(arg);
     } else if (arg == "--frames") {
       out->frames = static_cast<std::size_t>(std::stoull(require_value(arg)));
+    } else if (arg == "--snapshot-out") {
+      out->snapshot_out = require_value(arg);
+    } else if (arg == "--snapshot-interval-ms") {
+      out->snapshot_interval_ms = std::stoull(require_value(arg));
+    } else if (arg == "--snapshot-depth") {
+      out->snapshot_depth = static_cast<std::uint32_t>(std::stoul(require_value(arg)));
+    } else if (arg == "--shm-publish") {
+      out->shm_publish = require_value(arg);
+    } else if (arg == "--capacity-in") {
+      out->capacity_in = require_value(arg);
+    } else if (arg == "--capacity-out") {
+      out->capacity_out = require_value(arg);
+    } else if (arg == "--journal-out") {
+      out->journal_out = require_value(arg);
+    } else if (arg == "--journal") {
+      out->journal = require_value(arg);
+    } else if (arg == "--journal-locate") {
+      out->journal_locate = std::stoi(require_value(arg));
+    } else if (arg == "--checkpoint-out") {
+      out->checkpoint_out = require_value(arg);
+    } else if (arg == "--checkpoint-interval-ms") {
+      out->checkpoint_interval_ms = std::stoull(require_value(arg));
+    } else if (arg == "--checkpoints") {
+      out->checkpoints = require_value(arg);
+    } else if (arg == "--as-of") {
+      out->as_of = require_value(arg);
+    } else if (arg == "--batch") {
+      out->batch.push_back(require_value(arg));
+    } else if (arg == "--threads") {
+      out->threads = static_cast<unsigned>(std::stoul(require_value(arg)));
+    } else if (arg == "--memory-budget-mb") {
+      out->memory_budget_mb = std::stoull(require_value(arg));
+    } else if (arg == "--pipeline") {
+      out->pipeline = true;
+    } else if (arg == "--cpu-recv") {
+      out->pipeline_cfg.recv_cpu = std::stoi(require_value(arg));
+    } else if (arg == "--cpu-decode") {
+      out->pipeline_cfg.decode_cpu = std::stoi(require_value(arg));
+    } else if (arg == "--cpu-book") {
+      out->pipeline_cfg.book_cpu = std::stoi(require_value(arg));
+    } else if (arg == "--ring-events") {
+      out->pipeline_cfg.event_ring = std::stoull(require_value(arg));
+    } else if (arg == "--stats-interval-ms") {
+      out->stats_interval_ms = std::stoull(require_value(arg));
+    } else if (arg == "--capture-out") {
+      out->capture_out = require_value(arg);
+    } else if (arg == "--capture-roll-mb") {
+      out->capture_roll_mb = std::stoull(require_value(arg));
+    } else if (arg == "--capture-direct") {
+      out->capture_direct = true;
+    } else if (arg == "--replay-timing") {
+      out->replay_timing = true;
+    } else if (arg == "--types") {
+      out->types = require_value(arg);
+    } else if (arg == "--locates") {
+      out->locates = require_value(arg);
+    } else if (arg == "--symbols") {
+      out->symbols = require_value(arg);
+    } else if (arg == "--framing") {
+      out->framing = require_value(arg);
+    } else if (arg == "--backtest-join") {
+      out->backtest_join = static_cast<std::uint32_t>(std::stoul(require_value(arg)));
+    } else if (arg == "--backtest-latency-us") {
+      out->backtest_latency_us = std::stoull(require_value(arg));
+    } else if (arg == "--hash-out") {
+      out->hash_out = require_value(arg);
+    } else if (arg == "--hash-every") {
+      out->hash_every = std::stoull(require_value(arg));
+    } else if (arg == "--memory-out") {
+      out->memory_out = require_value(arg);
+    } else if (arg == "--trim-interval-ms") {
+      out->trim_interval_ms = std::stoull(require_value(arg));
+    } else if (arg == "--trim-live-fraction") {
+      out->trim_live_fraction = std::stod(require_value(arg));
+    } else if (arg == "--features-out") {
+      out->features_out = require_value(arg);
+    } else if (arg == "--features-interval-ms") {
+      out->features_interval_ms = std::stoull(require_value(arg));
+    } else if (arg == "--feature-depth") {
+      out->feature_depth = static_cast<std::uint32_t>(std::stoul(require_value(arg)));
+    } else if (arg == "--bars-out") {
+      out->bars_out = require_value(arg);
+    } else if (arg == "--bar-seconds") {
+      out->bar_seconds = require_value(arg);
+    } else if (arg == "--check-every") {
+      out->check_every = static_cast<std::uint32_t>(std::stoul(require_value(arg)));
+    } else if (arg == "--check-max-overhead") {
+      out->check_max_overhead = std::stod(require_value(arg));
     } else if (arg == "--no-login") {
       out->no_login = true;
     } else if (arg == "--verbose") {
@@ -141,6 +375,69 @@ bool parse_args(int argc, char** argv, Options* out) {
   return true;
 }
 
+// Fills opt->filter from --types, --locates and --symbols.
+bool build_filter(Options* opt) {
+  for (char c : opt->types) {
+    if (c == ',' || c == ' ') continue;
+    if (ob::ingest::itch_message_size(c) == 0) {
+      std::cerr << "Unknown ITCH message type in --types: " << c << "\n";
+      return false;
+    }
+    opt->filter.allow_type(c);
+  }
+  std::istringstream locates(opt->locates);
+  for (std::string item; std::getline(locates, item, ',');) {
+    item = trim_ws(item);
+    if (item.empty()) continue;
+    const auto dash = item.find('-');
+    char* end = nullptr;
+    const unsigned long lo = std::strtoul(item.c_str(), &end, 10);
+    const unsigned long hi = dash == std::string::npos ? lo : std::strtoul(item.c_str() + dash + 1, &end, 10);
+    if (*end != '\0' || lo > hi || hi > 0xFFFF) {
+      std::cerr << "Bad --locates entry: " << item << "\n";
+      return false;
+    }
+    for (unsigned long l = lo; l <= hi; ++l) opt->filter.allow_locate(static_cast<ob::StockLocate>(l));
+  }
+  std::istringstream symbols(opt->symbols);
+  for (std::string item; std::getline(symbols, item, ',');) {
+    item = trim_ws(item);
+    if (!item.empty()) opt->filter.allow_symbol(item);
+  }
+  opt->pipeline_cfg.filter = opt->filter;
+  return true;
+}
+
+void print_filter_stats(const ob::ingest::ItchFilterStats& st) {
+  std::cout << "filter: " << st.passed << " passed, " << st.skipped_type << " skipped by type, "
+            << st.skipped_locate << " skipped by locate (" << (st.skipped_bytes >> 10) << " KiB), "
+            << st.learned_locates << " locates learned from symbols\n";
+}
+
+// "HH:MM:SS[.fraction]" or plain nanoseconds since midnight.
+bool parse_time_of_day(std::string_view in, std::uint64_t* out) {
+  auto digits = [](std::string_view d, std::uint64_t* v) {
+    if (d.empty()) return false;
+    *v = 0;
+    for (char c : d) {
+      if (c < '0' || c > '9') return false;
+      *v = *v * 10 + static_cast<std::uint64_t>(c - '0');
+    }
+    return true;
+  };
+  if (in.find(':') == std::string_view::npos) return digits(in, out);
+  if (in.size() < 8 || in[2] != ':' || in[5] != ':') return false;
+  std::uint64_t h, m, sec, frac = 0;
+  if (!digits(in.substr(0, 2), &h) || !digits(in.substr(3, 2), &m) || !digits(in.substr(6, 2), &sec)) return false;
+  if (in.size() > 8) {
+    std::string_view f = in.substr(9);
+    if (in[8] != '.' || f.size() > 9 || !digits(f, &frac)) return false;
+    for (std::size_t i = f.size(); i < 9; ++i) frac *= 10;
+  }
+  *out = ((h * 60 + m) * 60 + sec) * 1'000'000'000ULL + frac;
+  return true;
+}
+
 void dump_counts(const std::array<std::size_t, 256>& counts) {
   for (std::size_t i = 0; i < counts.size(); ++i) {
     if (counts[i] == 0) continue;
@@ -149,36 +446,700 @@ void dump_counts(const std::array<std::size_t, 256>& counts) {
   }
 }
 
+// Reference strategy for --backtest-join: quotes qty shares at the best bid and the
+// best ask of every symbol, and re-joins when a quote fills or the touch moves away.
+struct JoinTouch final : ob::Strategy {
+  struct Quote {
+    ob::ShadowId id{};
+    ob::Price price{};
+    bool cancelling{false};
+  };
+
+  ob::Qty qty{};
+  std::vector<std::array<Quote, 2>> quotes = std::vector<std::array<Quote, 2>>(std::size_t{1} << 16);
+  std::int64_t position{0}; // shares
+  double cash{0};           // price units
+
+  void on_book(ob::Backtester& bt, const ob::SymbolBook& book, const ob::LevelUpdate&) override {
+    const ob::TopOfBook t = book.top();
+    for (int s = 0; s < 2; ++s) {
+      const bool has = s == 0 ? t.has_bid : t.has_ask;
+      if (!has) continue;
+      const ob::Price best = s == 0 ? t.bid.price : t.ask.price;
+      Quote& q = quotes[book.locate()][s];
+      if (q.id == 0) {
+        q.id = bt.submit(book.locate(), s == 0 ? ob::Side::Buy : ob::Side::Sell, best, qty);
+        q.price = best;
+      } else if (!q.cancelling && q.price != best && bt.find(q.id)->working) {
+        q.cancelling = bt.cancel(q.id);
+      }
+    }
+  }
+
+  void on_fill(ob::Backtester&, const ob::ShadowFill& f) override {
+    const std::int64_t signed_qty = f.side == ob::Side::Buy ? f.qty : -static_cast<std::int64_t>(f.qty);
+    position += signed_qty;
+    cash -= static_cast<double>(signed_qty) * f.price;
+    Quote& q = quotes[f.locate][f.side == ob::Side::Buy ? 0 : 1];
+    if (f.leaves == 0 && q.id == f.id) q = Quote{};
+  }
+
+  void on_cancelled(ob::Backtester&, const ob::ShadowOrder& o) override {
+    Quote& q = quotes[o.locate][o.side == ob::Side::Buy ? 0 : 1];
+    if (q.id == o.id) q = Quote{};
+  }
+};
+
+// Book plus the optional consumers of a replay (capacity profile, shm feed, snapshots,
+// integrity checks).
+struct Replay {
+  static constexpr std::size_t kTrimSymbolsPerStep = 1024;
+
+  ob::OrderBook book;
+  ob::io::ShmPublisher publisher;
+  ob::io::SnapshotWriter writer;
+  ob::IntegrityChecker checker;
+  ob::TradeBars bars;
+  std::ofstream bars_file;
+  ob::FeatureEngine features;
+  std::ofstream features_file;
+  JoinTouch join;
+  std::unique_ptr<ob::Backtester> backtest;
+  std::vector<ob::FeatureRow> feature_rows;
+  std::uint64_t features_interval_ns{0};
+  std::uint64_t next_features_ns{0};
+  ob::TrimPolicy trim_policy;
+  ob::TrimStats trim_totals;
+  std::uint64_t trim_interval_ns{0};
+  std::uint64_t next_trim_ns{0};
+  std::ofstream hash_file;
+  std::uint64_t hash_every{0};
+  std::uint64_t events{0};
+  std::uint64_t last_ts{0};
+  bool snapshot{false};
+  bool checking{false};
+  bool barring{false};
+  bool featuring{false};
+  bool trimming{false};
+  bool backtesting{false};
+  bool hashing{false};
+  bool enabled{false}; // any consumer wants the book built
+
+  bool open(const Options& opt) {
+    snapshot = !opt.snapshot_out.empty();
+    checking = opt.check_every > 0;
+    barring = !opt.bars_out.empty();
+    featuring = !opt.features_out.empty();
+    trimming = opt.trim_interval_ms > 0;
+    backtesting = opt.backtest_join > 0;
+    hashing = !opt.hash_out.empty();
+    enabled = snapshot || checking || barring || featuring || trimming || backtesting || hashing ||
+              !opt.shm_publish.empty() || !opt.capacity_out.empty() || !opt.memory_out.empty();
+    trim_policy.live_fraction = opt.trim_live_fraction;
+    trim_interval_ns = opt.trim_interval_ms * 1'000'000;
+    if (!opt.capacity_in.empty()) {
+      ob::CapacityProfile profile;
+      if (!profile.load(opt.capacity_in)) {
+        std::cerr << "Failed to load capacity profile: " << opt.capacity_in << "\n";
+        return false;
+      }
+      book.set_capacity_profile(std::move(profile));
+    }
+    if (hashing) {
+      hash_file.open(opt.hash_out);
+      if (!hash_file) {
+        std::cerr << "Failed to open hash output: " << opt.hash_out << "\n";
+        return false;
+      }
+      hash_file << "events,ts,state_hash\n";
+      hash_every = opt.hash_every;
+    }
+    if (!opt.shm_publish.empty()) {
+      if (!publisher.create(opt.shm_publish, ob::io::ShmFeedConfig{})) {
+        std::cerr << "Failed to create shared-memory feed: " << opt.shm_publish << "\n";
+        return false;
+      }
+    }
+    // Listener chain: backtest -> checker -> features -> bars -> publisher, each optional.
+    ob::BookListener* next = opt.shm_publish.empty() ? nullptr : &publisher;
+    if (barring && !open_bars(opt, next)) return false;
+    if (barring) next = &bars;
+    if (featuring) {
+      features_file.open(opt.features_out);
+      if (!features_file) {
+        std::cerr << "Failed to open features output: " << opt.features_out << "\n";
+        return false;
+      }
+      features_file << "ts,symbol,locate,bid,bid_qty,ask,ask_qty,microprice,queue_imbalance,depth_imbalance,ofi,"
+                       "adds,cancels,executions\n";
+      features = ob::FeatureEngine(ob::FeatureConfig{.depth=opt.feature_depth});
+      features.set_next(next);
+      features_interval_ns = std::max<std::uint64_t>(opt.features_interval_ms, 1) * 1'000'000;
+      next = &features;
+    }
+    if (checking) {
+      checker = ob::IntegrityChecker(ob::IntegrityConfig{.sample_every=opt.check_every,
+                                                         .max_overhead=opt.check_max_overhead});
+      checker.set_next(next);
+      next = &checker;
+    }
+    if (backtesting) {
+      join.qty = opt.backtest_join;
+      backtest = std::make_unique<ob::Backtester>(book, join,
+                                                  ob::BacktestConfig{.latency_ns=opt.backtest_latency_us * 1000});
+      backtest->subscribe_all();
+      backtest->set_next(next);
+      next = backtest.get();
+    }
+    book.set_listener(next);
+    if (snapshot) {
+      ob::io::SnapshotConfig cfg;
+      cfg.depth = opt.snapshot_depth;
+      cfg.interval_ns = opt.snapshot_interval_ms * 1'000'000;
+      if (!writer.open(opt.snapshot_out, cfg)) {
+        std::cerr << "Failed to open snapshot output: " << opt.snapshot_out << "\n";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool open_bars(const Options& opt, ob::BookListener* next) {
+    ob::TradeBarsConfig cfg;
+    cfg.periods_ns.clear();
+    std::istringstream list(opt.bar_seconds);
+    for (std::string item; std::getline(list, item, ',');) {
+      item = trim_ws(item);
+      if (item.empty()) continue;
+      char* end = nullptr;
+      const double seconds = std::strtod(item.c_str(), &end);
+      if (*end != '\0' || !(seconds * 1e9 >= 1.0)) {
+        std::cerr << "Bad --bar-seconds entry: " << item << "\n";
+        return false;
+      }
+      cfg.periods_ns.push_back(static_cast<std::uint64_t>(seconds * 1e9));
+    }
+    if (cfg.periods_ns.empty()) {
+      std::cerr << "--bar-seconds lists no periods\n";
+      return false;
+    }
+    bars_file.open(opt.bars_out);
+    if (!bars_file) {
+      std::cerr << "Failed to open bars output: " << opt.bars_out << "\n";
+      return false;
+    }
+    bars_file << "symbol,locate,period_ns,start_ns,open,high,low,close,volume,hidden_volume,vwap,trades\n";
+    bars = ob::TradeBars(cfg, [this](std::span<const ob::TradeBar> batch) {
+      for (const ob::TradeBar& b : batch) {
+        const ob::SymbolBook* sb = book.find(b.locate);
+        bars_file << (sb ? sb->symbol() : std::string_view{}) << ',' << b.locate << ','
+                  << bars.config().periods_ns[b.period] << ',' << b.start_ns << ',' << b.open << ',' << b.high
+                  << ',' << b.low << ',' << b.close << ',' << b.volume << ',' << b.hidden_volume << ','
+                  << std::fixed << std::setprecision(2) << b.vwap() << ',' << b.trades << '\n';
+      }
+    });
+    bars.set_next(next);
+    return true;
+  }
+
+  // One CSV row per symbol; per-level flow counts are summed over the tracked levels.
+  void write_features(std::uint64_t ts) {
+    features.export_rows(&feature_rows);
+    for (const ob::FeatureRow& r : feature_rows) {
+      std::uint64_t flow[3] = {0, 0, 0};
+      for (std::size_t s = 0; s < 2; ++s) {
+        for (std::size_t k = 0; k < r.depth; ++k) {
+          flow[0] += r.adds[s][k];
+          flow[1] += r.cancels[s][k];
+          flow[2] += r.executions[s][k];
+        }
+      }
+      const ob::SymbolBook* sb = book.find(r.locate);
+      features_file << ts << ',' << (sb ? sb->symbol() : std::string_view{}) << ',' << r.locate << ',' << r.bid
+                    << ',' << r.bid_qty << ',' << r.ask << ',' << r.ask_qty << ',' << std::fixed
+                    << std::setprecision(4) << r.microprice << ',' << r.queue_imbalance << ','
+                    << r.depth_imbalance << ',' << r.ofi << ',' << flow[0] << ',' << flow[1] << ',' << flow[2]
+                    << '\n';
+    }
+  }
+
+  // One CSV row per book, then the current and peak totals on stdout.
+  bool write_memory(const std::string& path) {
+    std::ofstream out(path);
+    out << "symbol,locate,backend,orders,peak_orders,pool_bytes,index_bytes,level_bytes,"
+           "peak_pool_bytes,peak_index_bytes,peak_level_bytes\n";
+    for (ob::StockLocate loc : book.locates()) {
+      const ob::SymbolBook& b = *book.find(loc);
+      const ob::MemoryFootprint m = b.footprint();
+      const ob::MemoryFootprint p = b.peak_footprint();
+      out << b.symbol() << ',' << loc << ',' << ob::to_string(b.backend()) << ',' << b.order_count() << ','
+          << b.peak_orders() << ',' << m.pool_bytes << ',' << m.index_bytes << ',' << m.level_bytes << ','
+          << p.pool_bytes << ',' << p.index_bytes << ',' << p.level_bytes << '\n';
+    }
+    out.flush();
+    if (!out) {
+      std::cerr << "Memory report write failed: " << path << "\n";
+      return false;
+    }
+    const ob::MemoryFootprint m = book.footprint();
+    const ob::MemoryFootprint p = book.peak_footprint();
+    std::cout << "memory: " << m.total() / 1024 << " KiB now (pool " << m.pool_bytes / 1024 << ", index "
+              << m.index_bytes / 1024 << ", levels " << m.level_bytes / 1024 << "), peak " << p.total() / 1024
+              << " KiB -> " << path << "\n";
+    return true;
+  }
+
+  // Diffing two runs' files finds the first window of events where their books part.
+  void write_hash() {
+    hash_file << events << ',' << last_ts << ',' << std::hex << std::setw(16) << std::setfill('0')
+              << book.state_hash() << std::dec << std::setfill(' ') << '\n';
+  }
+
+  template <typename Event>
+  void apply(const Event& e) {
+    if (backtesting) {
+      backtest->apply(e);
+    } else {
+      book.apply(e);
+    }
+    ++events;
+    if (hash_every > 0 && events % hash_every == 0) write_hash();
+  }
+
+  // Call with each message timestamp before its event is applied.
+  void advance(std::uint64_t ts) {
+    if (backtesting) backtest->advance(ts);
+    if (snapshot) writer.advance(ts, book);
+    if (barring) bars.advance(ts);
+    if (featuring && ts >= next_features_ns) {
+      if (next_features_ns > 0) write_features(next_features_ns);
+      next_features_ns = (ts / features_interval_ns + 1) * features_interval_ns;
+    }
+    // Books are single-threaded, so trimming runs here between events, a bounded
+    // number of symbols per interval.
+    if (trimming && ts >= next_trim_ns) {
+      if (next_trim_ns > 0) {
+        const ob::TrimStats st = book.trim_idle(trim_policy, kTrimSymbolsPerStep);
+        trim_totals.checked += st.checked;
+        trim_totals.trimmed += st.trimmed;
+        trim_totals.bytes_before += st.bytes_before;
+        trim_totals.bytes_after += st.bytes_after;
+      }
+      next_trim_ns = (ts / trim_interval_ns + 1) * trim_interval_ns;
+    }
+    last_ts = ts;
+  }
+
+  bool close(const Options& opt) {
+    if (snapshot) {
+      if (!writer.close()) {
+        std::cerr << "Snapshot write failed: " << opt.snapshot_out << "\n";
+        return false;
+      }
+      std::cout << "snapshots: " << writer.samples() << " samples, " << writer.rows() << " rows -> "
+                << opt.snapshot_out << "\n";
+    }
+    if (!opt.capacity_out.empty() && !book.capacity_profile().save(opt.capacity_out)) {
+      std::cerr << "Failed to write capacity profile: " << opt.capacity_out << "\n";
+      return false;
+    }
+    if (!opt.shm_publish.empty()) {
+      std::cout << "shm: " << publisher.published() << " records -> " << opt.shm_publish << "\n";
+    }
+    if (featuring) {
+      write_features(last_ts);
+      features_file.flush();
+      if (!features_file) {
+        std::cerr << "Features write failed: " << opt.features_out << "\n";
+        return false;
+      }
+      std::cout << "features: " << features.size() << " symbols, depth " << features.depth() << " -> "
+                << opt.features_out << "\n";
+    }
+    if (barring) {
+      bars.finish();
+      bars_file.flush();
+      if (!bars_file) {
+        std::cerr << "Bars write failed: " << opt.bars_out << "\n";
+        return false;
+      }
+      const ob::TradeBarsStats& st = bars.stats();
+      std::cout << "bars: " << st.bars << " bars from " << st.trades << " trades (" << st.volume << " shares, "
+                << st.non_printable << " non-printable skipped) -> " << opt.bars_out << "\n";
+    }
+    if (backtesting) {
+      const ob::BacktestStats& st = backtest->stats();
+      std::cout << "backtest: " << st.submitted << " orders (" << st.cancelled << " cancelled), " << st.fills
+                << " fills for " << st.filled_qty << " shares; position " << join.position << ", cash "
+                << std::fixed << std::setprecision(4) << join.cash / 10000.0 << "\n";
+    }
+    if (trimming) {
+      std::cout << "trim: " << trim_totals.trimmed << " of " << trim_totals.checked << " books compacted, "
+                << (trim_totals.bytes_before - trim_totals.bytes_after) / 1024 << " KiB released\n";
+    }
+    if (!opt.memory_out.empty() && !write_memory(opt.memory_out)) return false;
+    if (hashing) {
+      if (hash_every == 0 || events % hash_every != 0) write_hash();
+      hash_file.flush();
+      if (!hash_file) {
+        std::cerr << "Hash write failed: " << opt.hash_out << "\n";
+        return false;
+      }
+      std::cout << "hash: " << std::hex << std::setw(16) << std::setfill('0') << book.state_hash() << std::dec
+                << std::setfill(' ') << " after " << events << " events -> " << opt.hash_out << "\n";
+    }
+    if (checking) {
+      const ob::IntegrityStats& st = checker.stats();
+      std::cout << "integrity: " << st.violations() << " violations (" << st.crossed << " crossed, "
+                << st.level_mismatch << " level, " << st.order_mismatch << " order";
+      if (st.violations() > 0) std::cout << ", last on locate " << st.last_violation;
+      std::cout << "); " << st.slices << " slices (" << st.throttled << " throttled), " << st.levels_checked
+                << " levels and " << st.orders_checked << " orders walked, " << st.check_ns / 1000 << " us\n";
+    }
+    return true;
+  }
+};
+
+void print_ring(const char* name, const ob::ingest::RingStats& r) {
+  std::cerr << name << " ring: " << r.occupancy << "/" << r.capacity << " (high " << r.high_water
+            << "), pushed " << r.pushed << ", full stalls " << r.full_stalls << ", empty polls " << r.empty_polls
+            << "\n";
+}
+
+void print_pipeline_stats(const ob::ingest::PipelineStats& st) {
+  std::cerr << "pipeline: " << st.messages << " msgs decoded, " << st.skipped << " skipped, " << st.events_applied
+            << " events applied\n";
+  print_ring("  frame", st.frames);
+  print_ring("  event", st.events);
+}
+
+// Runs source through receive/decode/book stages; the book stage is this thread.
+int run_pipeline(const Options& opt, ob::ingest::IngestPipeline::Source source) {
+  Replay replay;
+  if (!replay.open(opt)) return 1;
+  ob::io::JournalWriter journal;
+  const bool journaling = !opt.journal_out.empty();
+  if (journaling && !journal.open(opt.journal_out)) {
+    std::cerr << "Failed to open journal output: " << opt.journal_out << "\n";
+    return 1;
+  }
+  ob::ingest::IngestPipeline pipeline(opt.pipeline_cfg);
+
+  std::atomic<bool> running{true};
+  std::thread monitor;
+  if (opt.stats_interval_ms > 0) {
+    monitor = std::thread([&] {
+      while (running.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(opt.stats_interval_ms));
+        print_pipeline_stats(pipeline.stats());
+      }
+    });
+  }
+
+  pipeline.start(std::move(source));
+  pipeline.drain([&](std::uint64_t ts, const auto& e) {
+    replay.advance(ts);
+    if (journaling) journal.append(ts, e);
+    replay.apply(e);
+  });
+  running.store(false, std::memory_order_relaxed);
+  if (monitor.joinable()) monitor.join();
+
+  std::array<std::size_t, 256> counts{};
+  for (std::size_t i = 0; i < counts.size(); ++i) counts[i] = pipeline.type_counts()[i];
+  dump_counts(counts);
+  if (opt.filter.active()) print_filter_stats(pipeline.filter_stats());
+  const ob::ingest::PipelineStats st = pipeline.stats();
+  print_pipeline_stats(st);
+  if (st.stopped_frames > 0) {
+    std::cerr << "Stopped early in " << st.stopped_frames << " frame(s), unknown or incomplete message; "
+              << st.leftover_bytes << " bytes left undecoded (last at offset " << st.last_stop_offset
+              << " of frame " << st.last_stop_frame << ").\n";
+  }
+  if (journaling) {
+    if (!journal.close()) {
+      std::cerr << "Journal write failed: " << opt.journal_out << "\n";
+      return 1;
+    }
+    std::cout << "journal: " << journal.records() << " records -> " << opt.journal_out << "\n";
+  }
+  return replay.close(opt) ? 0 : 1;
+}
+
+// A span of the input that arrived as one unit: a captured sequenced frame, or the
+// whole of a plain ITCH file (recv_ns 0).
+struct InputFrame {
+  std::size_t begin{};
+  std::size_t end{};
+  std::uint64_t recv_ns{};
+};
+
+bool read_whole_file(const std::string& path, std::vector<std::uint8_t>* out) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  out->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  return true;
+}
+
+// Loads an ITCH file in any ItchFraming (unframed to raw messages), or a capture
+// (path, path.1, ...) whose sequenced payloads are concatenated into data with one
+// InputFrame each.
+bool load_input(const std::string& path, ob::ingest::ItchFraming framing, std::vector<std::uint8_t>* data,
+                std::vector<InputFrame>* frames, std::size_t* capture_files) {
+  std::vector<std::uint8_t> raw;
+  if (!read_whole_file(path, &raw)) return false;
+  *capture_files = 0;
+  if (!ob::io::is_capture_file(raw.data(), raw.size())) {
+    if (framing == ob::ingest::ItchFraming::Auto) framing = ob::ingest::detect_itch_framing(raw.data(), raw.size());
+    if (framing != ob::ingest::ItchFraming::Raw) { // raw input is decoded as it is
+      ob::ingest::ItchIndex index;
+      const std::size_t size = raw.size();
+      const bool whole = ob::ingest::unframe_itch(&raw, framing, &index);
+      std::cout << "framing: " << ob::ingest::to_string(index.framing) << ", " << index.size() << " messages, "
+                << index.unknown << " unknown skipped, " << index.other << " other packets\n";
+      if (!whole) std::cerr << "Framing stops at offset " << index.end << " of " << size << "\n";
+    }
+    frames->push_back(InputFrame{0, raw.size(), 0});
+    *data = std::move(raw);
+    return true;
+  }
+  for (std::size_t part = 0;; ++part) {
+    if (part > 0 && !read_whole_file(path + "." + std::to_string(part), &raw)) break;
+    const bool ok = ob::io::for_each_capture_record(raw.data(), raw.size(),
+        [&](const ob::io::CaptureRecordHeader& h, std::span<const std::uint8_t> payload) {
+          if (h.type != 'S') return;
+          frames->push_back(InputFrame{data->size(), data->size() + payload.size(), h.recv_ns});
+          data->insert(data->end(), payload.begin(), payload.end());
+        });
+    if (!ok) {
+      std::cerr << "Truncated or corrupt capture part " << part << "\n";
+      break;
+    }
+    ++*capture_files;
+  }
+  return true;
+}
+
+// Sleeps so that frames are handed on with the gaps they were received with.
+struct Pacer {
+  bool enabled{false};
+  std::uint64_t first_ns{0};
+  std::chrono::steady_clock::time_point start;
+
+  void wait(std::uint64_t recv_ns) {
+    if (!enabled || recv_ns == 0) return;
+    if (first_ns == 0) {
+      first_ns = recv_ns;
+      start = std::chrono::steady_clock::now();
+      return;
+    }
+    std::this_thread::sleep_until(start + std::chrono::nanoseconds(recv_ns - first_ns));
+  }
+};
+
 int run_file_mode(const Options& opt) {
-  std::ifstream in(opt.file, std::ios::binary);
-  if (!in) {
+  std::vector<std::uint8_t> data;
+  std::vector<InputFrame> frames;
+  std::size_t capture_files = 0;
+  if (!load_input(opt.file, opt.framing_mode, &data, &frames, &capture_files)) {
     std::cerr << "Failed to open file: " << opt.file << "\n";
     return 1;
   }
-
-  std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
   if (data.empty()) {
     std::cerr << "File is empty: " << opt.file << "\n";
     return 1;
   }
+  if (capture_files > 0) {
+    std::cout << "capture: " << frames.size() << " sequenced frames from " << capture_files << " file(s)\n";
+  }
+  Pacer pacer;
+  pacer.enabled = opt.replay_timing;
 
-  std::array<std::size_t, 256> counts{};
-  std::size_t offset = 0;
-  ob::ingest::ItchMessageView msg;
-  while (ob::ingest::decode_next_itch(data.data(), data.size(), &offset, &msg)) {
-    counts[static_cast<unsigned char>(msg.type)]++;
+  if (opt.pipeline) {
+    std::size_t next = 0;
+    return run_pipeline(opt, [&](std::vector<std::uint8_t>* payload) {
+      if (next == frames.size()) return false;
+      const InputFrame& f = frames[next++];
+      pacer.wait(f.recv_ns);
+      if (frames.size() == 1) {
+        *payload = std::move(data);
+      } else {
+        payload->assign(data.begin() + static_cast<std::ptrdiff_t>(f.begin),
+                        data.begin() + static_cast<std::ptrdiff_t>(f.end));
+      }
+      return true;
+    });
+  }
+
+  Replay replay;
+  if (!replay.open(opt)) return 1;
+  ob::io::JournalWriter journal;
+  const bool journaling = !opt.journal_out.empty();
+  if (journaling && !journal.open(opt.journal_out)) {
+    std::cerr << "Failed to open journal output: " << opt.journal_out << "\n";
+    return 1;
   }
 
-  if (offset != data.size()) {
-    std::cerr << "Stopped early at offset " << offset << ", unknown or incomplete message.\n";
+  std::array<std::size_t, 256> counts{};
+  ob::ingest::ItchDecoder decoder(opt.filter);
+  ob::ingest::ItchRun run;
+  for (const InputFrame& f : frames) {
+    pacer.wait(f.recv_ns);
+    std::size_t offset = f.begin;
+    ob::ingest::ItchMessageView msg;
+    for (;;) {
+      if (std::size_t n = decoder.next_run(data.data(), f.end, &offset, &run)) {
+        counts[static_cast<unsigned char>(run.type)] += n;
+        if (!replay.enabled && !journaling) continue;
+        ob::ingest::visit_itch_run(run, [&](std::uint64_t ts, const auto& e) {
+          replay.advance(ts);
+          if (journaling) journal.append(ts, e);
+          if (replay.enabled) replay.apply(e);
+        });
+        continue;
+      }
+      if (!decoder.next(data.data(), f.end, &offset, &msg)) break;
+      counts[static_cast<unsigned char>(msg.type)]++;
+      if (!replay.enabled && !journaling) continue;
+
+      ob::ingest::ItchHeader hdr;
+      if (!ob::ingest::decode_itch_header(msg, &hdr)) continue;
+      replay.advance(hdr.timestamp);
+      ob::ingest::visit_itch_book_event(msg, [&](const auto& e) {
+        if (journaling) journal.append(hdr.timestamp, e);
+        if (replay.enabled) replay.apply(e);
+      });
+    }
+    if (offset != f.end) {
+      std::cerr << "Stopped early at offset " << offset << ", unknown or incomplete message.\n";
+      break;
+    }
   }
 
   dump_counts(counts);
+  if (opt.filter.active()) print_filter_stats(decoder.stats());
+  if (journaling) {
+    if (!journal.close()) {
+      std::cerr << "Journal write failed: " << opt.journal_out << "\n";
+      return 1;
+    }
+    std::cout << "journal: " << journal.records() << " records -> " << opt.journal_out << "\n";
+  }
+  return replay.close(opt) ? 0 : 1;
+}
+
+int run_as_of(const Options& opt, const ob::io::JournalReader& journal) {
+  std::uint64_t ts = 0;
+  if (!parse_time_of_day(opt.as_of, &ts)) {
+    std::cerr << "Bad --as-of time: " << opt.as_of << "\n";
+    return 1;
+  }
+  if (opt.journal_locate < 0 || opt.checkpoints.empty()) {
+    std::cerr << "--as-of needs --journal-locate and --checkpoints\n";
+    return 1;
+  }
+  ob::io::CheckpointReader ckpt;
+  if (!ckpt.open(opt.checkpoints, journal)) {
+    std::cerr << "Failed to open checkpoints for this journal: " << opt.checkpoints << "\n";
+    return 1;
+  }
+  const auto locate = static_cast<ob::StockLocate>(opt.journal_locate);
+  ob::OrderBook book;
+  ob::io::AsOfStats st;
+  if (!ckpt.book_at(locate, ts, book, &st)) {
+    std::cerr << "Locate " << locate << " not known at " << opt.as_of << "\n";
+    return 1;
+  }
+  const ob::SymbolBook* b = book.find(locate);
+  std::cout << b->symbol() << " as of " << ts << "ns: " << b->order_count() << " orders (checkpoint "
+            << st.checkpoint_ts << "ns, " << st.restored_orders << " restored, " << st.replayed_records
+            << " records replayed)\n";
+  for (ob::Side side : {ob::Side::Sell, ob::Side::Buy}) {
+    auto levels = b->depth(side, 10);
+    if (side == ob::Side::Sell) std::reverse(levels.begin(), levels.end());
+    for (const auto& l : levels) {
+      std::cout << "  " << ob::to_string(side) << " " << l.price << " x " << l.qty << " (" << l.count << ")\n";
+    }
+  }
   return 0;
 }
 
-int run_live_mode(const Options& opt) {
+int run_journal_mode(const Options& opt) {
+  ob::io::JournalReader reader;
+  if (!reader.open(opt.journal)) {
+    std::cerr << "Failed to open journal: " << opt.journal << "\n";
+    return 1;
+  }
+  if (opt.journal_locate > 0xFFFF) {
+    std::cerr << "--journal-locate out of range: " << opt.journal_locate << "\n";
+    return 1;
+  }
+
+  if (!opt.as_of.empty()) return run_as_of(opt, reader);
+  if (!opt.checkpoint_out.empty()) {
+    if (!ob::io::build_checkpoints(reader, opt.checkpoint_out, opt.checkpoint_interval_ms * 1'000'000)) {
+      std::cerr << "Failed to write checkpoints: " << opt.checkpoint_out << "\n";
+      return 1;
+    }
+    std::cout << "checkpoints -> " << opt.checkpoint_out << "\n";
+  }
+
+  Replay replay;
+  if (!replay.open(opt)) return 1;
+  std::uint64_t applied = 0;
+  auto apply = [&](const ob::io::JournalRecord& r) {
+    replay.advance(r.timestamp);
+    ob::io::visit_journal_event(r, [&](const auto& e) { replay.apply(e); });
+    ++applied;
+  };
+  if (opt.journal_locate >= 0) {
+    reader.for_each(static_cast<ob::StockLocate>(opt.journal_locate), apply);
+  } else {
+    reader.for_each(apply);
+  }
+  std::cout << "journal: " << applied << " of " << reader.records().size() << " records applied, "
+            << replay.book.locates().size() << " symbols\n";
+  return replay.close(opt) ? 0 : 1;
+}
+
+int run_batch_mode(const Options& opt) {
+  std::vector<std::string> files = ob::ingest::expand_file_args(opt.batch);
+  if (files.empty()) {
+    std::cerr << "No input files for --batch\n";
+    return 1;
+  }
+  ob::ingest::BatchConfig cfg;
+  cfg.threads = opt.threads;
+  cfg.memory_budget = opt.memory_budget_mb << 20;
+  cfg.filter = opt.filter;
+  cfg.framing = opt.framing_mode;
+
+  std::cout << std::fixed << std::setprecision(1);
+  auto summary = ob::ingest::replay_files(files, cfg, [](const ob::ingest::FileResult& r) {
+    std::cout << (r.ok ? "ok   " : "FAIL ") << r.path << ": " << r.messages << " msgs, " << r.skipped << " skipped, "
+              << r.symbols << " symbols, " << r.seconds << " s, "
+              << r.messages_per_second() / 1e6 << " M msg/s, " << r.megabytes_per_second() << " MB/s, book "
+              << (r.book_bytes >> 20) << " MiB, queued " << r.queued_seconds << " s, worker " << r.worker;
+    if (!r.ok) std::cout << " (" << r.error << ")";
+    std::cout << std::endl;
+  });
+  std::cout << "batch: " << summary.files << " files (" << summary.failed << " failed), " << summary.threads
+            << " threads, " << summary.seconds << " s, " << summary.messages_per_second() / 1e6 << " M msg/s, "
+            << summary.megabytes_per_second() << " MB/s, peak budget " << (summary.peak_budget_bytes >> 20)
+            << " MiB\n";
+  return summary.failed == 0 ? 0 : 1;
+}
+
+int run_live_session(const Options& opt, ob::io::CaptureWriter& capture) {
   ob::ingest::SoupBinClient client;
+  // Every frame, login response and heartbeats included, is captured as received.
+  auto read_frame = [&](ob::ingest::SoupBinFrame* frame) {
+    if (!client.read_frame(frame)) return false;
+    if (capture.is_open()) {
+      capture.record(frame->type, frame->payload.data(), frame->payload.size(), ob::io::CaptureWriter::now_ns());
+    }
+    return true;
+  };
   if (!client.connect_tcp(opt.host, opt.port)) {
     std::cerr << "Failed to connect to " << opt.host << ":" << opt.port << "\n";
     return 1;
@@ -192,7 +1153,7 @@ int run_live_mode(const Options& opt) {
     }
 
     ob::ingest::SoupBinFrame frame;
-    if (!client.read_frame(&frame)) {
+    if (!read_frame(&frame)) {
       std::cerr << "Failed to read login response\n";
       return 1;
     }
@@ -207,10 +1168,26 @@ int run_live_mode(const Options& opt) {
     }
   }
 
+  if (opt.pipeline) {
+    std::size_t frames = 0;
+    ob::ingest::SoupBinFrame frame; // swaps buffers with the recycled payloads
+    return run_pipeline(opt, [&](std::vector<std::uint8_t>* payload) {
+      while (opt.frames == 0 || frames < opt.frames) {
+        if (!read_frame(&frame)) return false;
+        ++frames;
+        if (frame.type == 'S') {
+          payload->swap(frame.payload);
+          return true;
+        }
+      }
+      return false;
+    });
+  }
+
   std::array<std::size_t, 256> counts{};
   for (std::size_t i = 0; i < opt.frames; ++i) {
     ob::ingest::SoupBinFrame frame;
-    if (!client.read_frame(&frame)) {
+    if (!read_frame(&frame)) {
       std::cerr << "Read failed after " << i << " frames\n";
       break;
     }
@@ -235,6 +1212,31 @@ int run_live_mode(const Options& opt) {
   return 0;
 }
 
+int run_live_mode(const Options& opt) {
+  ob::io::CaptureWriter capture;
+  if (!opt.capture_out.empty()) {
+    ob::io::CaptureConfig cfg;
+    cfg.roll_bytes = opt.capture_roll_mb << 20;
+    cfg.direct = opt.capture_direct;
+    if (!capture.open(opt.capture_out, cfg)) {
+      std::cerr << "Failed to open capture output: " << opt.capture_out << "\n";
+      return 1;
+    }
+  }
+  int rc = run_live_session(opt, capture);
+  if (capture.is_open()) {
+    const bool ok = capture.close();
+    const ob::io::CaptureStats st = capture.stats();
+    std::cout << "capture: " << st.records << " frames, " << st.bytes << " bytes in " << st.files << " file(s) -> "
+              << opt.capture_out << " (" << st.chunks_allocated << " extra chunks, " << st.stalls << " stalls)\n";
+    if (!ok) {
+      std::cerr << "Capture write failed: " << opt.capture_out << "\n";
+      rc = 1;
+    }
+  }
+  return rc;
+}
+
 } // namespace
 
 int main(int argc, char** argv) {
@@ -244,6 +1246,19 @@ int main(int argc, char** argv) {
     print_usage(argv[0]);
     return 1;
   }
+  if (!build_filter(&opt)) return 1;
+  if (!ob::ingest::parse_itch_framing(opt.framing, &opt.framing_mode)) {
+    std::cerr << "Bad --framing: " << opt.framing << "\n";
+    return 1;
+  }
+
+  if (!opt.batch.empty()) {
+    return run_batch_mode(opt);
+  }
+
+  if (!opt.journal.empty()) {
+    return run_journal_mode(opt);
+  }
 
   if (!opt.file.empty()) {
     return run_file_mode(opt);
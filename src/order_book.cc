@@ -1,49 +1,227 @@
 #include "ob/order_book.hpp"
+#include <algorithm>
 
 namespace ob {
 
+LevelBackend OrderBook::backend_for(std::string_view symbol) const {
+  auto it = backend_by_symbol_.find(std::string(symbol));
+  if (it != backend_by_symbol_.end()) return it->second;
+  if (const SymbolCapacity* c = capacity_.find(symbol)) {
+    if (c->levels > 0 && c->levels <= flat_max_levels_) return LevelBackend::Flat;
+  }
+  return default_backend_;
+}
+
 void OrderBook::add_symbol(StockLocate locate, std::string symbol) {
-  books_.emplace(locate, SymbolBook{locate, std::move(symbol)});
+  LevelBackend backend = backend_for(symbol);
+  add_symbol(locate, std::move(symbol), backend);
+}
+
+void OrderBook::set_memory(BookMemory mode, std::pmr::memory_resource* upstream) {
+  memory_ = mode;
+  upstream_ = upstream;
+  // Books already registered keep the resource they were built with.
+  if (mode == BookMemory::Shared &&
+      (shared_pools_.empty() || shared_pools_.back()->upstream_resource() != upstream)) {
+    shared_pools_.push_back(std::make_unique<std::pmr::unsynchronized_pool_resource>(upstream));
+  }
+}
+
+OrderBook::Entry OrderBook::make_entry(StockLocate locate, std::string symbol, LevelBackend backend) const {
+  Entry en;
+  en.backend = backend;
+  std::pmr::memory_resource* mr = upstream_;
+  if (memory_ == BookMemory::PerSymbol) {
+    en.pool = std::make_unique<std::pmr::unsynchronized_pool_resource>(upstream_);
+    mr = en.pool.get();
+  } else if (memory_ == BookMemory::Shared) {
+    mr = shared_pools_.back().get();
+  }
+  if (backend == LevelBackend::Flat) {
+    en.book = std::make_unique<FlatSymbolBook>(locate, std::move(symbol), mr);
+  } else {
+    en.book = std::make_unique<MapSymbolBook>(locate, std::move(symbol), mr);
+  }
+  return en;
+}
+
+void OrderBook::add_symbol(StockLocate locate, std::string symbol, LevelBackend backend) {
+  if (books_.find(locate) != books_.end()) return;
+  Entry en = make_entry(locate, std::move(symbol), backend);
+  SymbolBook& b = *en.book;
+  b.set_listener(listener_);
+  if (const SymbolCapacity* c = capacity_.find(b.symbol())) {
+    b.reserve(static_cast<std::size_t>(c->orders * headroom_),
+              static_cast<std::size_t>(c->levels * headroom_));
+  }
+  books_.emplace(locate, std::move(en));
+  tops_.ensure(locate);
+}
+
+void OrderBook::set_capacity_profile(CapacityProfile profile, double headroom) {
+  capacity_ = std::move(profile);
+  headroom_ = headroom;
+  books_.reserve(capacity_.size());
+}
+
+CapacityProfile OrderBook::capacity_profile() const {
+  CapacityProfile p;
+  for (const auto& [loc, en] : books_) {
+    const SymbolBook& b = *en.book;
+    p.set(b.symbol(), SymbolCapacity{static_cast<std::uint32_t>(b.peak_orders()),
+                                     static_cast<std::uint32_t>(b.peak_levels())});
+  }
+  return p;
+}
+
+Status OrderBook::apply(const StockDirectoryEvent& e) {
+  if (books_.find(e.locate) == books_.end()) add_symbol(e.locate, std::string(e.symbol));
+  return Status::Ok;
+}
+
+Status OrderBook::reset(StockLocate locate) {
+  auto it = books_.find(locate);
+  if (it == books_.end()) return Status::UnknownSymbol;
+  it->second.book->reset();
+  tops_.update(locate, TopOfBook{});
+  return Status::Ok;
+}
+
+void OrderBook::reset() {
+  for (auto& [loc, en] : books_) {
+    en.book->reset();
+    tops_.update(loc, TopOfBook{});
+  }
+}
+
+std::uint64_t OrderBook::state_hash() const {
+  std::uint64_t h = 0;
+  for (const auto& [loc, en] : books_) {
+    const std::uint64_t b = en.book->state_hash();
+    if (b != 0) h += hash_mix(b ^ hash_mix(loc));
+  }
+  return h;
+}
+
+MemoryFootprint OrderBook::footprint() const {
+  MemoryFootprint m;
+  for (const auto& [loc, en] : books_) m += en.book->footprint();
+  return m;
+}
+
+MemoryFootprint OrderBook::peak_footprint() const {
+  MemoryFootprint m;
+  for (const auto& [loc, en] : books_) m += en.book->peak_footprint();
+  return m;
+}
+
+Status OrderBook::compact(StockLocate locate) {
+  auto it = books_.find(locate);
+  if (it == books_.end()) return Status::UnknownSymbol;
+  const SymbolBook& old = *it->second.book;
+  Entry en = make_entry(locate, std::string(old.symbol()), it->second.backend);
+  SymbolBook& b = *en.book;
+  b.reserve(old.order_count(), old.level_count(Side::Buy) + old.level_count(Side::Sell));
+  // Re-adding each level's FIFO in order keeps time priority; no listener is set yet.
+  for (Side s : {Side::Buy, Side::Sell}) {
+    old.for_each_level(s, [&](const Level& lvl) {
+      for (const Order* o = lvl.head; o; o = o->next) {
+        b.on_add(AddEvent{.locate=locate, .order_id=o->order_id, .side=o->side, .qty=o->qty,
+                          .price=o->price, .mpid=o->mpid, .has_mpid=o->has_mpid});
+      }
+      return true;
+    });
+  }
+  b.carry_peaks(old);
+  b.set_listener(listener_);
+  // The old entry dies here, its book before its pool.
+  std::swap(it->second, en);
+  return Status::Ok;
+}
+
+TrimStats OrderBook::trim_idle(const TrimPolicy& policy, std::size_t max_symbols) {
+  TrimStats st;
+  const std::size_t n = std::min(max_symbols, books_.size());
+  std::size_t loc = trim_cursor_;
+  for (std::size_t scanned = 0; st.checked < n && scanned <= 0xFFFF; ++scanned, loc = (loc + 1) & 0xFFFF) {
+    auto it = books_.find(static_cast<StockLocate>(loc));
+    if (it == books_.end()) continue;
+    ++st.checked;
+    const SymbolBook& b = *it->second.book;
+    const std::size_t before = b.footprint().total();
+    if (before < policy.min_bytes ||
+        static_cast<double>(b.order_count()) >= policy.live_fraction * static_cast<double>(b.order_capacity())) {
+      continue;
+    }
+    compact(it->first);
+    ++st.trimmed;
+    st.bytes_before += before;
+    st.bytes_after += it->second.book->footprint().total();
+  }
+  trim_cursor_ = static_cast<StockLocate>(loc);
+  return st;
+}
+
+void OrderBook::set_listener(BookListener* l) {
+  listener_ = l;
+  for (auto& [loc, en] : books_) en.book->set_listener(l);
 }
 
 SymbolBook* OrderBook::find(StockLocate locate) {
   auto it = books_.find(locate);
-  return (it == books_.end()) ? nullptr : &it->second;
+  return (it == books_.end()) ? nullptr : it->second.book.get();
 }
 
 const SymbolBook* OrderBook::find(StockLocate locate) const {
   auto it = books_.find(locate);
-  return (it == books_.end()) ? nullptr : &it->second;
+  return (it == books_.end()) ? nullptr : it->second.book.get();
+}
+
+std::vector<StockLocate> OrderBook::locates() const {
+  std::vector<StockLocate> out;
+  out.reserve(books_.size());
+  for (const auto& [loc, en] : books_) out.push_back(loc);
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+template <typename Fn>
+Status OrderBook::apply_to(StockLocate locate, Fn&& fn) {
+  auto it = books_.find(locate);
+  if (it == books_.end()) return Status::UnknownSymbol;
+  Entry& en = it->second;
+  auto run = [&](auto& b) {
+    Status st = fn(b);
+    tops_.update(locate, b.top());
+    return st;
+  };
+  if (en.backend == LevelBackend::Flat) return run(static_cast<FlatSymbolBook&>(*en.book));
+  return run(static_cast<MapSymbolBook&>(*en.book));
 }
 
 Status OrderBook::apply(const AddEvent& e) {
-  auto* b = find(e.locate);
-  if (!b) return Status::UnknownSymbol;
-  return b->on_add(e);
+  return apply_to(e.locate, [&](auto& b) { return b.on_add(e); });
 }
 
 Status OrderBook::apply(const CancelEvent& e) {
-  auto* b = find(e.locate);
-  if (!b) return Status::UnknownSymbol;
-  return b->on_cancel(e);
+  return apply_to(e.locate, [&](auto& b) { return b.on_cancel(e); });
 }
 
 Status OrderBook::apply(const DeleteEvent& e) {
-  auto* b = find(e.locate);
-  if (!b) return Status::UnknownSymbol;
-  return b->on_delete(e);
+  return apply_to(e.locate, [&](auto& b) { return b.on_delete(e); });
 }
 
 Status OrderBook::apply(const ExecuteEvent& e) {
-  auto* b = find(e.locate);
-  if (!b) return Status::UnknownSymbol;
-  return b->on_execute(e);
+  return apply_to(e.locate, [&](auto& b) { return b.on_execute(e); });
 }
 
 Status OrderBook::apply(const ReplaceEvent& e) {
-  auto* b = find(e.locate);
-  if (!b) return Status::UnknownSymbol;
-  return b->on_replace(e);
+  return apply_to(e.locate, [&](auto& b) { return b.on_replace(e); });
+}
+
+Status OrderBook::apply(const TradeEvent& e) {
+  SymbolBook* b = find(e.locate);
+  return b ? b->on_trade(e) : Status::UnknownSymbol; // no book change, tops stay valid
 }
 
-} // namespace ob
\ No newline at end of file
+} // namespace ob
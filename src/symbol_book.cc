@@ -1,5 +1,8 @@
 #include "ob/symbol_book.hpp"
+#include <algorithm>
 #include <cassert>
+#include <type_traits>
+#include <utility>
 #include <unordered_set>
 
 namespace ob {
@@ -7,17 +10,33 @@ namespace ob {
 // ---------------- OrderPool ----------------
 
 Order* OrderPool::allocate() {
+  ++live_;
   if (!free_list_.empty()) {
     Order* o = free_list_.back();
     free_list_.pop_back();
-    ++live_;
+    return o;
+  }
+  if (next_ < storage_.size()) {
+    Order* o = &storage_[next_++];
+    *o = Order{}; // may hold a pre-reset order
     return o;
   }
   storage_.emplace_back(Order{});
-  ++live_;
+  ++next_;
   return &storage_.back();
 }
 
+void OrderPool::reserve(std::size_t n) {
+  if (n > storage_.size()) storage_.resize(n);
+  free_list_.reserve(n);
+}
+
+void OrderPool::reset() {
+  free_list_.clear();
+  next_ = 0;
+  live_ = 0;
+}
+
 void OrderPool::free(Order* o) {
   assert(o != nullptr);
   *o = Order{};
@@ -59,50 +78,174 @@ void Level::unlink(Order* o) {
   o->level = nullptr;
 }
 
-// ---------------- SymbolBook helpers ----------------
+// ---------------- SymbolBook ----------------
+
+std::vector<LevelView> SymbolBook::depth(Side s, std::size_t n) const {
+  std::vector<LevelView> out(n);
+  out.resize(depth(s, out.data(), n));
+  return out;
+}
+
+std::pmr::vector<LevelView> SymbolBook::depth(Side s, std::size_t n, std::pmr::memory_resource* mr) const {
+  std::pmr::vector<LevelView> out(n, mr);
+  out.resize(depth(s, out.data(), n));
+  return out;
+}
+
+// ---------------- BasicSymbolBook helpers ----------------
+
+template <typename LevelPolicy>
+Level& BasicSymbolBook<LevelPolicy>::get_or_create_level(Side s, Price p) {
+  bool created = false;
+  Level& lvl = (s == Side::Buy) ? bids_.get_or_create(p, &created) : asks_.get_or_create(p, &created);
+  if (created) peak_levels_ = std::max(peak_levels_, bids_.size() + asks_.size());
+  return lvl;
+}
 
-Level& SymbolBook::get_or_create_level(Side s, Price p) {
+template <typename LevelPolicy>
+void BasicSymbolBook<LevelPolicy>::erase_level(Side s, Level& lvl) {
   if (s == Side::Buy) {
-    auto [it, inserted] = bids_.emplace(p, Level{});
-    if (inserted) it->second.price = p;
-    return it->second;
+    bids_.erase(lvl);
   } else {
-    auto [it, inserted] = asks_.emplace(p, Level{});
-    if (inserted) it->second.price = p;
-    return it->second;
+    asks_.erase(lvl);
   }
 }
 
-void SymbolBook::maybe_erase_level(Side s, Price p) {
-  if (s == Side::Buy) {
-    auto it = bids_.find(p);
-    if (it != bids_.end() && it->second.empty()) bids_.erase(it);
+template <typename LevelPolicy>
+void BasicSymbolBook<LevelPolicy>::reserve(std::size_t orders, std::size_t levels) {
+  if (orders_.empty()) {
+    // Cycle index nodes through the resource so a pooled resource keeps them.
+    for (std::size_t i = 0; i < orders; ++i) orders_.emplace(static_cast<OrderId>(i), nullptr);
+    orders_.clear();
+  }
+  orders_.reserve(orders);
+  pool_.reserve(orders);
+  // Split evenly; a side that outgrows its half just allocates as before.
+  bids_.reserve(levels / 2 + 1);
+  asks_.reserve(levels / 2 + 1);
+}
+
+template <typename LevelPolicy>
+void BasicSymbolBook<LevelPolicy>::reset() {
+  // Orders and levels point only at each other, so nothing is unlinked one by one:
+  // the slabs rewind and the index and level nodes go back to the memory resource.
+  orders_.clear();
+  pool_.reset();
+  bids_.clear();
+  asks_.clear();
+  state_hash_ = 0;
+  if (listener_) listener_->on_reset(*this);
+}
+
+// ---------------- State hash ----------------
+
+namespace {
+// An order's share of SymbolBook::state_hash().
+std::uint64_t order_term(const Order& o) {
+  const std::uint64_t ahead = o.prev ? o.prev->order_id : 0;
+  const std::uint64_t where = (std::uint64_t{static_cast<std::uint32_t>(o.price)} << 32) | o.qty;
+  return hash_mix(hash_mix(o.order_id ^ (o.side == Side::Sell ? 0x9E3779B97F4A7C15ULL : 0)) + hash_mix(where) + ahead);
+}
+} // namespace
+
+void SymbolBook::link_order(Level& lvl, Order* o) {
+  lvl.push_back(o); // at the tail: no other order's predecessor changes
+  state_hash_ += order_term(*o);
+}
+
+void SymbolBook::unlink_order(Order* o) {
+  Order* behind = o->next;
+  state_hash_ -= order_term(*o);
+  if (behind) state_hash_ -= order_term(*behind);
+  o->level->unlink(o);
+  if (behind) state_hash_ += order_term(*behind);
+}
+
+// ---------------- Memory accounting ----------------
+
+namespace {
+// Hashed node: next link, cached hash and the value.
+constexpr std::size_t kIndexNodeBytes = 2 * sizeof(void*) + sizeof(std::pair<const OrderId, Order*>);
+} // namespace
+
+MemoryFootprint SymbolBook::order_footprint(std::size_t orders) const {
+  return {pool_.memory_bytes(), orders_.bucket_count() * sizeof(void*) + orders * kIndexNodeBytes, 0};
+}
+
+void SymbolBook::carry_peaks(const SymbolBook& from) {
+  peak_orders_ = std::max(peak_orders_, from.peak_orders_);
+  peak_levels_ = std::max(peak_levels_, from.peak_levels_);
+  carried_peak_ = MemoryFootprint::max(carried_peak_, from.peak_footprint());
+}
+
+template <typename LevelPolicy>
+MemoryFootprint BasicSymbolBook<LevelPolicy>::footprint() const {
+  MemoryFootprint m = order_footprint(orders_.size());
+  m.level_bytes = bids_.memory_bytes() + asks_.memory_bytes();
+  return m;
+}
+
+template <typename LevelPolicy>
+MemoryFootprint BasicSymbolBook<LevelPolicy>::peak_footprint() const {
+  // Pool slots, index buckets and flat arrays only grow until compaction, so their
+  // current size is their peak; node-based parts peak with the order and level counts.
+  MemoryFootprint m = order_footprint(peak_orders_);
+  if constexpr (std::is_same_v<LevelPolicy, FlatLevelPolicy>) {
+    m.level_bytes = bids_.memory_bytes() + asks_.memory_bytes();
   } else {
-    auto it = asks_.find(p);
-    if (it != asks_.end() && it->second.empty()) asks_.erase(it);
+    m.level_bytes = peak_levels_ * Bids::kNodeBytes;
   }
+  return MemoryFootprint::max(MemoryFootprint::max(m, footprint()), carried_peak_); // footprint(): parked levels
 }
 
-Status SymbolBook::reduce_order_qty(Order* o, Qty delta) {
+template <typename LevelPolicy>
+LevelBackend BasicSymbolBook<LevelPolicy>::backend() const {
+  if constexpr (std::is_same_v<LevelPolicy, FlatLevelPolicy>) {
+    return LevelBackend::Flat;
+  } else {
+    return LevelBackend::Map;
+  }
+}
+
+template <typename LevelPolicy>
+Status BasicSymbolBook<LevelPolicy>::reduce_order_qty(Order* o, Qty delta) {
   if (delta == 0 || delta > o->qty) return Status::BadQty;
+  if (delta == o->qty) return remove_order_fully(o);
+  state_hash_ -= order_term(*o);
   o->qty -= delta;
   o->level->total_qty -= delta;
-  if (o->qty == 0) return remove_order_fully(o);
+  state_hash_ += order_term(*o);
+  notify(o->side, o->price, o->level->total_qty, o->level->order_count);
   return Status::Ok;
 }
 
-Status SymbolBook::remove_order_fully(Order* o) {
+template <typename LevelPolicy>
+Status BasicSymbolBook<LevelPolicy>::remove_order_fully(Order* o) {
   Level* lvl = o->level;
-  lvl->unlink(o);
+  unlink_order(o);
   orders_.erase(o->order_id);
-  if (lvl->empty()) maybe_erase_level(o->side, lvl->price);
+  const Side side = o->side;
+  const Price price = lvl->price;
+  const std::uint64_t qty = lvl->total_qty;
+  const std::uint32_t count = lvl->order_count;
+  if (lvl->empty()) erase_level(side, *lvl);
   pool_.free(o);
+  notify(side, price, qty, count);
+  return Status::Ok;
+}
+
+// ---------------- Events ----------------
+
+Status SymbolBook::on_trade(const TradeEvent& e) {
+  if (e.qty == 0) return Status::BadQty;
+  notify_trade(TradeUpdate{locate_, e.order_id, e.side, e.price, e.qty, true, true});
   return Status::Ok;
 }
 
-// ---------------- SymbolBook events ----------------
+// ---------------- BasicSymbolBook events ----------------
 
-Status SymbolBook::on_add(const AddEvent& e) {
+template <typename LevelPolicy>
+Status BasicSymbolBook<LevelPolicy>::on_add(const AddEvent& e) {
   if (e.qty == 0) return Status::BadQty;
   if (orders_.find(e.order_id) != orders_.end()) return Status::DuplicateOrder;
   Order* o = pool_.allocate();
@@ -115,115 +258,180 @@ Status SymbolBook::on_add(const AddEvent& e) {
   o->prev = nullptr;
   o->next = nullptr;
   o->level = nullptr;
-  get_or_create_level(e.side, e.price).push_back(o);
+  Level& lvl = get_or_create_level(e.side, e.price);
+  link_order(lvl, o);
   orders_.emplace(e.order_id, o);
+  peak_orders_ = std::max(peak_orders_, orders_.size());
+  notify(e.side, e.price, lvl.total_qty, lvl.order_count);
   return Status::Ok;
 }
 
-Status SymbolBook::on_cancel(const CancelEvent& e) {
+template <typename LevelPolicy>
+Status BasicSymbolBook<LevelPolicy>::on_cancel(const CancelEvent& e) {
   auto it = orders_.find(e.order_id);
   if (it == orders_.end()) return Status::UnknownOrder;
   return reduce_order_qty(it->second, e.cancel_qty);
 }
 
-Status SymbolBook::on_delete(const DeleteEvent& e) {
+template <typename LevelPolicy>
+Status BasicSymbolBook<LevelPolicy>::on_delete(const DeleteEvent& e) {
   auto it = orders_.find(e.order_id);
   if (it == orders_.end()) return Status::UnknownOrder;
   return remove_order_fully(it->second);
 }
 
-Status SymbolBook::on_execute(const ExecuteEvent& e) {
+template <typename LevelPolicy>
+Status BasicSymbolBook<LevelPolicy>::on_execute(const ExecuteEvent& e) {
   auto it = orders_.find(e.order_id);
   if (it == orders_.end()) return Status::UnknownOrder;
-  return reduce_order_qty(it->second, e.exec_qty);
+  // Read the resting order before the reduction may free it.
+  const Order* o = it->second;
+  const TradeUpdate t{locate_, e.order_id, o->side, e.has_price ? e.price : o->price, e.exec_qty, e.printable};
+  const Status st = reduce_order_qty(it->second, e.exec_qty);
+  if (st == Status::Ok) notify_trade(t);
+  return st;
 }
 
-Status SymbolBook::on_replace(const ReplaceEvent& e) {
+template <typename LevelPolicy>
+Status BasicSymbolBook<LevelPolicy>::on_replace(const ReplaceEvent& e) {
   // ITCH semantics: replace creates a NEW order_id and the old order_id disappears.
   if (e.new_qty == 0) return Status::BadReplace;
   auto it_old = orders_.find(e.old_order_id);
   if (it_old == orders_.end()) return Status::UnknownOrder;
-  if (orders_.find(e.new_order_id) != orders_.end()) return Status::DuplicateOrder;
-  Order* old = it_old->second;
-  Side side = old->side;
-  std::uint32_t mpid = old->mpid;
-  bool has_mpid = old->has_mpid;
-  remove_order_fully(old);
-  Order* o = pool_.allocate();
+  if (e.new_order_id == e.old_order_id) return Status::DuplicateOrder; // the new id is live: it is the old one
+  // Re-key the index node in place: one lookup for the new id and no allocation.
+  auto node = orders_.extract(it_old);
+  node.key() = e.new_order_id;
+  auto ins = orders_.insert(std::move(node));
+  if (!ins.inserted) {
+    ins.node.key() = e.old_order_id;
+    orders_.insert(std::move(ins.node));
+    return Status::DuplicateOrder;
+  }
+  // The order keeps its slot, side and attribution and goes to the back of the queue.
+  Order* o = ins.position->second;
+  Level* from = o->level;
+  unlink_order(o);
   o->order_id = e.new_order_id;
   o->qty = e.new_qty;
   o->price = e.new_price;
-  o->side = side;
-  o->mpid = mpid;
-  o->has_mpid = has_mpid;
-  o->prev = nullptr;
-  o->next = nullptr;
-  o->level = nullptr;
-  get_or_create_level(side, e.new_price).push_back(o);
-  orders_.emplace(o->order_id, o);
+  Level* to = from;
+  if (from->price != e.new_price) {
+    if (from->empty()) erase_level(o->side, *from); // parked: see level_store.hpp
+    notify(o->side, from->price, from->total_qty, from->order_count);
+    to = &get_or_create_level(o->side, e.new_price);
+  }
+  link_order(*to, o);
+  notify(o->side, e.new_price, to->total_qty, to->order_count);
   return Status::Ok;
 }
 
 // ---------------- Queries ----------------
 
-TopOfBook SymbolBook::top() const {
+template <typename LevelPolicy>
+TopOfBook BasicSymbolBook<LevelPolicy>::top() const {
   TopOfBook t;
 
-  if (!bids_.empty()) {
-    auto it = bids_.begin();
+  if (const Level* b = bids_.best()) {
     t.has_bid = true;
-    t.bid = LevelView{it->first, it->second.total_qty, it->second.order_count};
+    t.bid = LevelView{b->price, b->total_qty, b->order_count};
   }
-  if (!asks_.empty()) {
-    auto it = asks_.begin();
+  if (const Level* a = asks_.best()) {
     t.has_ask = true;
-    t.ask = LevelView{it->first, it->second.total_qty, it->second.order_count};
+    t.ask = LevelView{a->price, a->total_qty, a->order_count};
   }
   return t;
 }
 
-std::vector<LevelView> SymbolBook::depth(Side s, std::size_t n) const {
-  std::vector<LevelView> out;
-  out.reserve(n);
+template <typename LevelPolicy>
+void BasicSymbolBook<LevelPolicy>::for_each_level(Side s, const std::function<bool(const Level&)>& fn) const {
+  if (s == Side::Buy) {
+    bids_.for_each(fn);
+  } else {
+    asks_.for_each(fn);
+  }
+}
 
+template <typename LevelPolicy>
+void BasicSymbolBook<LevelPolicy>::for_each_level_after(Side s, Price p,
+                                                        const std::function<bool(const Level&)>& fn) const {
   if (s == Side::Buy) {
-    for (auto it = bids_.begin(); it != bids_.end() && out.size() < n; ++it) {
-      out.push_back(LevelView{it->first, it->second.total_qty, it->second.order_count});
-    }
+    bids_.for_each_after(p, fn);
   } else {
-    for (auto it = asks_.begin(); it != asks_.end() && out.size() < n; ++it) {
-      out.push_back(LevelView{it->first, it->second.total_qty, it->second.order_count});
-    }
+    asks_.for_each_after(p, fn);
   }
-  return out;
+}
+
+template <typename LevelPolicy>
+std::size_t BasicSymbolBook<LevelPolicy>::depth(Side s, LevelView* out, std::size_t n) const {
+  std::size_t i = 0;
+  auto take = [&](const Level& l) {
+    if (i == n) return false;
+    out[i++] = LevelView{l.price, l.total_qty, l.order_count};
+    return true;
+  };
+  if (s == Side::Buy) {
+    bids_.for_each(take);
+  } else {
+    asks_.for_each(take);
+  }
+  return i;
 }
 
 // ---------------- Validation ----------------
 
-bool SymbolBook::validate() const {
+std::size_t SymbolBook::check_orders(std::size_t first, std::size_t n, std::uint64_t* bad) const {
+  std::size_t checked = 0;
+  const std::size_t buckets = orders_.bucket_count();
+  for (std::size_t b = first; b < first + n && b < buckets; ++b) {
+    for (auto it = orders_.begin(b); it != orders_.end(b); ++it) {
+      const Order* o = it->second;
+      ++checked;
+      const bool ok = o && o->order_id == it->first && o->level && o->level->price == o->price &&
+                      (o->prev ? o->prev->next == o : o->level->head == o) &&
+                      (o->next ? o->next->prev == o : o->level->tail == o) &&
+                      find_level(o->side, o->price) == o->level;
+      if (!ok) ++*bad;
+    }
+  }
+  return checked;
+}
+
+template <typename LevelPolicy>
+bool BasicSymbolBook<LevelPolicy>::validate() const {
   std::unordered_set<Order*> seen;
   seen.reserve(orders_.size());
 
-  auto check_side = [&](const auto& map, Side s) -> bool {
-    for (const auto& [price, level] : map) {
+  auto check_side = [&](const auto& levels, Side s) -> bool {
+    bool ok = true;
+    bool first = true;
+    Price prev_price{};
+    levels.for_each([&](const Level& level) {
+      const Price price = level.price;
+      // Strictly worse than the previous level, as seen from this side.
+      if (!first && ((s == Side::Buy) ? price >= prev_price : price <= prev_price)) return ok = false;
+      first = false;
+      prev_price = price;
+
       std::uint64_t sum_qty = 0;
       std::uint32_t count = 0;
       Order* prev = nullptr;
       for (Order* o = level.head; o; o = o->next) {
-        if (o->level != &level) return false;
-        if (o->side != s) return false;
-        if (o->price != price) return false;
-        if (o->prev != prev) return false;
+        if (o->level != &level) return ok = false;
+        if (o->side != s) return ok = false;
+        if (o->price != price) return ok = false;
+        if (o->prev != prev) return ok = false;
         prev = o;
         sum_qty += o->qty;
         ++count;
         seen.insert(o);
       }
-      if (prev != level.tail) return false;
-      if (sum_qty != level.total_qty) return false;
-      if (count != level.order_count) return false;
-    }
-    return true;
+      if (prev != level.tail) return ok = false;
+      if (sum_qty != level.total_qty) return ok = false;
+      if (count != level.order_count) return ok = false;
+      return true;
+    });
+    return ok;
   };
 
   if (!check_side(bids_, Side::Buy)) return false;
@@ -238,4 +446,7 @@ bool SymbolBook::validate() const {
   return true;
 }
 
+template class BasicSymbolBook<MapLevelPolicy>;
+template class BasicSymbolBook<FlatLevelPolicy>;
+
 } // namespace ob
@@ -0,0 +1,114 @@
+#include "ob/top_table.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ob {
+
+void TopTable::ensure(StockLocate locate) {
+  std::size_t need = static_cast<std::size_t>(locate) + 1;
+  if (need <= bid_price_.size()) return;
+  bid_price_.resize(need, 0);
+  ask_price_.resize(need, 0);
+  bid_qty_.resize(need, 0);
+  ask_qty_.resize(need, 0);
+  ref_mid_.resize(need, 0.0);
+}
+
+std::size_t TopTable::scan_spread_over(Price min_spread, std::vector<StockLocate>* out) const {
+  out->clear();
+  const Price* bid = bid_price_.data();
+  const Price* ask = ask_price_.data();
+  const std::size_t n = size();
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i limit = _mm_set1_epi32(min_spread);
+  for (; i + 4 <= n; i += 4) {
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bid + i));
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ask + i));
+    __m128i two_sided = _mm_and_si128(_mm_cmpgt_epi32(b, zero), _mm_cmpgt_epi32(a, zero));
+    __m128i wide = _mm_cmpgt_epi32(_mm_sub_epi32(a, b), limit);
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(two_sided, wide)));
+    while (mask) {
+      int lane = __builtin_ctz(static_cast<unsigned>(mask));
+      out->push_back(static_cast<StockLocate>(i + static_cast<std::size_t>(lane)));
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if (bid[i] > 0 && ask[i] > 0 && ask[i] - bid[i] > min_spread) {
+      out->push_back(static_cast<StockLocate>(i));
+    }
+  }
+  return out->size();
+}
+
+std::size_t TopTable::scan_crossed_or_locked(std::vector<StockLocate>* out) const {
+  out->clear();
+  const Price* bid = bid_price_.data();
+  const Price* ask = ask_price_.data();
+  const std::size_t n = size();
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 4 <= n; i += 4) {
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bid + i));
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ask + i));
+    __m128i two_sided = _mm_and_si128(_mm_cmpgt_epi32(b, zero), _mm_cmpgt_epi32(a, zero));
+    // bid >= ask  <=>  !(ask > bid)
+    __m128i hit = _mm_andnot_si128(_mm_cmpgt_epi32(a, b), two_sided);
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(hit));
+    while (mask) {
+      int lane = __builtin_ctz(static_cast<unsigned>(mask));
+      out->push_back(static_cast<StockLocate>(i + static_cast<std::size_t>(lane)));
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if (bid[i] > 0 && ask[i] > 0 && bid[i] >= ask[i]) out->push_back(static_cast<StockLocate>(i));
+  }
+  return out->size();
+}
+
+void TopTable::mark_reference() {
+  const std::size_t n = size();
+  for (std::size_t i = 0; i < n; ++i) {
+    const bool two_sided = bid_price_[i] > 0 && ask_price_[i] > 0;
+    ref_mid_[i] = two_sided ? 0.5 * (static_cast<double>(bid_price_[i]) + ask_price_[i]) : 0.0;
+  }
+}
+
+std::size_t TopTable::top_movers(std::size_t k, std::vector<StockLocate>* out) const {
+  out->clear();
+  const std::size_t n = size();
+  move_scratch_.resize(n);
+  // Branch-free so the compiler can vectorize it; invalid rows score -1.
+  for (std::size_t i = 0; i < n; ++i) {
+    const double mid = 0.5 * (static_cast<double>(bid_price_[i]) + ask_price_[i]);
+    const bool valid = bid_price_[i] > 0 && ask_price_[i] > 0 && ref_mid_[i] > 0.0;
+    const double ref = valid ? ref_mid_[i] : 1.0;
+    move_scratch_[i] = valid ? std::fabs(mid / ref - 1.0) : -1.0;
+  }
+
+  std::vector<StockLocate>& idx = *out;
+  idx.resize(n);
+  std::iota(idx.begin(), idx.end(), StockLocate{0});
+  auto valid_end = std::partition(idx.begin(), idx.end(),
+                                  [&](StockLocate l) { return move_scratch_[l] >= 0.0; });
+  idx.erase(valid_end, idx.end());
+  k = std::min(k, idx.size());
+  std::partial_sort(idx.begin(), idx.begin() + static_cast<std::ptrdiff_t>(k), idx.end(),
+                    [&](StockLocate a, StockLocate b) { return move_scratch_[a] > move_scratch_[b]; });
+  idx.resize(k);
+  return k;
+}
+
+} // namespace ob
@@ -0,0 +1,87 @@
+#include "ob/trade_bars.hpp"
+#include <algorithm>
+
+namespace ob {
+
+TradeBars::TradeBars(const TradeBarsConfig& cfg, Sink sink) : cfg_(cfg), sink_(std::move(sink)) {
+  cfg_.batch = std::max<std::size_t>(cfg_.batch, 1);
+  periods_.resize(cfg_.periods_ns.size());
+  for (std::size_t i = 0; i < periods_.size(); ++i) periods_[i].ns = std::max<std::uint64_t>(cfg_.periods_ns[i], 1);
+  batch_.reserve(cfg_.batch);
+}
+
+void TradeBars::advance(std::uint64_t ts) {
+  now_ = ts;
+  for (std::size_t i = 0; i < periods_.size(); ++i) {
+    Period& p = periods_[i];
+    if (ts < p.end) continue;
+    close_period(p, i);
+    p.end = (ts / p.ns + 1) * p.ns;
+  }
+}
+
+void TradeBars::close_period(Period& p, std::size_t index) {
+  for (StockLocate loc : p.open) {
+    TradeBar& bar = bars_[loc * periods_.size() + index];
+    emit(bar);
+    bar.trades = 0;
+  }
+  p.open.clear();
+}
+
+void TradeBars::emit(const TradeBar& bar) {
+  batch_.push_back(bar);
+  ++stats_.bars;
+  if (batch_.size() >= cfg_.batch) flush();
+}
+
+void TradeBars::flush() {
+  if (batch_.empty()) return;
+  if (sink_) {
+    sink_(std::span<const TradeBar>(batch_.data(), batch_.size()));
+    ++stats_.batches;
+  }
+  batch_.clear();
+}
+
+void TradeBars::finish() {
+  for (std::size_t i = 0; i < periods_.size(); ++i) close_period(periods_[i], i);
+  flush();
+}
+
+const TradeBar* TradeBars::current(StockLocate locate, std::size_t p) const {
+  const std::size_t slot = locate * periods_.size() + p;
+  if (p >= periods_.size() || slot >= bars_.size() || bars_[slot].trades == 0) return nullptr;
+  return &bars_[slot];
+}
+
+void TradeBars::on_trade(const SymbolBook& book, const TradeUpdate& t) {
+  if (!t.printable) {
+    ++stats_.non_printable;
+  } else {
+    ++stats_.trades;
+    stats_.volume += t.qty;
+    const std::size_t n = periods_.size();
+    if (bars_.size() < (t.locate + std::size_t{1}) * n) bars_.resize((t.locate + std::size_t{1}) * n);
+    const double notional = static_cast<double>(t.price) * static_cast<double>(t.qty);
+    for (std::size_t i = 0; i < n; ++i) {
+      TradeBar& bar = bars_[t.locate * n + i];
+      if (bar.trades == 0) {
+        bar = TradeBar{.locate=t.locate, .period=static_cast<std::uint32_t>(i),
+                       .start_ns=now_ / periods_[i].ns * periods_[i].ns,
+                       .open=t.price, .high=t.price, .low=t.price};
+        periods_[i].open.push_back(t.locate);
+      }
+      bar.high = std::max(bar.high, t.price);
+      bar.low = std::min(bar.low, t.price);
+      bar.close = t.price;
+      bar.volume += t.qty;
+      if (t.hidden) bar.hidden_volume += t.qty;
+      bar.notional += notional;
+      ++bar.trades;
+    }
+  }
+  if (next_) next_->on_trade(book, t);
+}
+
+} // namespace ob
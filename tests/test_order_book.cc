@@ -1,6 +1,32 @@
+// The tests build their state through the calls they assert on, so assert() must
+// evaluate them in every build type, Release included.
+#undef NDEBUG
 #include "ob/order_book.hpp"
+#include "ob/backtest.hpp"
+#include "ob/conflation.hpp"
+#include "ob/consolidated.hpp"
+#include "ob/features.hpp"
+#include "ob/integrity.hpp"
+#include "ob/ingest/batch.hpp"
+#include "ob/ingest/framing.hpp"
+#include "ob/ingest/itch.hpp"
+#include "ob/ingest/pipeline.hpp"
+#include "ob/io/capture.hpp"
+#include "ob/io/checkpoint.hpp"
+#include "ob/io/journal.hpp"
+#include "ob/io/shm_feed.hpp"
+#include "ob/io/snapshot.hpp"
+#include "ob/trade_bars.hpp"
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
 #include <iostream>
+#include <vector>
 
 static void test_add_cancel_delete() {
   ob::OrderBook book;
@@ -51,9 +77,1459 @@ static void test_replace() {
   assert(book.apply(ob::CancelEvent{.locate=1, .order_id=6, .cancel_qty=20}) == ob::Status::Ok);
 }
 
+static void test_itch_decode_add() {
+  // 'A': locate=7, tracking=0, ts=0x010203040506, ref=42, 'S', 300 shares, "MSFT    ", 3201500
+  std::vector<std::uint8_t> m = {'A', 0, 7, 0, 0, 1, 2, 3, 4, 5, 6,
+                                 0, 0, 0, 0, 0, 0, 0, 42, 'S', 0, 0, 0x01, 0x2C,
+                                 'M', 'S', 'F', 'T', ' ', ' ', ' ', ' ', 0x00, 0x30, 0xD9, 0xDC};
+  std::size_t off = 0;
+  ob::ingest::ItchMessageView msg;
+  assert(ob::ingest::decode_next_itch(m.data(), m.size(), &off, &msg) && off == m.size());
+
+  ob::ingest::ItchHeader hdr;
+  assert(ob::ingest::decode_itch_header(msg, &hdr));
+  assert(hdr.locate == 7 && hdr.timestamp == 0x010203040506ULL);
+
+  ob::AddEvent e;
+  assert(ob::ingest::decode_itch_add(msg, &e));
+  assert(e.locate == 7 && e.order_id == 42 && e.side == ob::Side::Sell);
+  assert(e.qty == 300 && e.price == 3201500 && !e.has_mpid);
+}
+
+static void test_itch_run_decode() {
+  // Random fields; long runs of each type (more than ItchRun::kMax) broken up by 'R'.
+  std::mt19937 rng(11);
+  std::vector<std::uint8_t> buf;
+  const char types[] = {'A', 'D', 'X', 'E', 'R'};
+  for (int block = 0; block < 60; ++block) {
+    const char t = types[rng() % 5];
+    const int n = 1 + static_cast<int>(rng() % 70);
+    for (int i = 0; i < n; ++i) {
+      std::size_t at = buf.size();
+      buf.resize(at + ob::ingest::itch_message_size(t));
+      buf[at] = static_cast<std::uint8_t>(t);
+      for (std::size_t k = at + 1; k < buf.size(); ++k) buf[k] = static_cast<std::uint8_t>(rng());
+      if (t == 'A') buf[at + 19] = (rng() & 1) ? 'S' : 'B';
+      if (t == 'R') std::memcpy(&buf[at + 11], "AAPL    ", 8);
+    }
+  }
+  buf.resize(buf.size() - 3); // truncated tail stops both decoders at the same offset
+
+  struct Row {
+    char type;
+    std::uint64_t ts, order;
+    ob::StockLocate locate;
+    ob::Qty qty;
+    ob::Price price;
+    ob::Side side;
+    bool operator==(const Row&) const = default;
+  };
+  auto row = [](std::uint64_t ts, const auto& e) {
+    using E = std::decay_t<decltype(e)>;
+    Row r{};
+    r.ts = ts;
+    r.locate = e.locate;
+    if constexpr (std::is_same_v<E, ob::AddEvent>) r = Row{'A', ts, e.order_id, e.locate, e.qty, e.price, e.side};
+    if constexpr (std::is_same_v<E, ob::DeleteEvent>) r = Row{'D', ts, e.order_id, e.locate, 0, 0, {}};
+    if constexpr (std::is_same_v<E, ob::CancelEvent>) r = Row{'X', ts, e.order_id, e.locate, e.cancel_qty, 0, {}};
+    if constexpr (std::is_same_v<E, ob::ExecuteEvent>) r = Row{'E', ts, e.order_id, e.locate, e.exec_qty, 0, {}};
+    if constexpr (std::is_same_v<E, ob::StockDirectoryEvent>) r.type = 'R';
+    return r;
+  };
+
+  std::vector<Row> expect;
+  std::size_t expect_off = 0;
+  ob::ingest::ItchMessageView msg;
+  while (ob::ingest::decode_next_itch(buf.data(), buf.size(), &expect_off, &msg)) {
+    ob::ingest::ItchHeader hdr;
+    assert(ob::ingest::decode_itch_header(msg, &hdr));
+    ob::ingest::visit_itch_book_event(msg, [&](const auto& e) { expect.push_back(row(hdr.timestamp, e)); });
+  }
+
+  for (auto decode : {&ob::ingest::decode_itch_run, &ob::ingest::decode_itch_run_scalar}) {
+    std::vector<Row> got;
+    std::size_t off = 0, runs = 0;
+    ob::ingest::ItchRun run;
+    for (;;) {
+      if (std::size_t n = decode(buf.data(), buf.size(), &off, &run)) {
+        assert(n <= ob::ingest::ItchRun::kMax && run.count == n);
+        ++runs;
+        ob::ingest::visit_itch_run(run, [&](std::uint64_t ts, const auto& e) { got.push_back(row(ts, e)); });
+        continue;
+      }
+      if (!ob::ingest::decode_next_itch(buf.data(), buf.size(), &off, &msg)) break;
+      ob::ingest::ItchHeader hdr;
+      assert(ob::ingest::decode_itch_header(msg, &hdr));
+      ob::ingest::visit_itch_book_event(msg, [&](const auto& e) { got.push_back(row(hdr.timestamp, e)); });
+    }
+    assert(off == expect_off && runs > 0);
+    assert(got == expect);
+  }
+}
+
+static void test_itch_filter() {
+  auto msg = [](std::vector<std::uint8_t>* buf, char type, ob::StockLocate loc, const char* sym = nullptr) {
+    std::size_t at = buf->size();
+    buf->resize(at + ob::ingest::itch_message_size(type), 0);
+    (*buf)[at] = static_cast<std::uint8_t>(type);
+    (*buf)[at + 1] = static_cast<std::uint8_t>(loc >> 8);
+    (*buf)[at + 2] = static_cast<std::uint8_t>(loc);
+    if (sym) std::memcpy(&(*buf)[at + 11], sym, 8);
+  };
+  std::vector<std::uint8_t> buf;
+  msg(&buf, 'R', 3, "AAPL    ");
+  msg(&buf, 'R', 4, "MSFT    ");
+  for (int i = 0; i < 10; ++i) {
+    for (ob::StockLocate loc : {3, 4, 5}) msg(&buf, 'A', loc);
+  }
+  for (ob::StockLocate loc : {3, 4, 5}) msg(&buf, 'D', loc);
+
+  ob::ingest::ItchFilter f;
+  f.allow_type('R');
+  f.allow_type('A');
+  f.allow_locate(5);
+  f.allow_symbol("MSFT"); // locate 4, learned from its directory message
+  ob::ingest::ItchDecoder dec(f);
+  std::size_t off = 0;
+  std::array<int, 8> by_locate{};
+  std::size_t dirs = 0;
+  ob::ingest::ItchRun run;
+  ob::ingest::ItchMessageView m;
+  for (;;) {
+    if (std::size_t n = dec.next_run(buf.data(), buf.size(), &off, &run)) {
+      assert(run.type == 'A');
+      for (std::size_t i = 0; i < n; ++i) ++by_locate[run.locate[i]];
+      continue;
+    }
+    if (!dec.next(buf.data(), buf.size(), &off, &m)) break;
+    assert(m.type == 'R');
+    ++dirs;
+  }
+  assert(off == buf.size() && dirs == 1);
+  assert(by_locate[3] == 0 && by_locate[4] == 10 && by_locate[5] == 10);
+  const auto& st = dec.stats();
+  assert(st.passed == 21 && st.skipped_type == 3 && st.skipped_locate == 11 && st.learned_locates == 1);
+}
+
+static void test_snapshot_roundtrip() {
+  ob::OrderBook book;
+  book.add_symbol(1, "AAPL");
+  book.add_symbol(2, "MSFT");
+  assert(book.apply(ob::AddEvent{.locate=1, .order_id=1, .side=ob::Side::Buy, .qty=100, .price=1000000}) == ob::Status::Ok);
+  assert(book.apply(ob::AddEvent{.locate=1, .order_id=2, .side=ob::Side::Buy, .qty=50, .price=999900}) == ob::Status::Ok);
+  assert(book.apply(ob::AddEvent{.locate=1, .order_id=3, .side=ob::Side::Sell, .qty=70, .price=1000100}) == ob::Status::Ok);
+
+  auto path = (std::filesystem::temp_directory_path() / "ob_test_snapshot.bin").string();
+  ob::io::SnapshotWriter w;
+  assert(w.open(path, ob::io::SnapshotConfig{.depth=2, .interval_ns=100, .block_rows=3}));
+  w.advance(150, book);  // grid starts at 200, nothing emitted yet
+  w.advance(450, book);  // emits 200, 300, 400 for both symbols
+  assert(w.samples() == 3 && w.rows() == 6);
+  assert(w.close());
+
+  ob::io::SnapshotReader r;
+  assert(r.open(path));
+  assert(r.depth() == 2 && r.interval_ns() == 100 && r.rows() == 6 && r.block_count() == 2);
+  const auto& b = r.block(0);
+  assert(b.rows == 3);
+  assert(b.timestamp[0] == 200 && b.locate[0] == 1 && b.locate[1] == 2 && b.timestamp[2] == 300);
+  assert(b.bid_price[0] == 1000000 && b.bid_qty[0] == 100 && b.bid_count[0] == 1);
+  assert(b.bid_price[b.rows + 0] == 999900 && b.bid_qty[b.rows + 0] == 50); // level 1
+  assert(b.ask_price[0] == 1000100 && b.ask_qty[b.rows + 0] == 0);
+  assert(b.bid_qty[1] == 0 && b.ask_count[1] == 0); // MSFT is empty
+  assert(r.symbol(1) == "AAPL" && r.symbol(2) == "MSFT");
+  r.close();
+  std::filesystem::remove(path);
+}
+
+static void test_shm_feed() {
+  const std::string name = "/ob_test_feed";
+  ob::io::ShmPublisher pub;
+  assert(pub.create(name, ob::io::ShmFeedConfig{.ring_capacity=4, .max_locates=8}));
+  ob::io::ShmSubscriber sub;
+  assert(sub.attach(name));
+
+  ob::OrderBook book;
+  book.add_symbol(1, "AAPL");
+  book.set_listener(&pub);
+  assert(book.apply(ob::AddEvent{.locate=1, .order_id=1, .side=ob::Side::Buy, .qty=100, .price=1000000}) == ob::Status::Ok);
+
+  ob::io::ShmUpdate u;
+  assert(sub.poll(&u) == ob::io::ShmSubscriber::Poll::Update);
+  assert(u.kind == ob::io::ShmRecordKind::Level && u.side == ob::Side::Buy && u.bid_qty == 100);
+  assert(sub.poll(&u) == ob::io::ShmSubscriber::Poll::Update);
+  assert(u.kind == ob::io::ShmRecordKind::Bbo && u.bid_price == 1000000 && u.ask_qty == 0);
+  assert(sub.poll(&u) == ob::io::ShmSubscriber::Poll::Empty);
+
+  // Deeper bid: level record only, BBO unchanged.
+  assert(book.apply(ob::AddEvent{.locate=1, .order_id=2, .side=ob::Side::Buy, .qty=10, .price=999900}) == ob::Status::Ok);
+  assert(sub.poll(&u) == ob::io::ShmSubscriber::Poll::Update && u.kind == ob::io::ShmRecordKind::Level);
+  assert(sub.poll(&u) == ob::io::ShmSubscriber::Poll::Empty);
+
+  // Lap the 4-slot ring; the reader must see an overrun and resync from the table.
+  for (ob::OrderId id = 10; id < 14; ++id) {
+    assert(book.apply(ob::AddEvent{.locate=1, .order_id=id, .side=ob::Side::Sell, .qty=5, .price=1000100}) == ob::Status::Ok);
+  }
+  assert(sub.poll(&u) == ob::io::ShmSubscriber::Poll::Overrun && sub.overruns() == 1);
+  sub.resync();
+  ob::io::ShmSymbolSnapshot snap;
+  assert(sub.read_state(1, &snap));
+  assert(snap.last_seq == pub.published());
+  assert(snap.bid_levels == 2 && snap.bids[0].qty == 100 && snap.bids[1].price == 999900);
+  assert(snap.ask_levels == 1 && snap.asks[0].qty == 20 && snap.asks[0].count == 4);
+  assert(sub.poll(&u) == ob::io::ShmSubscriber::Poll::Empty);
+
+  // A restarted publisher gets a fresh, here smaller, segment. The attached reader sees
+  // an overrun rather than a rewound sequence, and resync() moves it over.
+  ob::io::ShmPublisher restarted;
+  assert(restarted.create(name, ob::io::ShmFeedConfig{.ring_capacity=2, .max_locates=4}));
+  pub.close(false); // the name is the new segment's now
+  assert(!sub.read_state(1, &snap));
+  assert(sub.poll(&u) == ob::io::ShmSubscriber::Poll::Overrun && sub.overruns() == 2);
+  sub.resync();
+  assert(sub.read_state(1, &snap) && snap.last_seq == 0 && snap.bid_levels == 0);
+  book.set_listener(&restarted);
+  assert(book.apply(ob::AddEvent{.locate=1, .order_id=20, .side=ob::Side::Sell, .qty=5, .price=1000100}) == ob::Status::Ok);
+  assert(sub.poll(&u) == ob::io::ShmSubscriber::Poll::Update && u.seq == 1 && u.kind == ob::io::ShmRecordKind::Level);
+  assert(sub.poll(&u) == ob::io::ShmSubscriber::Poll::Update && u.kind == ob::io::ShmRecordKind::Bbo);
+  assert(u.ask_price == 1000100 && u.ask_qty == 25);
+
+  book.set_listener(nullptr);
+  sub.detach();
+  restarted.close();
+}
+
+static void test_conflation() {
+  ob::OrderBook book;
+  book.add_symbol(1, "AAPL");
+  book.add_symbol(2, "MSFT");
+  ob::ConflatingPublisher pub;
+  book.set_listener(&pub);
+
+  std::vector<ob::ConflatedUpdate> fast_seen, slow_seen;
+  auto fast = pub.add_consumer(0, [&](std::span<const ob::ConflatedUpdate> b) {
+    fast_seen.insert(fast_seen.end(), b.begin(), b.end());
+  });
+  auto slow = pub.add_consumer(1000, [&](std::span<const ob::ConflatedUpdate> b) {
+    slow_seen.insert(slow_seen.end(), b.begin(), b.end());
+  });
+
+  // Five BBO changes on AAPL, one on MSFT, one deep-level change that leaves the BBO alone.
+  for (ob::OrderId id = 1; id <= 5; ++id) {
+    assert(book.apply(ob::AddEvent{.locate=1, .order_id=id, .side=ob::Side::Buy, .qty=10,
+                                   .price=static_cast<ob::Price>(1000000 + id)}) == ob::Status::Ok);
+    pub.poll(id); // fast consumer drains every time, slow one only once
+  }
+  assert(book.apply(ob::AddEvent{.locate=2, .order_id=9, .side=ob::Side::Sell, .qty=10, .price=2000000}) == ob::Status::Ok);
+  assert(book.apply(ob::AddEvent{.locate=1, .order_id=6, .side=ob::Side::Buy, .qty=10, .price=900000}) == ob::Status::Ok);
+  pub.poll(6);
+
+  assert(fast_seen.size() == 6 && pub.stats(fast).delivered == pub.stats(fast).changes);
+  assert(pub.pending(slow) == 2 && slow_seen.size() == 1);
+  pub.poll(1001);
+  assert(slow_seen.size() == 3);
+  assert(slow_seen[1].locate == 1 && slow_seen[1].merged == 4 && slow_seen[1].top.bid.price == 1000005);
+  assert(slow_seen[2].locate == 2 && slow_seen[2].top.has_ask && !slow_seen[2].top.has_bid);
+  assert(pub.stats(slow).changes == 6 && pub.stats(slow).delivered == 3);
+}
+
+static void test_top_table_scans() {
+  ob::OrderBook book;
+  for (ob::StockLocate loc = 1; loc <= 9; ++loc) book.add_symbol(loc, "S" + std::to_string(loc));
+  ob::OrderId id = 1;
+  auto quote = [&](ob::StockLocate loc, ob::Price bid, ob::Price ask) {
+    assert(book.apply(ob::AddEvent{.locate=loc, .order_id=id++, .side=ob::Side::Buy, .qty=100, .price=bid}) == ob::Status::Ok);
+    assert(book.apply(ob::AddEvent{.locate=loc, .order_id=id++, .side=ob::Side::Sell, .qty=100, .price=ask}) == ob::Status::Ok);
+  };
+  for (ob::StockLocate loc = 1; loc <= 9; ++loc) quote(loc, 1000000, 1000100);
+  book.apply(ob::AddEvent{.locate=3, .order_id=id++, .side=ob::Side::Sell, .qty=5, .price=1000000}); // locked
+  book.apply(ob::AddEvent{.locate=8, .order_id=id++, .side=ob::Side::Buy, .qty=5, .price=1000200});  // crossed
+  book.apply(ob::AddEvent{.locate=4, .order_id=id++, .side=ob::Side::Buy, .qty=5, .price=999000});   // not at top
+
+  const ob::TopTable& t = book.tops();
+  assert(t.size() == 10 && t.bid_price()[8] == 1000200 && t.bid_qty()[4] == 100);
+
+  std::vector<ob::StockLocate> hits;
+  assert(t.scan_crossed_or_locked(&hits) == 2 && hits[0] == 3 && hits[1] == 8);
+
+  assert(t.scan_spread_over(50, &hits) == 7);
+  // Locate 9 sits in the scalar tail; once one-sided it must drop out.
+  book.apply(ob::DeleteEvent{.locate=9, .order_id=17});
+  assert(t.scan_spread_over(50, &hits) == 6);
+
+  book.mark_top_reference();
+  book.apply(ob::AddEvent{.locate=5, .order_id=id++, .side=ob::Side::Buy, .qty=5, .price=1000050});
+  book.apply(ob::AddEvent{.locate=2, .order_id=id++, .side=ob::Side::Sell, .qty=5, .price=1000090});
+  assert(t.top_movers(2, &hits) == 2 && hits[0] == 5 && hits[1] == 2);
+}
+
+static void test_directory_and_capacity() {
+  ob::CapacityProfile profile;
+  profile.set("AAPL", ob::SymbolCapacity{.orders=1000, .levels=50});
+
+  ob::OrderBook book;
+  book.set_capacity_profile(profile, 1.0);
+  assert(book.apply(ob::StockDirectoryEvent{.locate=3, .symbol="AAPL"}) == ob::Status::Ok);
+  assert(book.apply(ob::StockDirectoryEvent{.locate=4, .symbol="ZZZZ"}) == ob::Status::Ok);
+  assert(book.apply(ob::StockDirectoryEvent{.locate=3, .symbol="AAPL"}) == ob::Status::Ok);
+
+  ob::SymbolBook* sb = book.find(3);
+  assert(sb && sb->symbol() == "AAPL" && sb->order_capacity() == 1000);
+  assert(book.find(4) && book.find(4)->order_capacity() == 0);
+
+  const std::size_t buckets = sb->order_buckets();
+  for (ob::OrderId id = 1; id <= 1000; ++id) {
+    assert(book.apply(ob::AddEvent{.locate=3, .order_id=id, .side=ob::Side::Buy, .qty=1,
+                                   .price=static_cast<ob::Price>(1000000 + id % 20)}) == ob::Status::Ok);
+  }
+  assert(sb->order_buckets() == buckets && sb->order_capacity() == 1000);
+  assert(sb->validate());
+
+  ob::CapacityProfile today = book.capacity_profile();
+  const ob::SymbolCapacity* c = today.find("AAPL");
+  assert(c && c->orders == 1000 && c->levels == 20);
+
+  auto path = (std::filesystem::temp_directory_path() / "ob_test_capacity.txt").string();
+  assert(today.save(path));
+  ob::CapacityProfile loaded;
+  assert(loaded.load(path) && loaded.size() == 2 && loaded.find("AAPL")->levels == 20);
+  std::filesystem::remove(path);
+}
+
+static void test_level_backends_agree() {
+  ob::OrderBook book;
+  book.add_symbol(1, "MAP", ob::LevelBackend::Map);
+  book.add_symbol(2, "FLAT", ob::LevelBackend::Flat);
+  assert(book.find(1)->backend() == ob::LevelBackend::Map);
+  assert(book.find(2)->backend() == ob::LevelBackend::Flat);
+
+  // Same random flow into both books; wide enough to push Flat past its linear probe.
+  std::mt19937 rng(7);
+  std::vector<ob::OrderId> live;
+  for (ob::OrderId id = 1; id < 4000; ++id) {
+    if (live.empty() || rng() % 3 != 0) {
+      ob::Side side = (rng() % 2) ? ob::Side::Buy : ob::Side::Sell;
+      ob::Price off = static_cast<ob::Price>(1 + rng() % 40) * 100;
+      ob::Price px = (side == ob::Side::Buy) ? 1000000 - off : 1000000 + off;
+      for (ob::StockLocate loc : {1, 2}) {
+        assert(book.apply(ob::AddEvent{.locate=loc, .order_id=id, .side=side, .qty=10, .price=px}) == ob::Status::Ok);
+      }
+      live.push_back(id);
+    } else {
+      std::size_t i = rng() % live.size();
+      for (ob::StockLocate loc : {1, 2}) {
+        assert(book.apply(ob::DeleteEvent{.locate=loc, .order_id=live[i]}) == ob::Status::Ok);
+      }
+      live[i] = live.back();
+      live.pop_back();
+    }
+  }
+
+  for (ob::Side side : {ob::Side::Buy, ob::Side::Sell}) {
+    auto a = book.find(1)->depth(side, 100);
+    auto b = book.find(2)->depth(side, 100);
+    assert(a.size() == b.size() && a.size() > ob::FlatLevels<ob::DescBid>::kLinearProbe);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      assert(a[i].price == b[i].price && a[i].qty == b[i].qty && a[i].count == b[i].count);
+    }
+  }
+  assert(book.find(1)->validate() && book.find(2)->validate());
+
+  // Registry: explicit choice beats the profile heuristic.
+  ob::CapacityProfile profile;
+  profile.set("THIN", ob::SymbolCapacity{.orders=10, .levels=8});
+  profile.set("WIDE", ob::SymbolCapacity{.orders=10, .levels=5000});
+  book.set_capacity_profile(profile);
+  book.set_backend("WIDE2", ob::LevelBackend::Flat);
+  assert(book.backend_for("THIN") == ob::LevelBackend::Flat);
+  assert(book.backend_for("WIDE") == ob::LevelBackend::Map);
+  assert(book.backend_for("WIDE2") == ob::LevelBackend::Flat);
+  assert(book.backend_for("OTHER") == ob::LevelBackend::Map);
+}
+
+static void test_book_memory() {
+  ob::CountingResource upstream;
+  ob::OrderBook book;
+  book.set_memory(ob::BookMemory::PerSymbol, &upstream);
+  ob::CapacityProfile profile;
+  profile.set("AAA", ob::SymbolCapacity{.orders=1000, .levels=64});
+  book.set_capacity_profile(profile, 1.0);
+  book.add_symbol(1, "AAA", ob::LevelBackend::Map);
+  book.add_symbol(2, "BBB", ob::LevelBackend::Flat);
+  assert(book.find(1)->resource() != book.find(2)->resource());
+
+  // Within the reserved capacity the session never reaches the upstream allocator.
+  upstream.reset_counts();
+  for (int round = 0; round < 3; ++round) {
+    for (ob::OrderId id = 1; id <= 800; ++id) {
+      ob::Side side = (id % 2) ? ob::Side::Buy : ob::Side::Sell;
+      ob::Price off = static_cast<ob::Price>(1 + id % 30) * 100;
+      ob::Price px = (side == ob::Side::Buy) ? 1000000 - off : 1000000 + off;
+      assert(book.apply(ob::AddEvent{.locate=1, .order_id=id, .side=side, .qty=10, .price=px}) == ob::Status::Ok);
+    }
+    for (ob::OrderId id = 1; id <= 800; ++id) {
+      assert(book.apply(ob::DeleteEvent{.locate=1, .order_id=id}) == ob::Status::Ok);
+    }
+  }
+  assert(upstream.allocations() == 0);
+  assert(book.find(1)->validate());
+
+  std::pmr::monotonic_buffer_resource scratch;
+  auto d = book.find(1)->depth(ob::Side::Buy, 5, &scratch);
+  assert(d.empty() && d.get_allocator().resource() == &scratch);
+
+  ob::OrderBook shared;
+  shared.set_memory(ob::BookMemory::Shared, &upstream);
+  shared.add_symbol(1, "AAA");
+  shared.add_symbol(2, "BBB");
+  assert(shared.find(1)->resource() == shared.find(2)->resource());
+
+  ob::OrderBook global;
+  global.set_memory(ob::BookMemory::Global, &upstream);
+  global.add_symbol(1, "AAA");
+  assert(global.find(1)->resource() == &upstream);
+}
+
+static void test_reset() {
+  ob::CountingResource upstream;
+  ob::OrderBook book;
+  book.set_memory(ob::BookMemory::PerSymbol, &upstream);
+  book.add_symbol(1, "MAP", ob::LevelBackend::Map);
+  book.add_symbol(2, "FLAT", ob::LevelBackend::Flat);
+
+  std::vector<ob::ConflatedUpdate> seen;
+  ob::ConflatingPublisher pub;
+  pub.add_consumer(0, [&](std::span<const ob::ConflatedUpdate> b) { seen.assign(b.begin(), b.end()); });
+  book.set_listener(&pub);
+
+  auto fill = [&] {
+    for (ob::StockLocate loc : {1, 2}) {
+      for (ob::OrderId id = 1; id <= 500; ++id) {
+        ob::Side side = (id % 2) ? ob::Side::Buy : ob::Side::Sell;
+        ob::Price off = static_cast<ob::Price>(1 + id % 50) * 100;
+        ob::Price px = (side == ob::Side::Buy) ? 1000000 - off : 1000000 + off;
+        assert(book.apply(ob::AddEvent{.locate=loc, .order_id=id, .side=side, .qty=10, .price=px}) == ob::Status::Ok);
+      }
+    }
+  };
+  fill();
+  const std::size_t capacity = book.find(2)->order_capacity();
+  pub.flush(0, 0);
+
+  assert(book.reset(1) == ob::Status::Ok);
+  assert(book.reset(9) == ob::Status::UnknownSymbol);
+  assert(book.find(1)->order_count() == 0 && book.find(1)->level_count(ob::Side::Buy) == 0);
+  assert(book.find(2)->order_count() == 500);
+  assert(book.tops().bid_price()[1] == 0 && book.tops().bid_price()[2] != 0);
+  pub.flush(0, 1);
+  assert(seen.size() == 1 && seen[0].locate == 1 && !seen[0].top.has_bid && !seen[0].top.has_ask);
+
+  book.reset();
+  for (ob::StockLocate loc : {1, 2}) {
+    const ob::SymbolBook* b = book.find(loc);
+    assert(b->order_count() == 0 && b->level_count(ob::Side::Sell) == 0 && b->validate());
+    assert(b->peak_orders() == 500);
+  }
+  assert(book.find(2)->order_capacity() == capacity);
+
+  // Warm after reset: the same ids come back without touching the upstream allocator.
+  upstream.reset_counts();
+  fill();
+  assert(upstream.allocations() == 0);
+  assert(book.find(1)->validate() && book.find(2)->validate());
+  assert(book.find(1)->depth(ob::Side::Buy, 100).size() == book.find(2)->depth(ob::Side::Buy, 100).size());
+}
+
+static void test_journal_roundtrip() {
+  const std::string path = (std::filesystem::temp_directory_path() / "ob_test.objrnl").string();
+  ob::OrderBook direct;
+  ob::io::JournalWriter w;
+  assert(w.open(path, ob::io::JournalConfig{.block_records=4}));
+
+  std::uint64_t ts = 1000;
+  auto both = [&](const auto& e) {
+    w.append(ts++, e);
+    direct.apply(e);
+  };
+  both(ob::StockDirectoryEvent{.locate=1, .symbol="AAPL"});
+  both(ob::StockDirectoryEvent{.locate=2, .symbol="MSFT"});
+  both(ob::StockDirectoryEvent{.locate=3, .symbol="SPY"});
+  for (ob::OrderId id = 1; id <= 30; ++id) {
+    ob::StockLocate loc = static_cast<ob::StockLocate>(1 + id % 3);
+    both(ob::AddEvent{.locate=loc, .order_id=id, .side=(id % 2) ? ob::Side::Buy : ob::Side::Sell,
+                      .qty=100, .price=static_cast<ob::Price>(10000 + (id % 2 ? -1 : 1) * static_cast<ob::Price>(id)),
+                      .mpid=0x4D50, .has_mpid=(id == 7)});
+  }
+  both(ob::CancelEvent{.locate=2, .order_id=1, .cancel_qty=40});
+  both(ob::ExecuteEvent{.locate=3, .order_id=2, .exec_qty=100});
+  both(ob::DeleteEvent{.locate=1, .order_id=3});
+  both(ob::ReplaceEvent{.locate=2, .old_order_id=4, .new_order_id=100, .new_qty=50, .new_price=10010});
+  // Locate 3 only appears at the start and end of the day.
+  for (ob::OrderId id = 200; id < 240; ++id) {
+    both(ob::AddEvent{.locate=1, .order_id=id, .side=ob::Side::Buy, .qty=1, .price=9000});
+  }
+  both(ob::DeleteEvent{.locate=3, .order_id=5});
+  assert(w.close());
+
+  ob::io::JournalReader r;
+  assert(r.open(path));
+  assert(r.records().size() == w.records() && r.records()[0].timestamp == 1000);
+
+  ob::OrderBook full;
+  assert(r.replay(full) == w.records());
+  ob::OrderBook only3;
+  r.replay(only3, 3);
+  assert(only3.locates().size() == 1 && only3.find(3)->symbol() == "SPY");
+  assert(r.blocks_for(3).size() < r.block_count() && r.blocks_for(9).empty());
+
+  auto same_book = [](const ob::SymbolBook& a, const ob::SymbolBook& b) {
+    assert(a.symbol() == b.symbol() && a.order_count() == b.order_count());
+    for (ob::Side side : {ob::Side::Buy, ob::Side::Sell}) {
+      auto da = a.depth(side, 100);
+      auto db = b.depth(side, 100);
+      assert(da.size() == db.size());
+      for (std::size_t i = 0; i < da.size(); ++i) {
+        assert(da[i].price == db[i].price && da[i].qty == db[i].qty && da[i].count == db[i].count);
+      }
+    }
+  };
+  for (ob::StockLocate loc : {1, 2, 3}) same_book(*full.find(loc), *direct.find(loc));
+  same_book(*only3.find(3), *direct.find(3));
+
+  r.close();
+  std::filesystem::remove(path);
+}
+
+static void test_as_of_checkpoints() {
+  const auto dir = std::filesystem::temp_directory_path();
+  const std::string jpath = (dir / "ob_test_asof.objrnl").string();
+  const std::string cpath = (dir / "ob_test_asof.obckpt").string();
+
+  ob::io::JournalWriter w;
+  assert(w.open(jpath, ob::io::JournalConfig{.block_records=64}));
+  w.append(1, ob::StockDirectoryEvent{.locate=1, .symbol="AAPL"});
+  w.append(1, ob::StockDirectoryEvent{.locate=2, .symbol="MSFT"});
+  std::mt19937 rng(11);
+  std::vector<std::pair<ob::StockLocate, ob::OrderId>> live;
+  std::uint64_t ts = 10;
+  for (ob::OrderId id = 1; id < 3000; ++id) {
+    ts += rng() % 50;
+    if (live.empty() || rng() % 3 != 0) {
+      ob::StockLocate loc = static_cast<ob::StockLocate>(1 + rng() % 2);
+      ob::Side side = (rng() % 2) ? ob::Side::Buy : ob::Side::Sell;
+      ob::Price px = (side == ob::Side::Buy) ? 1000 - static_cast<ob::Price>(rng() % 5)
+                                             : 1001 + static_cast<ob::Price>(rng() % 5);
+      w.append(ts, ob::AddEvent{.locate=loc, .order_id=id, .side=side, .qty=100, .price=px});
+      live.emplace_back(loc, id);
+    } else {
+      std::size_t i = rng() % live.size();
+      if (rng() % 2) {
+        w.append(ts, ob::DeleteEvent{.locate=live[i].first, .order_id=live[i].second});
+      } else {
+        w.append(ts, ob::ReplaceEvent{.locate=live[i].first, .old_order_id=live[i].second,
+                                      .new_order_id=id + 100000, .new_qty=50, .new_price=1000});
+        live.emplace_back(live[i].first, id + 100000);
+      }
+      live[i] = live.back();
+      live.pop_back();
+    }
+  }
+  assert(w.close());
+
+  ob::io::JournalReader j;
+  assert(j.open(jpath));
+  assert(ob::io::build_checkpoints(j, cpath, 5000));
+  ob::io::CheckpointReader c;
+  assert(c.open(cpath, j) && c.checkpoint_count() > 10);
+
+  auto l3 = [](const ob::SymbolBook& b) {
+    std::vector<std::pair<ob::OrderId, ob::Qty>> out;
+    for (ob::Side side : {ob::Side::Buy, ob::Side::Sell}) {
+      b.for_each_level(side, [&](const ob::Level& l) {
+        for (const ob::Order* o = l.head; o; o = o->next) out.emplace_back(o->order_id, o->qty);
+        return true;
+      });
+    }
+    return out;
+  };
+
+  ob::OrderBook asof;
+  for (std::uint64_t t : {std::uint64_t{5}, std::uint64_t{4999}, std::uint64_t{5000}, ts / 3, ts / 2 + 7, ts}) {
+    ob::OrderBook full;
+    for (const auto& r : j.records()) {
+      if (r.timestamp > t) break;
+      ob::io::visit_journal_event(r, [&](const auto& e) { full.apply(e); });
+    }
+    for (ob::StockLocate loc : {1, 2}) {
+      ob::io::AsOfStats st;
+      bool ok = c.book_at(loc, t, asof, &st);
+      assert(ok == (full.find(loc) != nullptr));
+      if (!ok) continue;
+      assert(l3(*asof.find(loc)) == l3(*full.find(loc)));
+      assert(asof.find(loc)->validate());
+      if (t >= 10000) assert(st.checkpoint_ts > 0 && st.checkpoint_ts <= t);
+    }
+  }
+  // The reused book still registers both symbols; before their directory records it
+  // must not pass for a book as of that time.
+  const bool before_directory = c.book_at(1, 0, asof);
+  assert(!before_directory);
+
+  c.close();
+  j.close();
+  std::filesystem::remove(jpath);
+  std::filesystem::remove(cpath);
+}
+
+static void test_batch_replay() {
+  const auto dir = std::filesystem::temp_directory_path() / "ob_test_batch";
+  std::filesystem::create_directories(dir);
+  auto write_day = [&](const char* name, int adds) {
+    std::ofstream out(dir / name, std::ios::binary);
+    for (int i = 0; i < adds; ++i) {
+      std::uint8_t m[] = {'A', 0, 7, 0, 0, 1, 2, 3, 4, 5, 6,
+                          0, 0, 0, 0, 0, 0, 0, static_cast<std::uint8_t>(i), 'S', 0, 0, 0x01, 0x2C,
+                          'M', 'S', 'F', 'T', ' ', ' ', ' ', ' ', 0x00, 0x30, 0xD9, 0xDC};
+      out.write(reinterpret_cast<const char*>(m), sizeof(m));
+    }
+  };
+  write_day("d1.itch", 10);
+  write_day("d2.itch", 50);
+  write_day("d3.itch", 20);
+
+  auto files = ob::ingest::expand_file_args({(dir / "*.itch").string(), (dir / "missing.itch").string()});
+  assert(files.size() == 4);
+
+  std::vector<ob::ingest::FileResult> results;
+  ob::ingest::BatchConfig cfg;
+  cfg.threads = 2;
+  cfg.memory_budget = 1; // smaller than any file: admissions run one at a time
+  auto sum = ob::ingest::replay_files(files, cfg, [&](const ob::ingest::FileResult& r) { results.push_back(r); });
+
+  assert(results.size() == 4 && sum.files == 4 && sum.failed == 1 && sum.threads == 2);
+  assert(sum.messages == 80 && sum.bytes == 80 * 36);
+  assert(sum.peak_budget_bytes >= 2 * 50 * 36); // the largest file went first at the initial ratio
+  for (const auto& r : results) {
+    if (r.path.ends_with("missing.itch")) {
+      assert(!r.ok);
+    } else {
+      assert(r.ok && r.events == r.messages);
+    }
+  }
+  std::filesystem::remove_all(dir);
+}
+
+static void test_spsc_ring_and_pipeline() {
+  ob::SpscRing<std::uint64_t> ring(8);
+  assert(ring.capacity() == 8);
+  std::thread producer([&] {
+    for (std::uint64_t i = 1; i <= 100000; ++i) ring.push(std::uint64_t{i});
+  });
+  std::uint64_t expect = 1;
+  while (expect <= 100000) {
+    std::uint64_t v;
+    if (ring.try_pop(&v)) {
+      assert(v == expect);
+      ++expect;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  assert(ring.size() == 0 && ring.pushed() == 100000 && ring.high_water() <= 8);
+
+  // Directory + 200 adds for locate 7, split across two frames.
+  std::vector<std::uint8_t> r = {'R', 0, 7, 0, 0, 0, 0, 0, 0, 0, 0, 'M', 'S', 'F', 'T', ' ', ' ', ' ', ' '};
+  r.resize(39, 0);
+  std::vector<std::vector<std::uint8_t>> frames(2);
+  frames[0] = r;
+  for (int i = 0; i < 200; ++i) {
+    std::uint8_t m[] = {'A', 0, 7, 0, 0, 0, 0, 0, 0, 0, static_cast<std::uint8_t>(i),
+                        0, 0, 0, 0, 0, 0, static_cast<std::uint8_t>(i >> 8), static_cast<std::uint8_t>(i),
+                        (i % 2) ? std::uint8_t{'S'} : std::uint8_t{'B'}, 0, 0, 0x01, 0x2C,
+                        'M', 'S', 'F', 'T', ' ', ' ', ' ', ' ', 0x00, 0x30, 0xD9, static_cast<std::uint8_t>(i)};
+    frames[i < 100 ? 0 : 1].insert(frames[i < 100 ? 0 : 1].end(), m, m + sizeof(m));
+  }
+
+  ob::ingest::PipelineConfig cfg;
+  cfg.event_ring = 16; // small enough to make the decoder wait on the book
+  ob::ingest::IngestPipeline pipeline(cfg);
+  std::size_t next = 0;
+  bool recycled = false;
+  pipeline.start([&](std::vector<std::uint8_t>* payload) {
+    if (next == frames.size()) {
+      recycled = payload->capacity() >= frames[0].size(); // frame 0's buffer, back from the decoder
+      return false;
+    }
+    if (next == 1) {
+      // Let the decoder finish frame 0 so its buffer is back before the final call.
+      const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+      while (pipeline.stats().messages < 101 && std::chrono::steady_clock::now() < give_up) {
+        std::this_thread::yield();
+      }
+    }
+    payload->assign(frames[next].begin(), frames[next].end());
+    ++next;
+    return true;
+  });
+  ob::OrderBook book;
+  std::uint64_t last_ts = 0;
+  pipeline.drain([&](std::uint64_t ts, const auto& e) {
+    assert(ts >= last_ts);
+    last_ts = ts;
+    assert(book.apply(e) == ob::Status::Ok);
+  });
+
+  auto st = pipeline.stats();
+  assert(st.messages == 201 && st.events_applied == 201 && st.events.pushed == 201);
+  assert(st.frames.pushed == 2 && st.events.high_water <= 16 && recycled);
+  assert(pipeline.type_counts()['A'] == 200 && pipeline.type_counts()['R'] == 1);
+  assert(book.find(7) && book.find(7)->symbol() == "MSFT" && book.find(7)->order_count() == 200);
+  assert(book.find(7)->validate());
+}
+
+static void test_capture_roundtrip() {
+  const auto path = (std::filesystem::temp_directory_path() / "ob_test.cap").string();
+  ob::io::CaptureConfig cfg;
+  cfg.chunk_bytes = 4096;  // records straddle chunks
+  cfg.roll_bytes = 20000;  // several files
+  cfg.ring_chunks = 4;
+  ob::io::CaptureWriter w;
+  assert(w.open(path, cfg));
+  std::vector<std::uint8_t> payload;
+  for (std::uint32_t i = 0; i < 500; ++i) {
+    payload.assign(i % 301, static_cast<std::uint8_t>(i));
+    w.record(i % 7 ? 'S' : 'H', payload.data(), payload.size(), 1000 + i);
+  }
+  assert(w.close());
+  auto st = w.stats();
+  assert(st.records == 500 && st.files > 2);
+
+  std::uint32_t next = 0;
+  for (std::uint64_t part = 0; part < st.files; ++part) {
+    std::ifstream in(part == 0 ? path : path + "." + std::to_string(part), std::ios::binary);
+    std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(ob::io::is_capture_file(data.data(), data.size()));
+    bool ok = ob::io::for_each_capture_record(data.data(), data.size(),
+        [&](const ob::io::CaptureRecordHeader& h, std::span<const std::uint8_t> p) {
+          assert(h.recv_ns == 1000 + next && h.type == (next % 7 ? 'S' : 'H'));
+          assert(p.size() == next % 301);
+          for (std::uint8_t b : p) assert(b == static_cast<std::uint8_t>(next));
+          ++next;
+        });
+    assert(ok);
+    std::filesystem::remove(part == 0 ? path : path + "." + std::to_string(part));
+  }
+  assert(next == 500);
+
+  // The last record fills a file exactly to the roll size: no empty part follows it.
+  cfg.roll_bytes = sizeof(ob::io::CaptureFileHeader) + 2 * (sizeof(ob::io::CaptureRecordHeader) + 8);
+  assert(w.open(path, cfg));
+  for (std::uint32_t i = 0; i < 4; ++i) w.record('S', payload.data(), 8, i);
+  assert(w.close() && w.stats().files == 2);
+  assert(std::filesystem::file_size(path + ".1") == cfg.roll_bytes);
+  assert(!std::filesystem::exists(path + ".2"));
+  std::filesystem::remove(path);
+  std::filesystem::remove(path + ".1");
+}
+
+static void test_consolidated_nbbo() {
+  struct Counts final : ob::BookListener {
+    int levels = 0;
+    int resets = 0;
+    int trades = 0;
+    void on_level(const ob::SymbolBook&, const ob::LevelUpdate&) override { ++levels; }
+    void on_reset(const ob::SymbolBook&) override { ++resets; }
+    void on_trade(const ob::SymbolBook&, const ob::TradeUpdate&) override { ++trades; }
+  };
+  ob::ConsolidatedBook cons(3);
+  ob::OrderBook venue[3];
+  Counts venue0;
+  cons.set_next(0, &venue0);
+  for (int v = 0; v < 3; ++v) {
+    venue[v].set_listener(cons.venue_listener(v));
+    venue[v].add_symbol(static_cast<ob::StockLocate>(10 + v), "MSFT"); // locates differ per venue
+  }
+  std::vector<ob::Nbbo> seen;
+  cons.set_nbbo_callback([&](ob::ConsolidatedId, const ob::Nbbo& n) { seen.push_back(n); });
+  auto add = [&](int v, ob::OrderId id, ob::Side side, ob::Qty qty, ob::Price px) {
+    assert(venue[v].apply(ob::AddEvent{.locate=static_cast<ob::StockLocate>(10 + v), .order_id=id, .side=side,
+                                       .qty=qty, .price=px}) == ob::Status::Ok);
+  };
+
+  add(0, 1, ob::Side::Buy, 100, 1000);
+  add(1, 1, ob::Side::Buy, 200, 1000);
+  add(2, 1, ob::Side::Buy, 300, 999);
+  add(0, 2, ob::Side::Sell, 50, 1002);
+  add(2, 2, ob::Side::Sell, 70, 1001);
+  add(1, 2, ob::Side::Sell, 10, 1003); // behind the NBO: no NBBO change
+
+  ob::ConsolidatedId id;
+  assert(cons.size() == 1 && cons.find("MSFT", &id) && cons.symbol(id) == "MSFT");
+  const ob::Nbbo& n = cons.nbbo(id);
+  assert(n.has_bid && n.bid == 1000 && n.bid_qty == 300 && n.bid_venues == 0b011);
+  assert(n.has_ask && n.ask == 1001 && n.ask_qty == 70 && n.ask_venues == 0b100);
+  assert(seen.size() == 4 && cons.stats().updates == 6 && cons.stats().nbbo_changes == 4);
+
+  ob::ConsolidatedLevel lv[4];
+  assert(cons.depth(id, ob::Side::Buy, lv, 4) == 2);
+  assert(lv[0].price == 1000 && lv[0].qty == 300 && lv[0].count == 2 && lv[1].price == 999);
+  assert(cons.depth(id, ob::Side::Sell, lv, 4) == 3 && lv[2].price == 1003);
+
+  // A partial cancel on one venue moves only that venue's share.
+  assert(venue[1].apply(ob::CancelEvent{.locate=11, .order_id=1, .cancel_qty=150}) == ob::Status::Ok);
+  assert(cons.nbbo(id).bid_qty == 150 && cons.nbbo(id).bid_venues == 0b011);
+  assert(venue[0].apply(ob::DeleteEvent{.locate=10, .order_id=1}) == ob::Status::Ok);
+  assert(venue[1].apply(ob::DeleteEvent{.locate=11, .order_id=1}) == ob::Status::Ok);
+  assert(cons.nbbo(id).bid == 999 && cons.nbbo(id).bid_qty == 300 && cons.nbbo(id).bid_venues == 0b100);
+
+  // Resetting one venue removes its contribution only.
+  assert(venue[2].reset(12) == ob::Status::Ok);
+  assert(!cons.nbbo(id).has_bid && cons.nbbo(id).ask == 1002 && cons.nbbo(id).ask_venues == 0b001);
+  assert(cons.level_count(id, ob::Side::Buy) == 0 && cons.level_count(id, ob::Side::Sell) == 2);
+
+  // Venue 0's own downstream listener still sees every callback of that venue.
+  assert(venue[0].apply(ob::ExecuteEvent{.locate=10, .order_id=2, .exec_qty=10}) == ob::Status::Ok);
+  assert(venue[0].reset(10) == ob::Status::Ok);
+  assert(venue0.levels == 4 && venue0.trades == 1 && venue0.resets == 1);
+}
+
+static void test_integrity_checker() {
+  ob::IntegrityConfig cfg;
+  cfg.sample_every = 8;
+  cfg.slice_levels = 3;
+  cfg.max_overhead = 1.0; // never throttle in the test
+  ob::IntegrityChecker checker(cfg);
+  ob::ConflatingPublisher downstream;
+  checker.set_next(&downstream);
+  std::size_t seen = 0;
+  downstream.add_consumer(0, [&](std::span<const ob::ConflatedUpdate> b) { seen += b.size(); });
+
+  for (ob::LevelBackend backend : {ob::LevelBackend::Map, ob::LevelBackend::Flat}) {
+    ob::OrderBook book;
+    book.set_listener(&checker);
+    book.add_symbol(1, "AAPL", backend);
+    std::mt19937 rng(5);
+    std::vector<ob::OrderId> live;
+    for (ob::OrderId id = 1; id <= 3000; ++id) {
+      if (!live.empty() && rng() % 3 == 0) {
+        std::size_t i = rng() % live.size();
+        assert(book.apply(ob::DeleteEvent{.locate=1, .order_id=live[i]}) == ob::Status::Ok);
+        live[i] = live.back();
+        live.pop_back();
+        continue;
+      }
+      const bool buy = rng() & 1;
+      const ob::Price px = buy ? 1000 - static_cast<ob::Price>(rng() % 40) : 1001 + static_cast<ob::Price>(rng() % 40);
+      assert(book.apply(ob::AddEvent{.locate=1, .order_id=id, .side=buy ? ob::Side::Buy : ob::Side::Sell,
+                                     .qty=100, .price=px}) == ob::Status::Ok);
+      live.push_back(id);
+    }
+    downstream.poll(0);
+  }
+  const ob::IntegrityStats clean = checker.stats();
+  assert(clean.violations() == 0 && seen > 0);
+  assert(clean.slices > 0 && clean.slices <= clean.updates / 8 + 2 && clean.levels_checked > 0);
+
+  // O(1) checks: a crossing order is flagged on the change that crosses.
+  ob::OrderBook book;
+  book.set_listener(&checker);
+  book.add_symbol(2, "MSFT");
+  assert(book.apply(ob::AddEvent{.locate=2, .order_id=1, .side=ob::Side::Sell, .qty=10, .price=500}) == ob::Status::Ok);
+  assert(book.apply(ob::AddEvent{.locate=2, .order_id=2, .side=ob::Side::Buy, .qty=10, .price=501}) == ob::Status::Ok);
+  assert(checker.stats().crossed == 1 && checker.stats().last_violation == 2);
+
+  // Slices: a level total that no longer matches its FIFO is found by the rotating walk.
+  auto* lvl = const_cast<ob::Level*>(book.find(2)->find_level(ob::Side::Buy, 501));
+  lvl->total_qty += 5;
+  checker.check_slice(*book.find(2));
+  checker.check_slice(*book.find(2));
+  assert(checker.stats().level_mismatch >= 1);
+  lvl->total_qty -= 5;
+  // Deep books: each slice resumes past the last price walked, even once that level is
+  // gone, so one rotation walks every level exactly once.
+  for (ob::LevelBackend backend : {ob::LevelBackend::Map, ob::LevelBackend::Flat}) {
+    ob::OrderBook deep;
+    deep.add_symbol(3, "DEEP", backend);
+    for (ob::OrderId i = 0; i < 30; ++i) {
+      const auto off = static_cast<ob::Price>(2 * i);
+      assert(deep.apply(ob::AddEvent{.locate=3, .order_id=1 + i, .side=ob::Side::Buy, .qty=1, .price=1000 - off}) ==
+             ob::Status::Ok);
+      assert(deep.apply(ob::AddEvent{.locate=3, .order_id=101 + i, .side=ob::Side::Sell, .qty=1, .price=1001 + off}) ==
+             ob::Status::Ok);
+    }
+    const ob::SymbolBook& b = *deep.find(3);
+    std::vector<ob::Price> after;
+    b.for_each_level_after(ob::Side::Buy, 991, [&](const ob::Level& l) {
+      after.push_back(l.price);
+      return after.size() < 3;
+    });
+    assert((after == std::vector<ob::Price>{990, 988, 986}));
+    after.clear();
+    b.for_each_level_after(ob::Side::Sell, 1055, [&](const ob::Level& l) { after.push_back(l.price); return true; });
+    assert((after == std::vector<ob::Price>{1057, 1059}));
+
+    ob::IntegrityChecker walker(ob::IntegrityConfig{.sample_every=0, .slice_levels=4});
+    walker.check_slice(b); // bids 1000, 998, 996, 994
+    assert(deep.apply(ob::DeleteEvent{.locate=3, .order_id=4}) == ob::Status::Ok); // 994, the cursor's price
+    for (int i = 0; i < 14; ++i) walker.check_slice(b);
+    assert(walker.stats().levels_checked == 60 && walker.stats().violations() == 0);
+  }
+}
+
+static void test_trade_bars() {
+  // 'C' carries its own price and printable flag; 'P' is a hidden print.
+  std::vector<std::uint8_t> c(ob::ingest::itch_message_size('C'), 0);
+  c[0] = 'C';
+  c[2] = 1;
+  c[19 + 3] = 50;  // executed shares
+  c[31] = 'N';
+  c[32 + 3] = 102; // execution price
+  ob::ingest::ItchMessageView msg;
+  std::size_t off = 0;
+  assert(ob::ingest::decode_next_itch(c.data(), c.size(), &off, &msg));
+  ob::ExecuteEvent ce;
+  assert(ob::ingest::decode_itch_execute(msg, &ce));
+  assert(ce.locate == 1 && ce.exec_qty == 50 && ce.has_price && ce.price == 102 && !ce.printable);
+  std::vector<std::uint8_t> p(ob::ingest::itch_message_size('P'), 0);
+  p[0] = 'P';
+  p[2] = 1;
+  p[19] = 'S';
+  p[20 + 3] = 40;
+  p[32 + 3] = 101;
+  off = 0;
+  assert(ob::ingest::decode_next_itch(p.data(), p.size(), &off, &msg));
+  ob::TradeEvent te;
+  assert(ob::ingest::decode_itch_trade(msg, &te));
+  assert(te.locate == 1 && te.side == ob::Side::Sell && te.qty == 40 && te.price == 101);
+
+  std::vector<ob::TradeBar> closed;
+  std::size_t batches = 0;
+  ob::TradeBars bars(ob::TradeBarsConfig{.periods_ns={1000, 5000}, .batch=2}, [&](std::span<const ob::TradeBar> b) {
+    assert(!b.empty() && b.size() <= 2);
+    closed.insert(closed.end(), b.begin(), b.end());
+    ++batches;
+  });
+  ob::OrderBook book;
+  book.set_listener(&bars);
+  book.add_symbol(1, "AAPL");
+  book.add_symbol(2, "MSFT");
+  assert(book.apply(ob::AddEvent{.locate=1, .order_id=1, .side=ob::Side::Buy, .qty=300, .price=100}) == ob::Status::Ok);
+  assert(book.apply(ob::AddEvent{.locate=1, .order_id=2, .side=ob::Side::Sell, .qty=200, .price=101}) == ob::Status::Ok);
+  assert(book.apply(ob::AddEvent{.locate=2, .order_id=3, .side=ob::Side::Sell, .qty=70, .price=500}) == ob::Status::Ok);
+
+  bars.advance(100);
+  assert(book.apply(ob::ExecuteEvent{.locate=1, .order_id=1, .exec_qty=100}) == ob::Status::Ok); // at 100
+  bars.advance(500);
+  assert(book.apply(ob::ExecuteEvent{.locate=1, .order_id=2, .exec_qty=50, .price=102, .has_price=true}) ==
+         ob::Status::Ok);
+  bars.advance(600);
+  assert(book.apply(ob::ExecuteEvent{.locate=1, .order_id=2, .exec_qty=10, .price=99, .has_price=true,
+                                     .printable=false}) == ob::Status::Ok);
+  bars.advance(700);
+  assert(book.apply(te) == ob::Status::Ok);
+  bars.advance(800);
+  assert(book.apply(ob::ExecuteEvent{.locate=2, .order_id=3, .exec_qty=70}) == ob::Status::Ok); // fills, frees
+  assert(book.find(1)->depth(ob::Side::Sell, 1)[0].qty == 140 && book.find(2)->order_count() == 0);
+  assert(closed.empty() && bars.current(1, 0) && bars.current(1, 0)->trades == 3 && !bars.current(3, 0));
+
+  bars.advance(1500); // closes both [0, 1000) bars in one batch
+  assert(batches == 1 && closed.size() == 2 && !bars.current(1, 0) && bars.current(1, 1));
+  const ob::TradeBar& a = closed[0];
+  assert(a.locate == 1 && a.period == 0 && a.start_ns == 0);
+  assert(a.open == 100 && a.high == 102 && a.low == 100 && a.close == 101);
+  assert(a.volume == 190 && a.hidden_volume == 40 && a.trades == 3);
+  assert(a.vwap() == (100.0 * 100 + 102.0 * 50 + 101.0 * 40) / 190);
+  assert(closed[1].locate == 2 && closed[1].open == 500 && closed[1].volume == 70);
+
+  bars.advance(1600);
+  assert(book.apply(ob::ExecuteEvent{.locate=1, .order_id=1, .exec_qty=5}) == ob::Status::Ok);
+  bars.finish();
+  assert(closed.size() == 5 && batches == 3);
+  assert(closed[2].period == 0 && closed[2].start_ns == 1000 && closed[2].volume == 5);
+  assert(closed[3].period == 1 && closed[3].locate == 1 && closed[3].volume == 195 && closed[3].trades == 4);
+  const ob::TradeBarsStats& st = bars.stats();
+  assert(st.trades == 5 && st.volume == 265 && st.non_printable == 1 && st.bars == 5 && st.batches == 3);
+}
+
+static void test_feature_engine() {
+  // Reference OFI from book.top() after every level change, chained behind the engine.
+  struct TopOfi final : ob::BookListener {
+    ob::TopOfBook last;
+    std::int64_t ofi{};
+    void on_level(const ob::SymbolBook& book, const ob::LevelUpdate&) override {
+      const ob::TopOfBook t = book.top();
+      auto term = [](bool had, ob::LevelView o, bool has, ob::LevelView n, bool buy) {
+        const bool up = buy ? n.price >= o.price : n.price <= o.price;
+        const bool down = buy ? n.price <= o.price : n.price >= o.price;
+        std::int64_t e = 0;
+        if (!had || (has && up)) e += static_cast<std::int64_t>(has ? n.qty : 0);
+        if (!has || (had && down)) e -= static_cast<std::int64_t>(had ? o.qty : 0);
+        return e;
+      };
+      ofi += term(last.has_bid, last.bid, t.has_bid, t.bid, true) - term(last.has_ask, last.ask, t.has_ask, t.ask, false);
+      last = t;
+    }
+  };
+
+  for (ob::LevelBackend backend : {ob::LevelBackend::Map, ob::LevelBackend::Flat}) {
+    ob::FeatureEngine engine(ob::FeatureConfig{.depth=3});
+    TopOfi ref;
+    engine.set_next(&ref);
+    ob::OrderBook book;
+    book.set_listener(&engine);
+    book.add_symbol(1, "AAPL", backend);
+    auto check = [&] {
+      const ob::SymbolBook& sb = *book.find(1);
+      ob::FeatureRow row;
+      assert(engine.row(1, &row));
+      const ob::TopOfBook t = sb.top();
+      assert(row.has_bid == t.has_bid && row.has_ask == t.has_ask);
+      assert(!t.has_bid || (row.bid == t.bid.price && row.bid_qty == t.bid.qty));
+      assert(!t.has_ask || (row.ask == t.ask.price && row.ask_qty == t.ask.qty));
+      std::uint64_t depth_qty[2] = {0, 0};
+      for (ob::Side s : {ob::Side::Buy, ob::Side::Sell}) {
+        for (const ob::LevelView& l : sb.depth(s, 3)) depth_qty[s == ob::Side::Buy ? 0 : 1] += l.qty;
+      }
+      assert(row.bid_depth_qty == depth_qty[0] && row.ask_depth_qty == depth_qty[1]);
+      assert(row.ofi == ref.ofi);
+    };
+    auto price = [](std::mt19937& g, bool buy) {
+      return buy ? 1000 - static_cast<ob::Price>(g() % 8) : 1001 + static_cast<ob::Price>(g() % 8);
+    };
+
+    std::mt19937 rng(11);
+    struct Live { ob::OrderId id; ob::Qty qty; bool buy; };
+    std::vector<Live> live;
+    ob::OrderId next_id = 1;
+    std::uint64_t execs = 0;
+    for (int step = 0; step < 4000; ++step) {
+      const unsigned r = rng() % 10;
+      if (live.size() < 20 || r < 4) {
+        const bool buy = rng() & 1;
+        const ob::Qty qty = 100 * (1 + rng() % 3);
+        assert(book.apply(ob::AddEvent{.locate=1, .order_id=next_id, .side=buy ? ob::Side::Buy : ob::Side::Sell,
+                                       .qty=qty, .price=price(rng, buy)}) == ob::Status::Ok);
+        live.push_back(Live{next_id++, qty, buy});
+      } else {
+        const std::size_t i = rng() % live.size();
+        Live& o = live[i];
+        if (r < 6 && o.qty > 50) {
+          assert(book.apply(ob::CancelEvent{.locate=1, .order_id=o.id, .cancel_qty=50}) == ob::Status::Ok);
+          o.qty -= 50;
+        } else if (r < 7) {
+          assert(book.apply(ob::ReplaceEvent{.locate=1, .old_order_id=o.id, .new_order_id=next_id, .new_qty=o.qty,
+                                             .new_price=price(rng, o.buy)}) == ob::Status::Ok);
+          o.id = next_id++;
+        } else {
+          if (r < 9) {
+            assert(book.apply(ob::ExecuteEvent{.locate=1, .order_id=o.id, .exec_qty=o.qty}) == ob::Status::Ok);
+            ++execs;
+          } else {
+            assert(book.apply(ob::DeleteEvent{.locate=1, .order_id=o.id}) == ob::Status::Ok);
+          }
+          live[i] = live.back();
+          live.pop_back();
+        }
+      }
+      check();
+    }
+
+    std::vector<ob::FeatureRow> rows;
+    engine.export_rows(&rows);
+    assert(rows.size() == 1 && rows[0].locate == 1 && rows[0].depth == 3);
+    std::uint64_t exec_total = 0, add_total = 0;
+    for (std::size_t s = 0; s < 2; ++s) {
+      for (std::size_t k = 0; k < 3; ++k) {
+        exec_total += rows[0].executions[s][k];
+        add_total += rows[0].adds[s][k];
+      }
+      for (std::size_t k = 3; k < ob::FeatureRow::kMaxDepth; ++k) assert(rows[0].adds[s][k] == 0);
+    }
+    assert(exec_total > 0 && exec_total <= execs && add_total > 0);
+  }
+
+  // Exact per-level flow, microprice and imbalance on a small book.
+  ob::FeatureEngine engine(ob::FeatureConfig{.depth=2});
+  ob::OrderBook book;
+  book.set_listener(&engine);
+  book.add_symbol(7, "MSFT");
+  assert(book.apply(ob::AddEvent{.locate=7, .order_id=1, .side=ob::Side::Buy, .qty=300, .price=100}) == ob::Status::Ok);
+  assert(book.apply(ob::AddEvent{.locate=7, .order_id=2, .side=ob::Side::Buy, .qty=100, .price=99}) == ob::Status::Ok);
+  assert(book.apply(ob::AddEvent{.locate=7, .order_id=3, .side=ob::Side::Buy, .qty=500, .price=98}) == ob::Status::Ok);
+  assert(book.apply(ob::AddEvent{.locate=7, .order_id=4, .side=ob::Side::Sell, .qty=100, .price=102}) == ob::Status::Ok);
+  assert(book.apply(ob::CancelEvent{.locate=7, .order_id=2, .cancel_qty=40}) == ob::Status::Ok);   // bid rank 1
+  assert(book.apply(ob::ExecuteEvent{.locate=7, .order_id=1, .exec_qty=100}) == ob::Status::Ok);  // bid rank 0
+  assert(book.apply(ob::DeleteEvent{.locate=7, .order_id=1}) == ob::Status::Ok); // 98 moves into the window
+  ob::FeatureRow row;
+  assert(!engine.row(8, &row) && engine.row(7, &row));
+  assert(row.bid == 99 && row.bid_qty == 60 && row.bid_depth_qty == 560 && row.ask == 102 && row.ask_qty == 100);
+  assert(row.adds[0][0] == 1 && row.adds[0][1] == 1 && row.adds[0][2] == 0 && row.adds[1][0] == 1);
+  assert(row.cancels[0][1] == 1 && row.cancels[0][0] == 1 && row.executions[0][0] == 1);
+  assert(row.microprice == (99.0 * 100 + 102.0 * 60) / 160);
+  assert(row.queue_imbalance == (60.0 - 100.0) / 160 && row.depth_imbalance == (560.0 - 100.0) / 660);
+}
+
+static void test_memory_trim() {
+  ob::CountingResource upstream;
+  ob::OrderBook book;
+  book.set_memory(ob::BookMemory::PerSymbol, &upstream);
+  book.add_symbol(1, "MAP", ob::LevelBackend::Map);
+  book.add_symbol(2, "FLAT", ob::LevelBackend::Flat);
+  for (ob::StockLocate loc : {1, 2}) {
+    for (ob::OrderId id = 1; id <= 4000; ++id) {
+      ob::Side side = (id % 2) ? ob::Side::Buy : ob::Side::Sell;
+      ob::Price off = static_cast<ob::Price>(1 + id % 200) * 100;
+      ob::Price px = (side == ob::Side::Buy) ? 1000000 - off : 1000000 + off;
+      assert(book.apply(ob::AddEvent{.locate=loc, .order_id=id, .side=side, .qty=10, .price=px}) == ob::Status::Ok);
+    }
+    // Keep 100 orders, five per level, and drop the rest.
+    for (ob::OrderId id = 1; id <= 4000; ++id) {
+      if (id % 200 < 5) continue;
+      assert(book.apply(ob::DeleteEvent{.locate=loc, .order_id=id}) == ob::Status::Ok);
+    }
+  }
+  const ob::MemoryFootprint peak = book.peak_footprint();
+  const ob::MemoryFootprint before = book.footprint();
+  assert(peak.total() >= before.total() && before.pool_bytes >= 4000 * sizeof(ob::Order) * 2);
+  const auto want_bid = book.find(1)->depth(ob::Side::Buy, 10);
+
+  ob::TrimStats st = book.trim_idle(ob::TrimPolicy{.live_fraction=0.5, .min_bytes=1 << 30});
+  assert(st.checked == 2 && st.trimmed == 0);
+  st = book.trim_idle(ob::TrimPolicy{.live_fraction=0.5, .min_bytes=0}, 1);
+  assert(st.checked == 1 && st.trimmed == 1 && st.bytes_after < st.bytes_before);
+  st = book.trim_idle(ob::TrimPolicy{.live_fraction=0.5, .min_bytes=0});
+  assert(st.trimmed == 1); // the other symbol; the first is now dense
+  assert(book.compact(9) == ob::Status::UnknownSymbol);
+
+  const ob::MemoryFootprint after = book.footprint();
+  assert(after.total() * 10 < before.total());
+  const ob::MemoryFootprint peak_after = book.peak_footprint();
+  assert(peak_after.pool_bytes == peak.pool_bytes && peak_after.total() >= peak.total());
+  for (ob::StockLocate loc : {1, 2}) {
+    const ob::SymbolBook* b = book.find(loc);
+    assert(b->order_count() == 100 && b->order_capacity() == 100 && b->peak_orders() == 4000 && b->validate());
+    // FIFO order survives: every level's orders still run in ascending id.
+    for (ob::Side s : {ob::Side::Buy, ob::Side::Sell}) {
+      b->for_each_level(s, [](const ob::Level& lvl) {
+        for (const ob::Order* o = lvl.head; o && o->next; o = o->next) assert(o->order_id < o->next->order_id);
+        return true;
+      });
+    }
+  }
+  const auto got_bid = book.find(1)->depth(ob::Side::Buy, 10);
+  assert(got_bid.size() == want_bid.size());
+  for (std::size_t i = 0; i < got_bid.size(); ++i) {
+    assert(got_bid[i].price == want_bid[i].price && got_bid[i].qty == want_bid[i].qty);
+  }
+  assert(book.apply(ob::ExecuteEvent{.locate=1, .order_id=200, .exec_qty=10}) == ob::Status::Ok);
+  assert(book.apply(ob::AddEvent{.locate=2, .order_id=99, .side=ob::Side::Buy, .qty=5, .price=1}) == ob::Status::Ok);
+  assert(book.find(1)->order_count() == 99 && book.find(2)->validate());
+}
+
+static void test_level_churn_and_replace() {
+  for (ob::LevelBackend backend : {ob::LevelBackend::Map, ob::LevelBackend::Flat}) {
+    ob::CountingResource upstream;
+    ob::OrderBook book;
+    book.set_memory(ob::BookMemory::Global, &upstream);
+    book.add_symbol(1, "T", backend);
+    ob::SymbolBook& b = *book.find(1);
+    for (ob::OrderId id = 1; id <= 10; ++id) {
+      assert(book.apply(ob::AddEvent{.locate=1, .order_id=id, .side=ob::Side::Buy, .qty=10,
+                                     .price=static_cast<ob::Price>(100 - id)}) == ob::Status::Ok);
+    }
+
+    // The inside level empties and refills: the only allocation left is the order's
+    // index node, and the emptied level is invisible while parked.
+    assert(book.apply(ob::DeleteEvent{.locate=1, .order_id=1}) == ob::Status::Ok);
+    assert(book.apply(ob::AddEvent{.locate=1, .order_id=1, .side=ob::Side::Buy, .qty=10, .price=99}) == ob::Status::Ok);
+    const std::uint64_t allocs = upstream.allocations();
+    for (int round = 0; round < 100; ++round) {
+      assert(book.apply(ob::ExecuteEvent{.locate=1, .order_id=1, .exec_qty=10}) == ob::Status::Ok);
+      assert(b.find_level(ob::Side::Buy, 99) == nullptr && b.level_count(ob::Side::Buy) == 9);
+      assert(b.top().bid.price == 98);
+      assert(book.apply(ob::AddEvent{.locate=1, .order_id=1, .side=ob::Side::Buy, .qty=10, .price=99}) == ob::Status::Ok);
+      assert(b.level_count(ob::Side::Buy) == 10 && b.top().bid.price == 99);
+    }
+    assert(upstream.allocations() == allocs + 100);
+
+    // Replace keeps the order's slot and index node, and sends it to the back of the queue.
+    const ob::Order* slot = b.find_level(ob::Side::Buy, 98)->head;
+    assert(book.apply(ob::ReplaceEvent{.locate=1, .old_order_id=2, .new_order_id=20, .new_qty=5, .new_price=99}) ==
+           ob::Status::Ok);
+    assert(upstream.allocations() == allocs + 100);
+    assert(b.find_level(ob::Side::Buy, 98) == nullptr && b.find_level(ob::Side::Buy, 99)->tail == slot);
+    assert(slot->order_id == 20 && slot->qty == 5 && b.find_level(ob::Side::Buy, 99)->total_qty == 15);
+    assert(book.apply(ob::AddEvent{.locate=1, .order_id=11, .side=ob::Side::Buy, .qty=10, .price=99}) == ob::Status::Ok);
+    assert(book.apply(ob::ReplaceEvent{.locate=1, .old_order_id=11, .new_order_id=21, .new_qty=7, .new_price=99}) ==
+           ob::Status::Ok);
+    assert(b.find_level(ob::Side::Buy, 99)->tail->order_id == 21 && b.find_level(ob::Side::Buy, 99)->head->order_id == 1);
+    assert(book.apply(ob::ReplaceEvent{.locate=1, .old_order_id=21, .new_order_id=20, .new_qty=1, .new_price=90}) ==
+           ob::Status::DuplicateOrder);
+    assert(book.apply(ob::ReplaceEvent{.locate=1, .old_order_id=1, .new_order_id=1, .new_qty=10, .new_price=99}) ==
+           ob::Status::DuplicateOrder);
+    assert(b.find_level(ob::Side::Buy, 99)->head->order_id == 1); // not re-queued
+    assert(book.apply(ob::CancelEvent{.locate=1, .order_id=21, .cancel_qty=1}) == ob::Status::Ok);
+    assert(b.validate() && b.order_count() == 11);
+
+    // More emptied levels than can stay parked: the oldest are reclaimed.
+    for (ob::OrderId id = 3; id <= 10; ++id) assert(book.apply(ob::DeleteEvent{.locate=1, .order_id=id}) == ob::Status::Ok);
+    assert(b.level_count(ob::Side::Buy) == 1 && b.validate());
+    assert(b.footprint().level_bytes > 0);
+    for (ob::OrderId id = 3; id <= 10; ++id) {
+      assert(book.apply(ob::AddEvent{.locate=1, .order_id=id, .side=ob::Side::Buy, .qty=1,
+                                     .price=static_cast<ob::Price>(100 - id)}) == ob::Status::Ok);
+    }
+    assert(b.level_count(ob::Side::Buy) == 9 && b.depth(ob::Side::Buy, 20).size() == 9 && b.validate());
+  }
+}
+
+static void test_backtest_queue_position() {
+  struct Recorder : ob::Strategy {
+    std::vector<ob::ShadowFill> fills;
+    std::vector<ob::ShadowId> cancelled;
+    std::size_t books = 0;
+    void on_book(ob::Backtester&, const ob::SymbolBook&, const ob::LevelUpdate&) override { ++books; }
+    void on_fill(ob::Backtester&, const ob::ShadowFill& f) override { fills.push_back(f); }
+    void on_cancelled(ob::Backtester&, const ob::ShadowOrder& o) override { cancelled.push_back(o.id); }
+  };
+  ob::OrderBook book;
+  book.add_symbol(1, "AAPL");
+  book.add_symbol(2, "MSFT");
+  Recorder strat;
+  ob::Backtester bt(book, strat, ob::BacktestConfig{.latency_ns=1000});
+  bt.subscribe(1);
+  book.set_listener(&bt);
+  auto add = [&](std::uint64_t ts, ob::StockLocate loc, ob::OrderId id, ob::Side side, ob::Qty qty, ob::Price px) {
+    bt.advance(ts);
+    assert(bt.apply(ob::AddEvent{.locate=loc, .order_id=id, .side=side, .qty=qty, .price=px}) == ob::Status::Ok);
+  };
+  auto exec = [&](std::uint64_t ts, ob::OrderId id, ob::Qty qty) {
+    bt.advance(ts);
+    assert(bt.apply(ob::ExecuteEvent{.locate=1, .order_id=id, .exec_qty=qty}) == ob::Status::Ok);
+  };
+
+  add(0, 1, 1, ob::Side::Buy, 100, 100);
+  add(0, 1, 2, ob::Side::Buy, 50, 100);
+  const ob::ShadowId id = bt.submit(1, ob::Side::Buy, 100, 30);
+  assert(id == 1 && bt.submit(1, ob::Side::Buy, 100, 0) == 0 && bt.submit(9, ob::Side::Buy, 100, 1) == 0);
+  add(500, 1, 3, ob::Side::Buy, 20, 100); // still in flight: this one queues ahead
+  assert(!bt.find(id)->working);
+  add(1100, 1, 4, ob::Side::Buy, 40, 100); // behind
+  assert(bt.find(id)->working && bt.find(id)->ahead == 170);
+  add(1100, 2, 1, ob::Side::Buy, 10, 50);  // not subscribed
+
+  bt.advance(1200);
+  assert(bt.apply(ob::DeleteEvent{.locate=1, .order_id=2}) == ob::Status::Ok);
+  assert(bt.find(id)->ahead == 120);
+  exec(1300, 1, 100);
+  exec(1400, 3, 20);
+  assert(bt.find(id)->ahead == 0 && strat.fills.empty());
+  exec(1500, 4, 10); // the queue in front is gone: flow behind fills the shadow order
+  assert(strat.fills.size() == 1 && strat.fills[0].qty == 10 && strat.fills[0].leaves == 20 &&
+         strat.fills[0].price == 100 && strat.fills[0].ts == 1500);
+  add(1600, 1, 5, ob::Side::Buy, 30, 99);
+  exec(1700, 5, 30); // traded through the shadow order's price
+  assert(strat.fills.size() == 2 && strat.fills[1].qty == 20 && bt.find(id)->done && bt.find(id)->filled == 30);
+
+  // Marketable on arrival: fills against the displayed asks it crosses.
+  add(1800, 1, 6, ob::Side::Sell, 25, 101);
+  add(1800, 1, 7, ob::Side::Sell, 25, 102);
+  const ob::ShadowId take = bt.submit(1, ob::Side::Buy, 102, 40);
+  bt.advance(2800);
+  assert(strat.fills.size() == 4 && strat.fills[2].price == 101 && strat.fills[2].qty == 25 &&
+         strat.fills[3].price == 102 && strat.fills[3].qty == 15 && bt.find(take)->done);
+
+  // Cancels take the latency too.
+  const ob::ShadowId rest = bt.submit(1, ob::Side::Buy, 90, 5);
+  bt.advance(3800);
+  assert(bt.cancel(rest) && bt.find(rest)->working);
+  bt.advance(4800);
+  assert(strat.cancelled.size() == 1 && strat.cancelled[0] == rest && bt.find(rest)->done && !bt.cancel(rest));
+
+  const ob::BacktestStats& st = bt.stats();
+  assert(st.submitted == 3 && st.activated == 3 && st.cancelled == 1 && st.fills == 4 && st.filled_qty == 70);
+  assert(strat.books == 12); // level changes of locate 1 only
+  assert(book.find(1)->order_count() == 3 && book.find(1)->validate()); // the replayed book is untouched
+}
+
+static void test_itch_framing() {
+  // Raw day: a system event, a directory entry and random 'A'/'D'/'E' messages.
+  std::mt19937 rng(48);
+  std::vector<std::vector<std::uint8_t>> msgs;
+  for (char t : std::string("SR") + std::string(200, ' ')) {
+    if (t == ' ') t = "ADE"[rng() % 3];
+    std::vector<std::uint8_t> m(ob::ingest::itch_message_size(t));
+    m[0] = static_cast<std::uint8_t>(t);
+    for (std::size_t i = 1; i < m.size(); ++i) m[i] = static_cast<std::uint8_t>(rng());
+    msgs.push_back(std::move(m));
+  }
+  std::vector<std::uint8_t> raw, length, soup;
+  for (std::size_t i = 0; i < msgs.size(); ++i) {
+    const std::vector<std::uint8_t>& m = msgs[i];
+    raw.insert(raw.end(), m.begin(), m.end());
+    length.push_back(static_cast<std::uint8_t>(m.size() >> 8));
+    length.push_back(static_cast<std::uint8_t>(m.size()));
+    length.insert(length.end(), m.begin(), m.end());
+    soup.push_back(static_cast<std::uint8_t>((m.size() + 1) >> 8));
+    soup.push_back(static_cast<std::uint8_t>(m.size() + 1));
+    soup.push_back('S');
+    soup.insert(soup.end(), m.begin(), m.end());
+    if (i == 50) {
+      length.insert(length.end(), {0, 3, 'z', 1, 2});   // a type this decoder does not know
+      soup.insert(soup.end(), {0, 1, 'H'});             // heartbeat
+    }
+  }
+  using ob::ingest::ItchFraming;
+  assert(ob::ingest::detect_itch_framing(raw.data(), raw.size()) == ItchFraming::Raw);
+  assert(ob::ingest::detect_itch_framing(length.data(), length.size()) == ItchFraming::LengthPrefixed);
+  assert(ob::ingest::detect_itch_framing(soup.data(), soup.size()) == ItchFraming::SoupBin);
+  ItchFraming f;
+  assert(ob::ingest::parse_itch_framing("length", &f) && f == ItchFraming::LengthPrefixed);
+  assert(!ob::ingest::parse_itch_framing("bogus", &f));
+
+  ob::ingest::ItchIndex index;
+  assert(ob::ingest::index_itch(length.data(), length.size(), ItchFraming::Auto, &index));
+  assert(index.framing == ItchFraming::LengthPrefixed && index.size() == msgs.size() && index.unknown == 1);
+  assert(length[index.offsets[1]] == 'R');
+
+  // Boundaries for threads: monotone and on message starts.
+  const std::vector<std::size_t> cuts = ob::ingest::split_itch_index(index, 3);
+  assert(cuts.size() == 4 && cuts.front() == 0 && cuts.back() == index.size());
+  for (std::size_t k = 1; k < cuts.size(); ++k) assert(cuts[k - 1] < cuts[k]);
+
+  // Unframed input is byte for byte the raw day, unknown and non-message packets dropped.
+  for (std::vector<std::uint8_t>* framed : {&length, &soup}) {
+    std::vector<std::uint8_t> data = *framed;
+    assert(ob::ingest::unframe_itch(&data, ItchFraming::Auto, &index));
+    assert(data == raw && index.offsets[2] == 12 + 39);
+  }
+  assert(index.framing == ItchFraming::SoupBin && index.other == 1 && index.unknown == 0);
+  std::vector<std::uint8_t> same = raw;
+  assert(ob::ingest::unframe_itch(&same, ItchFraming::Auto, &index) && same == raw && index.size() == msgs.size());
+
+  // Raw framing cannot step over an unknown type; a truncated tail is reported.
+  std::vector<std::uint8_t> bad = raw;
+  bad[12 + 39] = 'z';
+  assert(!ob::ingest::index_itch(bad.data(), bad.size(), ItchFraming::Raw, &index) && index.size() == 2);
+  std::vector<std::uint8_t> cut(length.begin(), length.end() - 5);
+  assert(!ob::ingest::unframe_itch(&cut, ItchFraming::LengthPrefixed, &index));
+  assert(index.size() == msgs.size() - 1 && cut.size() == raw.size() - msgs.back().size());
+}
+
+static void test_state_hash() {
+  using ob::Side;
+  auto run = [](ob::OrderBook& book, std::initializer_list<ob::StockLocate> locs) {
+    for (ob::StockLocate loc : locs) {
+      const ob::OrderId base = loc * 100;
+      for (ob::OrderId i = 1; i <= 6; ++i) {
+        assert(book.apply(ob::AddEvent{.locate=loc, .order_id=base + i, .side=(i % 2) ? Side::Buy : Side::Sell,
+                                       .qty=static_cast<ob::Qty>(10 * i),
+                                       .price=static_cast<ob::Price>((i % 2) ? 100 - i / 2 : 101 + i / 2)}) ==
+               ob::Status::Ok);
+      }
+      assert(book.apply(ob::CancelEvent{.locate=loc, .order_id=base + 1, .cancel_qty=3}) == ob::Status::Ok);
+      assert(book.apply(ob::ExecuteEvent{.locate=loc, .order_id=base + 2, .exec_qty=20}) == ob::Status::Ok);
+      assert(book.apply(ob::ReplaceEvent{.locate=loc, .old_order_id=base + 3, .new_order_id=base + 7, .new_qty=4,
+                                         .new_price=100}) == ob::Status::Ok);
+      assert(book.apply(ob::DeleteEvent{.locate=loc, .order_id=base + 5}) == ob::Status::Ok);
+    }
+  };
+  // Adds every live order of from into an empty book in queue order.
+  auto rebuild = [](const ob::SymbolBook& from, ob::OrderBook& to) {
+    for (Side s : {Side::Buy, Side::Sell}) {
+      from.for_each_level(s, [&](const ob::Level& lvl) {
+        for (const ob::Order* o = lvl.head; o; o = o->next) {
+          to.apply(ob::AddEvent{.locate=from.locate(), .order_id=o->order_id, .side=o->side, .qty=o->qty,
+                                .price=o->price});
+        }
+        return true;
+      });
+    }
+  };
+
+  ob::OrderBook map_book;
+  ob::OrderBook flat_book;
+  map_book.set_default_backend(ob::LevelBackend::Map);
+  flat_book.set_default_backend(ob::LevelBackend::Flat);
+  for (ob::OrderBook* b : {&map_book, &flat_book}) {
+    b->add_symbol(1, "A");
+    b->add_symbol(2, "B");
+    assert(b->state_hash() == 0);
+    run(*b, {1, 2});
+  }
+  const std::uint64_t h = map_book.state_hash();
+  assert(h != 0 && flat_book.state_hash() == h);
+  assert(map_book.find(1)->state_hash() != map_book.find(2)->state_hash());
+
+  // The hash depends on the state reached, not the path: a from-scratch rebuild matches.
+  ob::OrderBook fresh;
+  fresh.add_symbol(1, "A");
+  fresh.add_symbol(2, "B");
+  rebuild(*map_book.find(1), fresh);
+  rebuild(*map_book.find(2), fresh);
+  assert(fresh.find(1)->state_hash() == map_book.find(1)->state_hash() && fresh.state_hash() == h);
+
+  // Shards over disjoint symbols add up to the whole; unused books add nothing.
+  ob::OrderBook shard1;
+  ob::OrderBook shard2;
+  shard1.add_symbol(1, "A");
+  shard2.add_symbol(2, "B");
+  shard2.add_symbol(3, "C");
+  run(shard1, {1});
+  run(shard2, {2});
+  assert(shard1.state_hash() + shard2.state_hash() == h);
+
+  // Compaction keeps the state; a divergent quantity or queue order changes it.
+  assert(map_book.compact(1) == ob::Status::Ok && map_book.state_hash() == h);
+  assert(map_book.apply(ob::CancelEvent{.locate=1, .order_id=101, .cancel_qty=1}) == ob::Status::Ok);
+  assert(map_book.state_hash() != h);
+  ob::OrderBook fifo;
+  fifo.add_symbol(1, "A");
+  assert(fifo.apply(ob::AddEvent{.locate=1, .order_id=1, .side=Side::Buy, .qty=10, .price=100}) == ob::Status::Ok);
+  assert(fifo.apply(ob::AddEvent{.locate=1, .order_id=2, .side=Side::Buy, .qty=10, .price=100}) == ob::Status::Ok);
+  const std::uint64_t ordered = fifo.state_hash();
+  assert(fifo.apply(ob::ReplaceEvent{.locate=1, .old_order_id=1, .new_order_id=3, .new_qty=10, .new_price=100}) ==
+         ob::Status::Ok);
+  assert(fifo.apply(ob::ReplaceEvent{.locate=1, .old_order_id=3, .new_order_id=1, .new_qty=10, .new_price=100}) ==
+         ob::Status::Ok);
+  assert(fifo.state_hash() != ordered); // same orders, 2 now ahead of 1
+  assert(fifo.apply(ob::DeleteEvent{.locate=1, .order_id=2}) == ob::Status::Ok);
+  assert(fifo.apply(ob::DeleteEvent{.locate=1, .order_id=1}) == ob::Status::Ok);
+  assert(fifo.state_hash() == 0);
+
+  flat_book.reset();
+  assert(flat_book.state_hash() == 0);
+}
+
 int main() {
   test_add_cancel_delete();
   test_price_time_priority();
   test_replace();
+  test_itch_decode_add();
+  test_itch_run_decode();
+  test_itch_filter();
+  test_snapshot_roundtrip();
+  test_shm_feed();
+  test_conflation();
+  test_top_table_scans();
+  test_directory_and_capacity();
+  test_level_backends_agree();
+  test_book_memory();
+  test_reset();
+  test_journal_roundtrip();
+  test_as_of_checkpoints();
+  test_batch_replay();
+  test_spsc_ring_and_pipeline();
+  test_capture_roundtrip();
+  test_consolidated_nbbo();
+  test_integrity_checker();
+  test_trade_bars();
+  test_feature_engine();
+  test_memory_trim();
+  test_level_churn_and_replace();
+  test_backtest_queue_position();
+  test_itch_framing();
+  test_state_hash();
   std::cout << "All tests passed.\n";
 }
\ No newline at end of file